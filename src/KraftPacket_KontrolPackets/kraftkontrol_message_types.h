@@ -11,6 +11,8 @@
 #include "data_containers/navigation_data.h"
 #include "data_containers/vehicle_data.h"
 
+#include "lib/Simple-Schedule/src/task_profiler.h"
+
 
 
 enum eKraftMessageType_KraftKontrol_t : uint8_t {
@@ -21,7 +23,8 @@ enum eKraftMessageType_KraftKontrol_t : uint8_t {
     eKraftMessageType_KraftKontrol_VehicleModeIs,
     eKraftMessageType_KraftKontrol_VehicleStatus,
     eKraftMessageType_KraftKontrol_RCChannels,
-    eKraftMessageType_KraftKontrol_GNSSData
+    eKraftMessageType_KraftKontrol_GNSSData,
+    eKraftMessageType_KraftKontrol_TaskStatistics
 };
 
 
@@ -403,4 +406,65 @@ protected:
 };
 
 
+
+class KraftMessageTaskStatistics: public KraftMessage_Interface {
+public:
+
+    KraftMessageTaskStatistics() {}
+
+    /**
+     * @param statistics Statistics of the task to send.
+     * @param taskIndex Index of the task in the scheduler.
+     * @param numberTasks Number of tasks in the scheduler. Lets the receiver know when all tasks were received.
+     */
+    KraftMessageTaskStatistics(const TaskStatistics &statistics, const uint8_t &taskIndex, const uint8_t &numberTasks) {
+        statistics_ = statistics;
+        taskIndex_ = taskIndex;
+        numberTasks_ = numberTasks;
+    }
+
+    virtual uint32_t getDataTypeID() {return eKraftMessageType_KraftKontrol_t::eKraftMessageType_KraftKontrol_TaskStatistics;}
+
+    uint32_t getDataSize() {return sizeof(statistics_) + sizeof(taskIndex_) + sizeof(numberTasks_);}
+
+    TaskStatistics getStatistics() {return statistics_;}
+
+    uint8_t getTaskIndex() {return taskIndex_;}
+
+    uint8_t getNumberTasks() {return numberTasks_;}
+
+    bool getRawData(void* dataBytes, const uint32_t &dataByteSize, const uint32_t &startByte = 0) {
+
+        if (dataByteSize < getDataSize()) return false;
+
+        memcpy(dataBytes, &taskIndex_, sizeof(taskIndex_));
+        memcpy(dataBytes + sizeof(taskIndex_), &numberTasks_, sizeof(numberTasks_));
+        memcpy(dataBytes + sizeof(taskIndex_) + sizeof(numberTasks_), &statistics_, sizeof(statistics_));
+
+        return true;
+
+    }
+
+    bool setRawData(const void* dataBytes, const uint32_t &dataByteSize, const uint32_t &startByte = 0){
+
+        if (dataByteSize < getDataSize()) return false;
+
+        memcpy(&taskIndex_, dataBytes, sizeof(taskIndex_));
+        memcpy(&numberTasks_, dataBytes + sizeof(taskIndex_), sizeof(numberTasks_));
+        memcpy(&statistics_, dataBytes + sizeof(taskIndex_) + sizeof(numberTasks_), sizeof(statistics_));
+
+        return true;
+
+    }
+
+
+protected:
+
+    TaskStatistics statistics_;
+    uint8_t taskIndex_ = 0;
+    uint8_t numberTasks_ = 0;
+
+};
+
+
 #endif 
@@ -4,6 +4,8 @@
 
 #include "stdint.h"
 
+#include "utils/system_time.h"
+
 
 /**
  * Cannot be instantiated.
@@ -12,7 +14,8 @@
 class DataContainerTimestamped_Base {
 public:
 
-    uint32_t timestamp;
+    //Time in nanoseconds. See NOW().
+    int64_t timestamp = 0;
 
 protected:
 
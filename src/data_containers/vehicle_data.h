@@ -31,6 +31,9 @@ struct VehicleData {
     //Is true when vehicle is ready to be armed
     bool vehicleReady = false;
 
+    //Is true while the scheduler cannot keep up and tasks that are not needed to fly are shed.
+    bool schedulerOverloaded = false;
+
 };
 
 
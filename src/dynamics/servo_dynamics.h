@@ -5,6 +5,8 @@
 
 #include "outputs/servo_ppm.h"
 
+#include "utils/system_time.h"
+
 
 
 class ServoDynamics {
@@ -85,8 +87,9 @@ public:
      */
     void thread() {
 
-        float dTime = float(micros() - _lastThreadRunTimestamp_us)/1000000.0f;
-        _lastThreadRunTimestamp_us = micros();
+        int64_t now = NOW();
+        float dTime = (float)(now - _lastThreadRunTimestamp_ns)/SECONDS;
+        _lastThreadRunTimestamp_ns = now;
 
         if (dTime > 100000 || !initialised_) dTime = 0;
 
@@ -167,7 +170,7 @@ private:
     float _currentSpeed = 0;
     float _setPosition = 0;
 
-    uint32_t _lastThreadRunTimestamp_us = 0;
+    int64_t _lastThreadRunTimestamp_ns = 0;
 
     
 };
@@ -100,7 +100,7 @@ bool KraftKommunication::sendMessage(KraftMessage_Interface* kraftMessage, const
     if (packetData.waitforAck) {
 
         packetData.sendAttempts = c_sendAttempts;
-        packetData.sendInterval = c_sendTimeout/c_sendAttempts;
+        packetData.sendInterval = c_sendTimeout*MICROSECONDS/c_sendAttempts;
 
     }
 
@@ -146,13 +146,13 @@ void KraftKommunication::loop() {
                 dataLink_->sendBuffer(packet->dataBuffer, packet->bufferSize);
 
                 if (packet->sendAttempts > 0) packet->sendAttempts--;
-                packet->sendTimestamp = micros();
+                packet->sendTimestamp = NOW();
 
                 nodeData_[packet->receivingNodeID].waitingOnPacket = packet;
 
             } else {
 
-                if (packet->sendTimestamp + packet->sendInterval < micros()) {
+                if (NOW() - packet->sendTimestamp > packet->sendInterval) {
                     
                     if (packet->sendAttempts == 0) {
 
@@ -162,7 +162,7 @@ void KraftKommunication::loop() {
                     } else {
 
                         packet->sendAttempts--;
-                        packet->sendTimestamp = micros();
+                        packet->sendTimestamp = NOW();
 
                         dataLink_->sendBuffer(packet->dataBuffer, packet->bufferSize);
 
@@ -197,7 +197,7 @@ void KraftKommunication::loop() {
 
                 if (message.messageData.receiverID == selfID_ || message.messageData.receiverID == eKraftPacketNodeID_t::eKraftPacketNodeID_broadcast) { //Make sure packet is for us.
 
-                    nodeData_[message.messageData.transmitterID].lastPacketTimestamp = millis();
+                    nodeData_[message.messageData.transmitterID].lastPacketTimestamp = NOW();
                     nodeData_[message.messageData.transmitterID].online = true;
 
                     switch (message.messageData.payloadID) {
@@ -251,7 +251,7 @@ void KraftKommunication::loop() {
     //Check for timeout on all nodes.
     for (uint8_t i = 0; i < 0; i++) {
 
-        if (millis() - nodeData_[i].lastPacketTimestamp >= 500) {
+        if (NOW() - nodeData_[i].lastPacketTimestamp >= 500*MILLISECONDS) {
             
             nodeData_[i].online = false;
 
@@ -7,6 +7,8 @@
 
 #include "stdint.h"
 
+#include "utils/system_time.h"
+
 #include "buffer.h"
 
 #include "kraft_link.h"
@@ -191,18 +193,20 @@ private:
 
         eKraftPacketNodeID_t receivingNodeID = eKraftPacketNodeID_t::eKraftPacketNodeID_broadcast;
 
-        uint32_t sendTimestamp = 0;
+        //Time of the last attempt in nanoseconds, see NOW().
+        int64_t sendTimestamp = 0;
         uint8_t sendAttempts = 0;
 
-        uint32_t sendInterval = 0;
+        //Time to wait for an ack before the next attempt in nanoseconds.
+        int64_t sendInterval = 0;
 
     };
 
     //Struct to store information about a node
     struct NodeData {
 
-        //Stores the last time a packet was received. Used to see if still connected.
-        uint32_t lastPacketTimestamp = 0;
+        //Stores the last time a packet was received in nanoseconds. Used to see if still connected.
+        int64_t lastPacketTimestamp = 0;
 
         //Whether the node is online. 
         bool online = false;
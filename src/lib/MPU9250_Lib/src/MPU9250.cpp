@@ -383,6 +383,10 @@ bool Mpu9250::ConfigDlpf(const DlpfBandwidth dlpf) {
       requested_dlpf = dlpf;
       break;
     }
+    case DLPF_BANDWIDTH_3600HZ_8kHz: {
+      requested_dlpf = dlpf;
+      break;
+    }
     case DLPF_BANDWIDTH_DISABLE_32kHz: {
       requested_dlpf = dlpf;
       break;
@@ -406,12 +410,30 @@ bool Mpu9250::ConfigDlpf(const DlpfBandwidth dlpf) {
     if (!WriteRegister(GYRO_CONFIG_, reg)) {
         return false;
     }
+  } else if (dlpf == DLPF_BANDWIDTH_3600HZ_8kHz) {
+
+    /* Accel DLPF bypassed, runs at 4kHz */
+    if (!WriteRegister(ACCEL_CONFIG2_, B00001000)) {
+        return false;
+    }
+    /* Gyro DLPF setting 7 needs FCHOICE on, in case 32kHz was set before */
+    uint8_t reg;
+    if (!ReadRegisters(GYRO_CONFIG_, 1, &reg)) {
+        return false;
+    }
+    reg &= B11111100;
+    if (!WriteRegister(GYRO_CONFIG_, reg)) {
+        return false;
+    }
+    if (!WriteRegister(CONFIG_, requested_dlpf | (fifo_frame_size_ > 0 ? FIFO_MODE_STOP_ : 0))) {
+        return false;
+    }
   } else {
     /* Try setting the dlpf */
     if (!WriteRegister(ACCEL_CONFIG2_, requested_dlpf)) {
         return false;
     }
-    if (!WriteRegister(CONFIG_, requested_dlpf)) {
+    if (!WriteRegister(CONFIG_, requested_dlpf | (fifo_frame_size_ > 0 ? FIFO_MODE_STOP_ : 0))) {
         return false;
     }
   }
@@ -423,6 +445,113 @@ void Mpu9250::DrdyCallback(uint8_t int_pin, void (*function)()) {
   pinMode(int_pin, INPUT);
   attachInterrupt(int_pin, function, RISING);
 }
+bool Mpu9250::EnableFifo(bool accel, bool gyro) {
+  spi_clock_ = 1000000;
+  fifo_accel_ = accel;
+  fifo_gyro_ = gyro;
+  fifo_frame_size_ = (accel ? 6 : 0) + (gyro ? 6 : 0);
+  fifo_num_frames_ = 0;
+  /* Stop writing once full, so frames stay aligned if the FIFO is read too late */
+  if (!WriteRegister(CONFIG_, (dlpf_bandwidth_ == DLPF_BANDWIDTH_DISABLE_32kHz ? 0 : dlpf_bandwidth_) | FIFO_MODE_STOP_)) {
+    return false;
+  }
+  if (!WriteRegister(FIFO_EN_, (accel ? FIFO_ACCEL_ : 0) | (gyro ? FIFO_GYRO_ : 0))) {
+    return false;
+  }
+  return ResetFifo();
+}
+bool Mpu9250::DisableFifo() {
+  spi_clock_ = 1000000;
+  fifo_accel_ = false;
+  fifo_gyro_ = false;
+  fifo_frame_size_ = 0;
+  fifo_num_frames_ = 0;
+  if (!WriteRegister(FIFO_EN_, FIFO_DISABLE_)) {
+    return false;
+  }
+  if (!WriteRegister(USER_CTRL_, I2C_MST_EN_)) {
+    return false;
+  }
+  return true;
+}
+bool Mpu9250::ResetFifo() {
+  /* FIFO_RST clears itself, so the write can not be verified. No delays, used while running */
+  if (!WriteRegister(USER_CTRL_, I2C_MST_EN_ | USER_CTRL_FIFO_EN_ | FIFO_RST_, false)) {
+    return false;
+  }
+  return true;
+}
+int16_t Mpu9250::ReadFifo() {
+  spi_clock_ = 20000000;
+  fifo_num_frames_ = 0;
+  fifo_overflowed_ = false;
+  if (fifo_frame_size_ == 0) {
+    return -1;
+  }
+  /* Read the number of bytes in the FIFO */
+  uint8_t count_buff[2];
+  if (!ReadRegisters(FIFO_COUNTH_, sizeof(count_buff), count_buff)) {
+    return -1;
+  }
+  uint16_t count = ParseFifoCount(count_buff);
+  uint16_t bytes = count / fifo_frame_size_ * fifo_frame_size_;
+  /* SPI reads all frames in one burst, I2C in parts its buffer can hold */
+  uint16_t burst = bytes;
+  if (iface_ == I2C) {
+    burst = I2C_FIFO_BURST_ / fifo_frame_size_ * fifo_frame_size_;
+  }
+  for (uint16_t i = 0; i < bytes; i += burst) {
+    uint16_t part = bytes - i < burst ? bytes - i : burst;
+    if (!ReadRegisters(FIFO_R_W_, part, &fifo_buff_[i])) {
+      ResetFifo();
+      return -1;
+    }
+  }
+  int16_t frames = ParseFifo(fifo_buff_, count);
+  /* A full FIFO can hold part of a frame, start again aligned */
+  if (fifo_overflowed_) {
+    ResetFifo();
+  }
+  return frames;
+}
+uint16_t Mpu9250::ParseFifoCount(const uint8_t *count_buff) const {
+  uint16_t count = (static_cast<uint16_t>(count_buff[0] & 0x1F) << 8) | count_buff[1];
+  return count > FIFO_SIZE_ ? FIFO_SIZE_ : count;
+}
+int16_t Mpu9250::ParseFifo(const uint8_t *data, uint16_t count) {
+  fifo_num_frames_ = 0;
+  fifo_overflowed_ = false;
+  if (fifo_frame_size_ == 0) {
+    return -1;
+  }
+  if (count > FIFO_SIZE_) {
+    count = FIFO_SIZE_;
+  }
+  /* FIFO stops when full, newer samples were lost */
+  fifo_overflowed_ = count > FIFO_SIZE_ - fifo_frame_size_;
+  uint16_t frames = count / fifo_frame_size_;
+  if (data != fifo_buff_) {
+    memcpy(fifo_buff_, data, frames * fifo_frame_size_);
+  }
+  fifo_num_frames_ = frames;
+  return frames;
+}
+void Mpu9250::fifo_accel_mps2(uint16_t index, float *data) const {
+  int16_t counts[3];
+  fifo_accel_counts(index, counts);
+  ConvertAccel(counts, data);
+}
+void Mpu9250::fifo_gyro_radps(uint16_t index, float *data) const {
+  int16_t counts[3];
+  fifo_gyro_counts(index, counts);
+  ConvertGyro(counts, data);
+}
+void Mpu9250::fifo_accel_counts(uint16_t index, int16_t *counts) const {
+  ParseCounts(&fifo_buff_[index * fifo_frame_size_], counts);
+}
+void Mpu9250::fifo_gyro_counts(uint16_t index, int16_t *counts) const {
+  ParseCounts(&fifo_buff_[index * fifo_frame_size_ + (fifo_accel_ ? 6 : 0)], counts);
+}
 bool Mpu9250::Read() {
   spi_clock_ = 20000000;
   /* Read the data registers */
@@ -435,39 +564,63 @@ bool Mpu9250::Read() {
   if (!data_ready) {
     return false;
   }
-  /* Unpack the buffer */
-  int16_t accel_counts[3], gyro_counts[3], temp_counts, mag_counts[3];
-  accel_counts[0] = static_cast<int16_t>(data_buff[1])  << 8 | data_buff[2];
-  accel_counts[1] = static_cast<int16_t>(data_buff[3])  << 8 | data_buff[4];
-  accel_counts[2] = static_cast<int16_t>(data_buff[5])  << 8 | data_buff[6];
-  temp_counts =     static_cast<int16_t>(data_buff[7])  << 8 | data_buff[8];
-  gyro_counts[0] =  static_cast<int16_t>(data_buff[9])  << 8 | data_buff[10];
-  gyro_counts[1] =  static_cast<int16_t>(data_buff[11]) << 8 | data_buff[12];
-  gyro_counts[2] =  static_cast<int16_t>(data_buff[13]) << 8 | data_buff[14];
-  mag_counts[0] =   static_cast<int16_t>(data_buff[16]) << 8 | data_buff[15];
-  mag_counts[1] =   static_cast<int16_t>(data_buff[18]) << 8 | data_buff[17];
-  mag_counts[2] =   static_cast<int16_t>(data_buff[20]) << 8 | data_buff[19];
-  /* Convert to float values and rotate the accel / gyro axis */
-  accel_mps2_[0] = static_cast<float>(accel_counts[1]) * accel_scale_ *
-                   9.80665f;
-  accel_mps2_[2] = static_cast<float>(accel_counts[2]) * accel_scale_ *
-                   -9.80665f;
-  accel_mps2_[1] = static_cast<float>(accel_counts[0]) * accel_scale_ *
-                   9.80665f;
+  /* Unpack the buffer and rotate the accel / gyro axis */
+  ParseCounts(&data_buff[1], accel_counts_);
+  ConvertAccel(accel_counts_, accel_mps2_);
+  int16_t temp_counts = static_cast<int16_t>(data_buff[7])  << 8 | data_buff[8];
   die_temperature_c_ = (static_cast<float>(temp_counts) - 21.0f) / temp_scale_
                      + 21.0f;
-  gyro_radps_[1] = static_cast<float>(gyro_counts[0]) * gyro_scale_ *
-                   3.14159265358979323846f / 180.0f;
-  gyro_radps_[0] = static_cast<float>(gyro_counts[1]) * gyro_scale_ *
-                   3.14159265358979323846f / 180.0f;
-  gyro_radps_[2] = static_cast<float>(gyro_counts[2]) * gyro_scale_ *
-                   -1.0f * 3.14159265358979323846f / 180.0f;
-  mag_ut_[0] =   static_cast<float>(mag_counts[0]) * mag_scale_[0];
-  mag_ut_[1] =   static_cast<float>(mag_counts[1]) * mag_scale_[1];
-  mag_ut_[2] =   static_cast<float>(mag_counts[2]) * mag_scale_[2];
+  ParseCounts(&data_buff[9], gyro_counts_);
+  ConvertGyro(gyro_counts_, gyro_radps_);
+  ParseMagCounts(&data_buff[15], mag_counts_);
+  ConvertMag(mag_counts_, mag_ut_);
+  return true;
+}
+bool Mpu9250::ReadMag() {
+  spi_clock_ = 20000000;
+  uint8_t data_buff[6];
+  if (!ReadRegisters(EXT_SENS_DATA_00_, sizeof(data_buff), data_buff)) {
+    return false;
+  }
+  ParseMag(data_buff);
   return true;
 }
-bool Mpu9250::WriteRegister(uint8_t reg, uint8_t data) {
+void Mpu9250::ParseMag(const uint8_t *data) {
+  ParseMagCounts(data, mag_counts_);
+  ConvertMag(mag_counts_, mag_ut_);
+}
+void Mpu9250::ParseCounts(const uint8_t *buff, int16_t *counts) {
+  counts[0] = static_cast<int16_t>(buff[0]) << 8 | buff[1];
+  counts[1] = static_cast<int16_t>(buff[2]) << 8 | buff[3];
+  counts[2] = static_cast<int16_t>(buff[4]) << 8 | buff[5];
+}
+void Mpu9250::ParseMagCounts(const uint8_t *buff, int16_t *counts) {
+  counts[0] = static_cast<int16_t>(buff[1]) << 8 | buff[0];
+  counts[1] = static_cast<int16_t>(buff[3]) << 8 | buff[2];
+  counts[2] = static_cast<int16_t>(buff[5]) << 8 | buff[4];
+}
+void Mpu9250::ConvertAccel(const int16_t *accel_counts, float *accel) const {
+  accel[0] = static_cast<float>(accel_counts[1]) * accel_scale_ *
+             9.80665f;
+  accel[2] = static_cast<float>(accel_counts[2]) * accel_scale_ *
+             -9.80665f;
+  accel[1] = static_cast<float>(accel_counts[0]) * accel_scale_ *
+             9.80665f;
+}
+void Mpu9250::ConvertGyro(const int16_t *gyro_counts, float *gyro) const {
+  gyro[1] = static_cast<float>(gyro_counts[0]) * gyro_scale_ *
+            3.14159265358979323846f / 180.0f;
+  gyro[0] = static_cast<float>(gyro_counts[1]) * gyro_scale_ *
+            3.14159265358979323846f / 180.0f;
+  gyro[2] = static_cast<float>(gyro_counts[2]) * gyro_scale_ *
+            -1.0f * 3.14159265358979323846f / 180.0f;
+}
+void Mpu9250::ConvertMag(const int16_t *mag_counts, float *mag) const {
+  mag[0] = static_cast<float>(mag_counts[0]) * mag_scale_[0];
+  mag[1] = static_cast<float>(mag_counts[1]) * mag_scale_[1];
+  mag[2] = static_cast<float>(mag_counts[2]) * mag_scale_[2];
+}
+bool Mpu9250::WriteRegister(uint8_t reg, uint8_t data, bool verify) {
   uint8_t ret_val;
   if (iface_ == I2C) {
     i2c_->beginTransmission(conn_);
@@ -502,6 +655,9 @@ bool Mpu9250::WriteRegister(uint8_t reg, uint8_t data) {
     #endif
     spi_->endTransaction();
   }
+  if (!verify) {
+    return true;
+  }
   delay(10);
   ReadRegisters(reg, sizeof(ret_val), &ret_val);
   delay(10);
@@ -511,12 +667,12 @@ bool Mpu9250::WriteRegister(uint8_t reg, uint8_t data) {
     return false;
   }
 }
-bool Mpu9250::ReadRegisters(uint8_t reg, uint8_t count, uint8_t *data) {
+bool Mpu9250::ReadRegisters(uint8_t reg, uint16_t count, uint8_t *data) {
   if (iface_ == I2C) {
     i2c_->beginTransmission(conn_);
     i2c_->write(reg);
     i2c_->endTransmission(false);
-    uint8_t bytes_rx = i2c_->requestFrom(conn_, count);
+    uint8_t bytes_rx = i2c_->requestFrom(conn_, static_cast<uint8_t>(count));
     if (bytes_rx == count) {
       for (int i = 0; i < count; i++) {
         data[i] = i2c_->read();
@@ -40,6 +40,8 @@ class Mpu9250 {
     DLPF_BANDWIDTH_20HZ = 0x04,
     DLPF_BANDWIDTH_10HZ = 0x05,
     DLPF_BANDWIDTH_5HZ = 0x06,
+    /* Gyro 3600Hz at 8kHz, accel 1130Hz at 4kHz. Both without their DLPF */
+    DLPF_BANDWIDTH_3600HZ_8kHz = 0x07,
     DLPF_BANDWIDTH_DISABLE_32kHz = 0xAA
   };
   enum AccelRange : uint8_t {
@@ -70,7 +72,20 @@ class Mpu9250 {
   bool ConfigDlpf(const DlpfBandwidth dlpf);
   inline DlpfBandwidth dlpf() const {return dlpf_bandwidth_;}
   void DrdyCallback(uint8_t int_pin, void (*function)());
+  bool EnableFifo(bool accel, bool gyro);
+  bool DisableFifo();
+  bool ResetFifo();
+  int16_t ReadFifo();
   bool Read();
+  bool ReadMag();
+  /* For reading FIFO and mag outside of the library, e.g. with DMA. Data follows the command byte */
+  inline uint8_t fifo_count_read_cmd() const {return FIFO_COUNTH_ | SPI_READ_;}
+  inline uint8_t fifo_read_cmd() const {return FIFO_R_W_ | SPI_READ_;}
+  inline uint8_t mag_read_cmd() const {return EXT_SENS_DATA_00_ | SPI_READ_;}
+  inline uint8_t fifo_frame_size() const {return fifo_frame_size_;}
+  uint16_t ParseFifoCount(const uint8_t *count_buff) const;
+  int16_t ParseFifo(const uint8_t *data, uint16_t count);
+  void ParseMag(const uint8_t *data);
   inline float accel_x_mps2() const {return accel_mps2_[0];}
   inline float accel_y_mps2() const {return accel_mps2_[1];}
   inline float accel_z_mps2() const {return accel_mps2_[2];}
@@ -81,6 +96,19 @@ class Mpu9250 {
   inline float mag_y_ut() const {return mag_ut_[1];}
   inline float mag_z_ut() const {return mag_ut_[2];}
   inline float die_temperature_c() const {return die_temperature_c_;}
+  inline uint16_t fifo_size() const {return fifo_num_frames_;}
+  inline bool fifo_overflowed() const {return fifo_overflowed_;}
+  void fifo_accel_mps2(uint16_t index, float *data) const;
+  void fifo_gyro_radps(uint16_t index, float *data) const;
+  /* Counts as read, in the axis order of the sensors. Scales convert them to the units above */
+  inline const int16_t *accel_counts() const {return accel_counts_;}
+  inline const int16_t *gyro_counts() const {return gyro_counts_;}
+  inline const int16_t *mag_counts() const {return mag_counts_;}
+  void fifo_accel_counts(uint16_t index, int16_t *counts) const;
+  void fifo_gyro_counts(uint16_t index, int16_t *counts) const;
+  inline float accel_scale_mps2() const {return accel_scale_ * 9.80665f;}
+  inline float gyro_scale_radps() const {return gyro_scale_ * 3.14159265358979323846f / 180.0f;}
+  inline float mag_scale_ut(uint8_t axis) const {return mag_scale_[axis];}
 
  private:
   enum Interface {
@@ -111,7 +139,19 @@ class Mpu9250 {
   float accel_mps2_[3];
   float gyro_radps_[3];
   float mag_ut_[3];
+  int16_t accel_counts_[3];
+  int16_t gyro_counts_[3];
+  int16_t mag_counts_[3];
   float die_temperature_c_;
+  /* FIFO */
+  static constexpr uint16_t FIFO_SIZE_ = 512;
+  static constexpr uint8_t I2C_FIFO_BURST_ = 32;
+  bool fifo_accel_ = false;
+  bool fifo_gyro_ = false;
+  uint8_t fifo_frame_size_ = 0;
+  uint16_t fifo_num_frames_ = 0;
+  bool fifo_overflowed_ = false;
+  uint8_t fifo_buff_[FIFO_SIZE_];
   /* Registers */
   static constexpr uint8_t PWR_MGMNT_1_ = 0x6B;
   static constexpr uint8_t H_RESET_ = 0x80;
@@ -140,6 +180,15 @@ class Mpu9250 {
   static constexpr uint8_t I2C_READ_FLAG_ = 0x80;
   static constexpr uint8_t I2C_SLV0_EN_ = 0x80;
   static constexpr uint8_t EXT_SENS_DATA_00_ = 0x49;
+  static constexpr uint8_t FIFO_EN_ = 0x23;
+  static constexpr uint8_t FIFO_GYRO_ = 0x70;
+  static constexpr uint8_t FIFO_ACCEL_ = 0x08;
+  static constexpr uint8_t FIFO_DISABLE_ = 0x00;
+  static constexpr uint8_t USER_CTRL_FIFO_EN_ = 0x40;
+  static constexpr uint8_t FIFO_RST_ = 0x04;
+  static constexpr uint8_t FIFO_MODE_STOP_ = 0x40;
+  static constexpr uint8_t FIFO_COUNTH_ = 0x72;
+  static constexpr uint8_t FIFO_R_W_ = 0x74;
   /* AK8963 registers */
   static constexpr uint8_t AK8963_I2C_ADDR_ = 0x0C;
   static constexpr uint8_t AK8963_HXL_ = 0x03;
@@ -152,8 +201,13 @@ class Mpu9250 {
   static constexpr uint8_t AK8963_RESET_ = 0x01;
   static constexpr uint8_t AK8963_ASA_ = 0x10;
   static constexpr uint8_t AK8963_WHOAMI_ = 0x00;
-  bool WriteRegister(uint8_t reg, uint8_t data);
-  bool ReadRegisters(uint8_t reg, uint8_t count, uint8_t *data);
+  bool WriteRegister(uint8_t reg, uint8_t data, bool verify = true);
+  bool ReadRegisters(uint8_t reg, uint16_t count, uint8_t *data);
+  void ConvertAccel(const int16_t *accel_counts, float *accel) const;
+  void ConvertGyro(const int16_t *gyro_counts, float *gyro) const;
+  void ConvertMag(const int16_t *mag_counts, float *mag) const;
+  static void ParseCounts(const uint8_t *buff, int16_t *counts);
+  static void ParseMagCounts(const uint8_t *buff, int16_t *counts);
   bool WriteAk8963Register(uint8_t reg, uint8_t data);
   bool ReadAk8963Registers(uint8_t reg, uint8_t count, uint8_t *data);
 };
@@ -0,0 +1,44 @@
+#ifndef SIMULATOR_ARDUINO_H
+#define SIMULATOR_ARDUINO_H
+
+
+/**
+ * Replaces the Arduino core when Simple-Schedule is built for the host with the native environment.
+ * Only what the scheduler needs is provided. Time comes from the virtual clock of the ScheduleSimulator,
+ * so it only moves when the simulator advances it.
+*/
+
+
+
+#include "stdint.h"
+
+
+
+/**
+ * @returns virtual time in microseconds. Wraps like on hardware.
+ */
+uint32_t micros();
+
+/**
+ * @returns virtual time in milliseconds.
+ */
+uint32_t millis();
+
+/**
+ * Called by the scheduler on every tick. Advances the virtual clock by the tick cost.
+ */
+void yield();
+
+/**
+ * Advances the virtual clock by the given time.
+ */
+void delay(uint32_t ms);
+
+/**
+ * Advances the virtual clock by the given time.
+ */
+void delayMicroseconds(uint32_t us);
+
+
+
+#endif
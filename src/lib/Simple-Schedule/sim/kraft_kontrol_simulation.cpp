@@ -0,0 +1,213 @@
+#include "schedule_simulator.h"
+#include "tick_benchmark.h"
+
+#include "stdio.h"
+#include "string.h"
+
+
+
+/**
+ * Simulates the tasks of a KraftKontrol flight controller on the host.
+ * Execution times are estimates and should be replaced with measured ones from the task statistics.
+ * Built and run with: pio run -e native && .pio/build/native/program
+ * With --benchmark only the scheduler tick benchmark is run, see tick_benchmark.h.
+*/
+
+
+
+/**
+ * Runs the flight controller tasks once and prints the report.
+ *
+ * @param title is printed above the report.
+ * @param policy is the schedule policy to use.
+ * @param pipeline if true then the GNC tasks run as a pipeline after the IMU.
+ * @param ekfCost_us is the execution time of an additional 8kHz EKF. 0 for none.
+ * @param autoPhase if false then all tasks with the same rate become due at the same time.
+ * @param downloadCost_us is the longest execution time of a 1kHz log download. 0 for none.
+ * @param shedding if false then no task is shed while overloaded.
+ * @param settle_s is the time simulated before measuring, e.g. so the overload detection can act.
+ */
+static void simulate(const char* title, const eSchedulePolicy_t &policy, const bool &pipeline, const float &ekfCost_us, const bool &autoPhase = true, const float &downloadCost_us = 0, const bool &shedding = true, const float &settle_s = 0) {
+
+    ScheduleSimulator& simulator = getGlobalSimulator();
+    simulator.setSeed(1);
+    Task_Abstract::setSchedulerPolicy(policy);
+    Task_Abstract::setSchedulerAutoPhase(autoPhase);
+
+    SimulatedTask imu("MPU9250", 0, eTaskPriority_t::eTaskPriority_Realtime, 15, 25);
+    SimulatedTask baro("BME280", 200, eTaskPriority_t::eTaskPriority_Realtime, 30, 50);
+    SimulatedTask gnss("UbloxGNSS", 100, eTaskPriority_t::eTaskPriority_Realtime, 5, 150);
+    SimulatedTask adc("ADS1115", 1000, eTaskPriority_t::eTaskPriority_Realtime, 8, 12);
+    SimulatedTask navigation("Navigation", 8000, eTaskPriority_t::eTaskPriority_VeryHigh, 20, 35);
+    SimulatedTask guidance("Guidance", 1000, eTaskPriority_t::eTaskPriority_High, 3, 6);
+    SimulatedTask control("Control", 1000, eTaskPriority_t::eTaskPriority_High, 15, 25);
+    SimulatedTask vehicle("Vehicle", 8000, eTaskPriority_t::eTaskPriority_High, 4, 8);
+    SimulatedTask network("KraftKonnect", 1000, eTaskPriority_t::eTaskPriority_Middle, 10, 60);
+    SimulatedTask radio("SX1280", 0, eTaskPriority_t::eTaskPriority_Middle, 20, 40);
+    SimulatedTask display("ST7735", 20, eTaskPriority_t::eTaskPriority_Low, 200, 400);
+    SimulatedTask download("LogDownload", 1000, eTaskPriority_t::eTaskPriority_Low, downloadCost_us/4, downloadCost_us);
+    if (downloadCost_us <= 0) download.stopTaskThreading();
+
+    //Parsing GNSS messages takes longer than a frame, so it runs in the background with the cyclic executive.
+    if (policy == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) {
+        gnss.stopTaskThreading();
+        gnss.setTaskPriority(eTaskPriority_t::eTaskPriority_Middle);
+        gnss.startTaskThreading();
+    }
+
+    //Same shedding as the real modules. A log download can always wait.
+    if (shedding) {
+        network.setTaskShedding(eTaskShedding_t::eTaskShedding_ReduceRate);
+        display.setTaskShedding(eTaskShedding_t::eTaskShedding_Skip);
+        download.setTaskShedding(eTaskShedding_t::eTaskShedding_Skip);
+    }
+
+    navigation.addInput(&imu);
+    guidance.addInput(&navigation);
+    control.addInput(&guidance);
+    vehicle.addInput(&control);
+
+    if (pipeline) {
+        navigation.addTaskUpstream(&imu);
+        guidance.addTaskUpstream(&navigation);
+        control.addTaskUpstream(&guidance);
+        vehicle.addTaskUpstream(&control);
+    }
+
+    SimulatedTask ekf("EKF", 8000, eTaskPriority_t::eTaskPriority_VeryHigh, ekfCost_us*0.9f, ekfCost_us*1.1f);
+    ekf.addInput(&imu);
+    if (ekfCost_us <= 0) ekf.stopTaskThreading();
+    else if (pipeline) ekf.addTaskUpstream(&imu);
+
+    simulator.addInterrupt(&imu, 4000, 1);
+    simulator.addInterrupt(&radio, 200, 50);
+
+    if (settle_s > 0) simulator.run(settle_s);
+    simulator.run(2);
+    simulator.printReport(title);
+
+}
+
+
+/**
+ * Runs a task set at about 80% load that starves the lower priorities, once per policy.
+ * Used to compare the priority and earliest deadline policies.
+ *
+ * @param title is printed above the report.
+ * @param policy is the schedule policy to use.
+ */
+static void simulateHighLoad(const char* title, const eSchedulePolicy_t &policy) {
+
+    ScheduleSimulator& simulator = getGlobalSimulator();
+    simulator.setSeed(1);
+    Task_Abstract::setSchedulerPolicy(policy);
+    Task_Abstract::setSchedulerAutoPhase(true);
+
+    SimulatedTask imu("IMU", 35000, eTaskPriority_t::eTaskPriority_Realtime, 10, 14);
+    SimulatedTask navigation("Navigation", 8000, eTaskPriority_t::eTaskPriority_VeryHigh, 25, 35);
+    SimulatedTask vehicle("Vehicle", 8000, eTaskPriority_t::eTaskPriority_High, 5, 8);
+    SimulatedTask guidance("Guidance", 1000, eTaskPriority_t::eTaskPriority_High, 20, 40);
+    SimulatedTask control("Control", 1000, eTaskPriority_t::eTaskPriority_High, 20, 40);
+    SimulatedTask telemetry("Telemetry", 1000, eTaskPriority_t::eTaskPriority_Middle, 20, 40);
+    SimulatedTask display("Display", 1000, eTaskPriority_t::eTaskPriority_Low, 20, 40);
+    SimulatedTask logger("Logger", 100, eTaskPriority_t::eTaskPriority_VeryLow, 50, 150);
+
+    navigation.addInput(&imu);
+    vehicle.addInput(&navigation);
+
+    simulator.run(5);
+    simulator.printReport(title);
+
+}
+
+
+/**
+ * Checks that event tasks only run when notified or once their timeout passed.
+ *
+ * @returns true if all event tasks ran as often as expected.
+ */
+static bool checkEventTasks() {
+
+    ScheduleSimulator& simulator = getGlobalSimulator();
+    simulator.setSeed(1);
+    Task_Abstract::setSchedulerPolicy(eSchedulePolicy_t::eSchedulePolicy_Priority);
+
+    SimulatedTask silent("Silent", 0, eTaskPriority_t::eTaskPriority_High, 5, 5);
+    SimulatedTask notified("Notified", 0, eTaskPriority_t::eTaskPriority_High, 5, 5);
+    SimulatedTask timeout("Timeout", 0, eTaskPriority_t::eTaskPriority_High, 5, 5);
+
+    //Timeout is only used when attached.
+    timeout.stopTaskThreading();
+    timeout.setTaskEventTimeout(10000);
+    timeout.startTaskThreading();
+
+    simulator.addInterrupt(&notified, 1000);
+
+    simulator.run(0.1);
+
+    //First timeout run is 10ms after attaching, not right after init.
+    bool passed = silent.getRuns() == 0 && notified.getRuns() == 100 && timeout.getRuns() == 9;
+    printf("Event task check %s: never notified ran %u times, notified at 1kHz %u times, 10ms timeout %u times in 100ms.\n", passed ? "passed" : "FAILED", silent.getRuns(), notified.getRuns(), timeout.getRuns());
+
+    return passed;
+
+}
+
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+/**
+ * Writes the trace of the last milliseconds simulated to a file.
+ * Convert with tools/trace_to_chrome.cpp to view it.
+ *
+ * @param fileName is the file to write.
+ */
+static void writeTrace(const char* fileName) {
+
+    FILE* file = fopen(fileName, "wb");
+    if (file == nullptr) return;
+
+    //Tasks of the last run are already removed and gave their names to the trace then.
+    taskTrace.beginRead();
+
+    uint8_t buffer[256];
+    uint32_t length;
+    while ((length = taskTrace.read(buffer, sizeof(buffer))) > 0) fwrite(buffer, 1, length, file);
+
+    taskTrace.endRead();
+
+    fclose(file);
+    printf("Trace written to %s\n", fileName);
+
+}
+#endif
+
+
+int main(int argc, char** argv) {
+
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+        benchmarkSchedulerTick();
+        return 0;
+    }
+
+    if (!checkEventTasks()) return 1;
+
+    simulate("Priority policy without phase staggering", eSchedulePolicy_t::eSchedulePolicy_Priority, false, 0, false);
+    simulate("Priority policy", eSchedulePolicy_t::eSchedulePolicy_Priority, false, 0);
+    simulate("Earliest deadline policy", eSchedulePolicy_t::eSchedulePolicy_EarliestDeadline, false, 0);
+    simulateHighLoad("Priority policy at 80% load", eSchedulePolicy_t::eSchedulePolicy_Priority);
+    simulateHighLoad("Earliest deadline policy at 80% load", eSchedulePolicy_t::eSchedulePolicy_EarliestDeadline);
+    simulate("Priority policy with GNC pipeline", eSchedulePolicy_t::eSchedulePolicy_Priority, true, 0);
+#ifdef SIMPLE_SCHEDULE_TRACE
+    writeTrace("schedule_trace.bin");
+#endif
+    simulate("Priority policy with GNC pipeline and 8kHz EKF taking 60us", eSchedulePolicy_t::eSchedulePolicy_Priority, true, 60);
+    //Measured after 4s, when repeated overloads made the scheduler keep the download shed for longer.
+    simulate("Overload from a 1kHz log download taking up to 600us without shedding", eSchedulePolicy_t::eSchedulePolicy_Priority, true, 0, true, 600, false, 4);
+    simulate("Overload from a 1kHz log download taking up to 600us with shedding", eSchedulePolicy_t::eSchedulePolicy_Priority, true, 0, true, 600, true, 4);
+    simulate("Cyclic executive with GNC order", eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive, true, 0);
+    simulate("Cyclic executive with GNC order and 8kHz EKF taking 20us", eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive, true, 20);
+    simulate("Cyclic executive with 8kHz EKF taking 60us, frames do not fit", eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive, true, 60);
+
+    return 0;
+
+}
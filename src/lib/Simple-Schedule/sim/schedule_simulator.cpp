@@ -0,0 +1,307 @@
+#include "schedule_simulator.h"
+
+#include "stdio.h"
+
+
+
+uint32_t micros() {
+    return getGlobalSimulator().getTime_ns()/1000;
+}
+
+
+uint32_t millis() {
+    return getGlobalSimulator().getTime_ns()/1000000;
+}
+
+
+void yield() {
+    getGlobalSimulator().tick();
+}
+
+
+void delay(uint32_t ms) {
+    getGlobalSimulator().advance((uint64_t)ms*1000000);
+}
+
+
+void delayMicroseconds(uint32_t us) {
+    getGlobalSimulator().advance((uint64_t)us*1000);
+}
+
+
+//Called by the simulated frame timer.
+static void runFrame() {
+    getGlobalScheduler().runNextFrame();
+}
+
+
+
+SimulatedTask::SimulatedTask(const char* name, uint32_t rate_Hz, eTaskPriority_t priority, float costMin_us, float costMax_us) : Task_Abstract(rate_Hz, priority) {
+    setTaskName(name);
+    setCost(costMin_us, costMax_us);
+    setTaskBudget(costMax_us + 0.999f);
+    getGlobalSimulator().addTask(this);
+    startTaskThreading();
+}
+
+
+SimulatedTask::~SimulatedTask() {
+    getGlobalSimulator().removeTask(this);
+}
+
+
+bool SimulatedTask::addInput(SimulatedTask* input) {
+
+    if (numberInputs_ >= SIMULATED_TASK_MAX_INPUTS) return false;
+
+    inputs_[numberInputs_++] = input;
+
+    return true;
+
+}
+
+
+void SimulatedTask::thread() {
+
+    ScheduleSimulator& simulator = getGlobalSimulator();
+    uint64_t start = simulator.getTime_ns();
+
+    //Sources stamp their data with the interrupt or the run. Other tasks use the newest data of their inputs.
+    uint64_t dataTime = 0;
+    if (numberInputs_ == 0) {
+        dataTime = interruptTime_ns_ != 0 ? interruptTime_ns_ : start;
+        interruptTime_ns_ = 0;
+    } else {
+        for (uint8_t i = 0; i < numberInputs_; i++) if (inputs_[i]->getDataTime_ns() > dataTime) dataTime = inputs_[i]->getDataTime_ns();
+    }
+
+    uint64_t cost = costMin_ns_;
+    if (costMax_ns_ > costMin_ns_) cost += simulator.random()%(costMax_ns_ - costMin_ns_ + 1);
+    simulator.advance(cost);
+
+    runs_++;
+    busyTime_ns_ += cost;
+
+    //Only runs with new data count. Running again on the same data does not make it older for the output.
+    if (dataTime != 0 && dataTime != dataTime_ns_) {
+        uint64_t latency = simulator.getTime_ns() - dataTime;
+        latencySum_ns_ += latency;
+        latencyCounter_++;
+        if (latency > latencyMax_ns_) latencyMax_ns_ = latency;
+        dataTime_ns_ = dataTime;
+        releaseDependentTasks();
+    }
+
+}
+
+
+void SimulatedTask::interrupt(const uint64_t &time_ns) {
+    interruptTime_ns_ = time_ns;
+    notifyFromISR();
+}
+
+
+void SimulatedTask::resetMeasurements() {
+    runs_ = 0;
+    busyTime_ns_ = 0;
+    latencySum_ns_ = 0;
+    latencyMax_ns_ = 0;
+    latencyCounter_ = 0;
+}
+
+
+
+bool ScheduleSimulator::addInterrupt(SimulatedTask* task, const float &rate_Hz, const float &jitter_us) {
+
+    if (numberInterrupts_ >= SCHEDULE_SIMULATOR_MAX_INTERRUPTS || rate_Hz <= 0) return false;
+
+    Interrupt& interrupt = interrupts_[numberInterrupts_++];
+    interrupt.task = task;
+    interrupt.function = nullptr;
+    interrupt.running = false;
+    interrupt.period_ns = 1000000000.0f/rate_Hz;
+    interrupt.jitter_ns = jitter_us*1000;
+    interrupt.nominal_ns = time_ns_ + interrupt.period_ns;
+    interrupt.next_ns = interrupt.nominal_ns;
+
+    return true;
+
+}
+
+
+bool ScheduleSimulator::addTimer(void (*function)(), const uint32_t &period_us) {
+
+    if (numberInterrupts_ >= SCHEDULE_SIMULATOR_MAX_INTERRUPTS || period_us == 0) return false;
+
+    Interrupt& interrupt = interrupts_[numberInterrupts_++];
+    interrupt.task = nullptr;
+    interrupt.function = function;
+    interrupt.running = false;
+    interrupt.period_ns = (uint64_t)period_us*1000;
+    interrupt.jitter_ns = 0;
+    interrupt.nominal_ns = time_ns_ + interrupt.period_ns;
+    interrupt.next_ns = interrupt.nominal_ns;
+
+    return true;
+
+}
+
+
+void ScheduleSimulator::removeTimer(void (*function)()) {
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < numberInterrupts_; i++) if (interrupts_[i].task != nullptr || interrupts_[i].function != function) interrupts_[kept++] = interrupts_[i];
+    numberInterrupts_ = kept;
+
+}
+
+
+void ScheduleSimulator::advanceTo(const uint64_t &time_ns, const bool &stopAtInterrupt) {
+
+    uint64_t target = time_ns;
+
+    while (true) {
+
+        //Earliest interrupt that fires before the target time.
+        Interrupt* next = nullptr;
+        for (uint32_t i = 0; i < numberInterrupts_; i++) {
+            if (!interrupts_[i].running && interrupts_[i].next_ns <= target && (next == nullptr || interrupts_[i].next_ns < next->next_ns)) next = &interrupts_[i];
+        }
+
+        if (next == nullptr) break;
+
+        if (next->next_ns > time_ns_) time_ns_ = next->next_ns;
+
+        next->nominal_ns += next->period_ns;
+        next->next_ns = next->nominal_ns;
+        if (next->jitter_ns > 0) next->next_ns += random()%(2*next->jitter_ns + 1) - next->jitter_ns;
+
+        if (next->task != nullptr) {
+            next->task->interrupt(time_ns_);
+        } else {
+            //The interrupted code continues after the function, so it ends later by the time the function took.
+            //Timers are not removed while they run, so the entry stays valid.
+            uint64_t start = time_ns_;
+            Interrupt* timer = next;
+            timer->running = true;
+            timer->function();
+            timer->running = false;
+            target += time_ns_ - start;
+            timerTime_ns_ += time_ns_ - start;
+        }
+
+        if (stopAtInterrupt) return;
+
+    }
+
+    if (target > time_ns_) time_ns_ = target;
+
+}
+
+
+void ScheduleSimulator::idle(uint32_t until_us) {
+
+    ScheduleSimulator& simulator = getGlobalSimulator();
+
+    uint64_t start = simulator.time_ns_;
+    uint64_t timerStart = simulator.timerTime_ns_;
+    int32_t wait_us = until_us - micros();
+    if (wait_us <= 0) return;
+
+    //Time of timer functions woken up for is not idle.
+    simulator.advanceTo((start/1000 + wait_us)*1000, true);
+    simulator.idleTime_ns_ += simulator.time_ns_ - start - (simulator.timerTime_ns_ - timerStart);
+
+}
+
+
+void ScheduleSimulator::frameTimer(uint32_t frameLength_us) {
+
+    ScheduleSimulator& simulator = getGlobalSimulator();
+
+    simulator.removeTimer(runFrame);
+    if (frameLength_us > 0) simulator.addTimer(runFrame, frameLength_us);
+
+}
+
+
+void ScheduleSimulator::run(const float &duration_s) {
+
+    Scheduler& scheduler = getGlobalScheduler();
+    scheduler.setIdleFunction(idle);
+    scheduler.setFrameTimerFunction(frameTimer);
+    scheduler.setIdleSleep(true);
+    scheduler.resetTaskStatistics();
+
+    for (uint32_t i = 0; i < numberTasks_; i++) tasks_[i]->resetMeasurements();
+
+    runStart_ns_ = time_ns_;
+    idleTime_ns_ = 0;
+    ticks_ = 0;
+
+    uint64_t end = time_ns_ + (uint64_t)(duration_s*1000000000.0);
+    while (time_ns_ < end) scheduler.tick();
+
+    runDuration_ns_ = time_ns_ - runStart_ns_;
+
+}
+
+
+void ScheduleSimulator::printReport(const char* title) {
+
+    if (runDuration_ns_ == 0) return;
+
+    printf("\n%s (%.2fs simulated, %u ticks, %.1f%% idle)\n", title, runDuration_ns_/1e9, ticks_, 100.0*idleTime_ns_/runDuration_ns_);
+    printf("%-16s %6s %4s %8s %6s %8s %8s %8s %8s %8s %7s %9s %9s\n", "Task", "Rate", "Prio", "Runs", "CPU%", "ExecAvg", "ExecMax", "JitAvg", "JitP99", "JitMax", "Missed", "LatAvg", "LatMax");
+
+    float totalLoad = 0;
+
+    for (uint32_t i = 0; i < numberTasks_; i++) {
+
+        SimulatedTask* task = tasks_[i];
+        TaskStatistics statistics;
+        if (!task->getTaskStatistics(&statistics)) continue;
+
+        float load = 100.0f*task->getBusyTime_ns()/runDuration_ns_;
+        totalLoad += load;
+
+        printf("%-16s %6u %4u %8u %6.2f %8u %8u %8u %8u %8u %7u %9.1f %9.1f\n", statistics.name, statistics.rate_Hz, statistics.priority, task->getRuns(), load,
+            statistics.executionTimeMean_us, statistics.executionTimeMax_us, statistics.startJitterMean_us, statistics.startJitterP99_us, statistics.startJitterMax_us,
+            statistics.deadlinesMissed, task->getLatencyMean_us(), task->getLatencyMax_us());
+
+    }
+
+    printf("Total task load %.2f%%. Times in us. Latency is from the source interrupt or run to the end of the run.\n", totalLoad);
+    printf("Scheduler overloaded %u times so far, %s at end of run.\n", getGlobalScheduler().getOverloadCount(), getGlobalScheduler().isOverloaded() ? "overloaded" : "not overloaded");
+
+    Scheduler& scheduler = getGlobalScheduler();
+    if (scheduler.getNumberFrames() > 0) {
+        printf("%u frames of %uus, fullest frame has %uus of budget, %u frame overruns so far.\n", scheduler.getNumberFrames(), scheduler.getFrameLength_us(),
+            scheduler.getFrameBudgetPeak_us(), scheduler.getFrameOverruns());
+    } else if (scheduler.getSchedulePolicy() == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) {
+        printf("No frames, the fullest would have %uus of budget. Tasks run by priority.\n", scheduler.getFrameBudgetPeak_us());
+    }
+
+}
+
+
+void ScheduleSimulator::addTask(SimulatedTask* task) {
+    if (numberTasks_ < SIMPLE_SCHEDULE_MAX_TASKS) tasks_[numberTasks_++] = task;
+}
+
+
+void ScheduleSimulator::removeTask(SimulatedTask* task) {
+
+    //Interrupts of a removed task must not fire anymore.
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < numberInterrupts_; i++) if (interrupts_[i].task != task) interrupts_[kept++] = interrupts_[i];
+    numberInterrupts_ = kept;
+
+    for (uint32_t i = 0; i < numberTasks_; i++) {
+        if (tasks_[i] != task) continue;
+        for (uint32_t j = i; j + 1 < numberTasks_; j++) tasks_[j] = tasks_[j + 1];
+        numberTasks_--;
+        return;
+    }
+
+}
@@ -0,0 +1,318 @@
+#ifndef SCHEDULE_SIMULATOR_H
+#define SCHEDULE_SIMULATOR_H
+
+
+/**
+ * Runs the real Scheduler and Task_Abstract code on the host with a virtual clock.
+ * Tasks are replaced by SimulatedTask instances that only advance the clock by a modelled
+ * execution time. Interrupts are simulated at fixed rates with jitter. Time jumps straight to
+ * the next deadline when the scheduler sleeps, so seconds of runtime are simulated in milliseconds.
+ * Everything is deterministic for a given seed.
+ *
+ * e.g:
+ * SimulatedTask imu("IMU", 0, eTaskPriority_Realtime, 15, 25);
+ * SimulatedTask nav("Nav", 8000, eTaskPriority_VeryHigh, 20, 40);
+ * nav.addInput(&imu);
+ * getGlobalSimulator().addInterrupt(&imu, 4000, 1);
+ * getGlobalSimulator().run(2);
+ * getGlobalSimulator().printReport();
+*/
+
+
+
+#include "Arduino.h"
+
+#include "../src/task_autorun_class.h"
+
+
+
+//Maximum number of simulated interrupt sources.
+#ifndef SCHEDULE_SIMULATOR_MAX_INTERRUPTS
+#define SCHEDULE_SIMULATOR_MAX_INTERRUPTS 8
+#endif
+
+//Maximum number of tasks a simulated task takes data from.
+#ifndef SIMULATED_TASK_MAX_INPUTS
+#define SIMULATED_TASK_MAX_INPUTS 4
+#endif
+
+
+
+/**
+ * Task that does nothing but take time. Execution time is uniformly distributed between a minimum and maximum.
+ * Tracks the age of the data it works on, so latency through chains of tasks can be measured.
+ */
+class SimulatedTask: public Task_Abstract {
+public:
+
+    /**
+     * @param name is the name used in the report. Not copied.
+     * @param rate_Hz is the rate to run at. 0 to only run on interrupts. See ScheduleSimulator::addInterrupt().
+     * @param priority is the priority of the task.
+     * @param costMin_us is the shortest execution time in microseconds.
+     * @param costMax_us is the longest execution time in microseconds.
+     */
+    SimulatedTask(const char* name, uint32_t rate_Hz, eTaskPriority_t priority, float costMin_us, float costMax_us);
+
+    ~SimulatedTask();
+
+    /**
+     * Makes this task use data from another task. Only used to measure latency, the
+     * scheduling is not changed. Use addTaskUpstream() to run them as a pipeline.
+     *
+     * @param input is the task producing the data.
+     * @returns false if too many inputs.
+     */
+    bool addInput(SimulatedTask* input);
+
+    /**
+     * Changes the execution time.
+     *
+     * @param costMin_us is the shortest execution time in microseconds.
+     * @param costMax_us is the longest execution time in microseconds.
+     */
+    void setCost(float costMin_us, float costMax_us) {costMin_ns_ = costMin_us*1000; costMax_ns_ = costMax_us*1000;}
+
+    /**
+     * Takes the modelled execution time.
+     */
+    void thread();
+
+    /**
+     * Called by the simulator when an interrupt of this task fires.
+     *
+     * @param time_ns is the time of the interrupt.
+     */
+    void interrupt(const uint64_t &time_ns);
+
+    /**
+     * Removes all measurements.
+     */
+    void resetMeasurements();
+
+    /**
+     * @returns number of runs since last reset.
+     */
+    uint32_t getRuns() {return runs_;}
+
+    /**
+     * @returns time spent running since last reset in nanoseconds.
+     */
+    uint64_t getBusyTime_ns() {return busyTime_ns_;}
+
+    /**
+     * Time from the interrupt or run that produced the oldest data to the end of a run of this task.
+     * Only measured for runs that got new data.
+     *
+     * @returns mean latency in microseconds.
+     */
+    float getLatencyMean_us() {return latencyCounter_ == 0 ? 0 : (float)latencySum_ns_/latencyCounter_/1000;}
+
+    /**
+     * @returns largest latency in microseconds.
+     */
+    float getLatencyMax_us() {return (float)latencyMax_ns_/1000;}
+
+    /**
+     * @returns time in nanoseconds of the source data of the last run.
+     */
+    uint64_t getDataTime_ns() {return dataTime_ns_;}
+
+
+private:
+
+    uint64_t costMin_ns_ = 0;
+    uint64_t costMax_ns_ = 0;
+
+    SimulatedTask* inputs_[SIMULATED_TASK_MAX_INPUTS];
+    uint8_t numberInputs_ = 0;
+
+    //Time of the last interrupt. 0 if none came since the last run.
+    uint64_t interruptTime_ns_ = 0;
+    //Source time of the data used in the last run.
+    uint64_t dataTime_ns_ = 0;
+
+    uint32_t runs_ = 0;
+    uint64_t busyTime_ns_ = 0;
+
+    uint64_t latencySum_ns_ = 0;
+    uint64_t latencyMax_ns_ = 0;
+    uint32_t latencyCounter_ = 0;
+
+};
+
+
+
+class ScheduleSimulator {
+public:
+
+    /**
+     * Sets the seed of the random numbers used for execution times and jitter.
+     */
+    void setSeed(const uint32_t &seed) {random_ = seed != 0 ? seed : 1;}
+
+    /**
+     * Sets how long a scheduler tick takes without running a task. Default is 0.2us.
+     *
+     * @param cost_us is the time in microseconds.
+     */
+    void setTickCost(const float &cost_us) {tickCost_ns_ = cost_us*1000;}
+
+    /**
+     * Sets the virtual time. Can be used to test timer overflows.
+     *
+     * @param time_ns is the new time in nanoseconds.
+     */
+    void setTime_ns(const uint64_t &time_ns) {time_ns_ = time_ns;}
+
+    /**
+     * @returns virtual time in nanoseconds.
+     */
+    uint64_t getTime_ns() {return time_ns_;}
+
+    /**
+     * Moves the virtual time forward. Interrupts that are due on the way are fired at their time.
+     *
+     * @param time_ns is the time to advance by in nanoseconds.
+     */
+    void advance(const uint64_t &time_ns) {advanceTo(time_ns_ + time_ns, false);}
+
+    /**
+     * Adds an interrupt that notifies a task at a fixed rate, e.g. a sensor data ready pin.
+     *
+     * @param task is the task to notify.
+     * @param rate_Hz is the rate of the interrupt.
+     * @param jitter_us is the largest random offset of every interrupt in microseconds.
+     * @returns false if too many interrupts.
+     */
+    bool addInterrupt(SimulatedTask* task, const float &rate_Hz, const float &jitter_us = 0);
+
+    /**
+     * Adds a timer interrupt that calls a function every period, e.g. to run the frames of the cyclic executive.
+     * Time the function takes is added to the code it interrupted. It does not interrupt itsself.
+     *
+     * @param function is called from the interrupt.
+     * @param period_us is the time between calls in microseconds.
+     * @returns false if too many interrupts.
+     */
+    bool addTimer(void (*function)(), const uint32_t &period_us);
+
+    /**
+     * Removes a timer added with addTimer().
+     *
+     * @param function is the function the timer calls.
+     */
+    void removeTimer(void (*function)());
+
+    /**
+     * Removes all interrupts.
+     */
+    void clearInterrupts() {numberInterrupts_ = 0;}
+
+    /**
+     * Runs the global scheduler for the given virtual time. Measurements are reset at the start.
+     *
+     * @param duration_s is the time to simulate in seconds.
+     */
+    void run(const float &duration_s);
+
+    /**
+     * Prints statistics of all simulated tasks of the last run.
+     *
+     * @param title is printed above the table.
+     */
+    void printReport(const char* title = "");
+
+    /**
+     * Used by the Arduino shim. Advances the time by the tick cost.
+     */
+    void tick() {ticks_++; advance(tickCost_ns_);}
+
+    /**
+     * Used by the scheduler to sleep until the given time or the next interrupt.
+     */
+    static void idle(uint32_t until_us);
+
+    /**
+     * Used by the scheduler to start and stop the timer running its frames.
+     */
+    static void frameTimer(uint32_t frameLength_us);
+
+    /**
+     * @returns random number. Same sequence for the same seed.
+     */
+    uint32_t random() {
+        //xorshift32
+        random_ ^= random_ << 13;
+        random_ ^= random_ >> 17;
+        random_ ^= random_ << 5;
+        return random_;
+    }
+
+    /**
+     * Used by SimulatedTask to be listed in the report.
+     */
+    void addTask(SimulatedTask* task);
+    void removeTask(SimulatedTask* task);
+
+
+private:
+
+    struct Interrupt {
+        //Task to notify or function to call if nullptr.
+        SimulatedTask* task;
+        void (*function)();
+        //Set while the function runs.
+        bool running;
+        uint64_t period_ns;
+        uint64_t jitter_ns;
+        //Time the interrupt would fire without jitter.
+        uint64_t nominal_ns;
+        //Time the interrupt fires.
+        uint64_t next_ns;
+    };
+
+    /**
+     * Moves time to the given timestamp and fires interrupts on the way.
+     *
+     * @param stopAtInterrupt if true then stops after the first interrupt, like WFI.
+     */
+    void advanceTo(const uint64_t &time_ns, const bool &stopAtInterrupt);
+
+    uint64_t time_ns_ = 0;
+    uint64_t tickCost_ns_ = 200;
+    //Time spent in timer functions.
+    uint64_t timerTime_ns_ = 0;
+
+    uint32_t random_ = 1;
+
+    Interrupt interrupts_[SCHEDULE_SIMULATOR_MAX_INTERRUPTS];
+    uint32_t numberInterrupts_ = 0;
+
+    SimulatedTask* tasks_[SIMPLE_SCHEDULE_MAX_TASKS];
+    uint32_t numberTasks_ = 0;
+
+    //Measurements of the last run.
+    uint64_t runStart_ns_ = 0;
+    uint64_t runDuration_ns_ = 0;
+    uint64_t idleTime_ns_ = 0;
+    uint32_t ticks_ = 0;
+
+};
+
+
+
+/**
+ * Returns the simulator that drives the virtual clock.
+ */
+inline ScheduleSimulator& getGlobalSimulator() {
+
+    static ScheduleSimulator simulator;
+
+    return simulator;
+
+}
+
+
+
+#endif
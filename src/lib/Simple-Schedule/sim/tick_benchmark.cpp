@@ -0,0 +1,135 @@
+#include "tick_benchmark.h"
+
+#include "schedule_simulator.h"
+
+#include "stdio.h"
+
+#include <chrono>
+
+
+
+//Largest number of tasks benchmarked.
+#define TICK_BENCHMARK_MAX_TASKS 200
+
+
+
+/**
+ * Task that does nothing, so only the scheduler is measured.
+ */
+class BenchmarkTask: public Task_Abstract {
+public:
+
+    BenchmarkTask() : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_Middle) {}
+
+    void thread() {runs_++;}
+
+    uint32_t getRuns() {return runs_;}
+
+private:
+
+    uint32_t runs_ = 0;
+
+};
+
+
+
+/**
+ * @returns host time since the first call in nanoseconds.
+ */
+static uint64_t hostTime_ns() {
+
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+}
+
+
+/**
+ * Measures the scheduler with the given number of tasks attached and prints one line.
+ *
+ * @param tasks to use. The first numberTasks are attached.
+ * @param numberTasks is the number of tasks to attach.
+ * @param clockCost_ns is the time per tick taken by the virtual clock, printed for comparison.
+ */
+static void benchmarkTasks(BenchmarkTask* tasks, const uint32_t &numberTasks, const float &clockCost_ns) {
+
+    Scheduler& scheduler = getGlobalScheduler();
+
+    for (uint32_t i = 0; i < numberTasks; i++) {
+        tasks[i].setTaskRate(500 + 1500*i/numberTasks);
+        tasks[i].setTaskPriority((eTaskPriority_t)(eTaskPriority_t::eTaskPriority_VeryLow + i%(eTaskPriority_t::eTaskPriority_NumPriorities - 1)));
+        tasks[i].startTaskThreading();
+    }
+
+    //Lets all tasks run once, so init() and the first placement are not measured.
+    for (uint32_t i = 0; i < 100000; i++) scheduler.tick();
+
+    uint32_t runsBefore = 0;
+    for (uint32_t i = 0; i < numberTasks; i++) runsBefore += tasks[i].getRuns();
+
+    uint64_t start = hostTime_ns();
+    for (uint32_t i = 0; i < TICK_BENCHMARK_TICKS; i++) scheduler.tick();
+    float tick_ns = (float)(hostTime_ns() - start)/TICK_BENCHMARK_TICKS;
+
+    uint32_t runs = 0;
+    for (uint32_t i = 0; i < numberTasks; i++) runs += tasks[i].getRuns();
+    runs -= runsBefore;
+
+    //Attaches and detaches a task into the filled table, like a timed job.
+    BenchmarkTask job;
+    start = hostTime_ns();
+    for (uint32_t i = 0; i < TICK_BENCHMARK_ATTACHES; i++) {
+        job.startTaskThreading();
+        job.stopTaskThreading();
+    }
+    float attach_ns = (float)(hostTime_ns() - start)/TICK_BENCHMARK_ATTACHES;
+
+    scheduler.setAutoPhase(true);
+    start = hostTime_ns();
+    for (uint32_t i = 0; i < TICK_BENCHMARK_ATTACHES; i++) {
+        job.startTaskThreading();
+        job.stopTaskThreading();
+    }
+    float attachPhase_ns = (float)(hostTime_ns() - start)/TICK_BENCHMARK_ATTACHES;
+    scheduler.setAutoPhase(false);
+
+    for (uint32_t i = 0; i < numberTasks; i++) tasks[i].stopTaskThreading();
+
+    printf("%6u %10.1f %10.1f %10u %12.1f %12.1f\n", numberTasks, tick_ns, tick_ns - clockCost_ns, runs, attach_ns, attachPhase_ns);
+
+}
+
+
+void benchmarkSchedulerTick() {
+
+    static_assert(TICK_BENCHMARK_MAX_TASKS < SIMPLE_SCHEDULE_MAX_TASKS, "Tick benchmark needs SIMPLE_SCHEDULE_MAX_TASKS above 200");
+
+    Scheduler& scheduler = getGlobalScheduler();
+    scheduler.setSchedulePolicy(eSchedulePolicy_t::eSchedulePolicy_Priority);
+    scheduler.setIdleSleep(false);
+    scheduler.setAutoPhase(false);
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    //Recording would be measured as well.
+    taskTrace.setEnabled(false);
+#endif
+
+    //Every tick advances the virtual clock through yield(). Its cost is measured without the scheduler.
+    uint64_t start = hostTime_ns();
+    for (uint32_t i = 0; i < TICK_BENCHMARK_TICKS; i++) yield();
+    float clockCost_ns = (float)(hostTime_ns() - start)/TICK_BENCHMARK_TICKS;
+
+    static BenchmarkTask tasks[TICK_BENCHMARK_MAX_TASKS];
+
+    printf("\nScheduler tick benchmark (%u ticks, virtual clock takes %.1fns per tick)\n", TICK_BENCHMARK_TICKS, clockCost_ns);
+    printf("%6s %10s %10s %10s %12s %12s\n", "Tasks", "ns/tick", "w/o clock", "Runs", "ns/attach", "with phase");
+
+    const uint32_t numbersTasks[] = {10, 50, TICK_BENCHMARK_MAX_TASKS};
+    for (uint32_t numberTasks : numbersTasks) benchmarkTasks(tasks, numberTasks, clockCost_ns);
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    taskTrace.setEnabled(true);
+#endif
+
+}
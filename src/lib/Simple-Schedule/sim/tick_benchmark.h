@@ -0,0 +1,41 @@
+#ifndef TICK_BENCHMARK_H
+#define TICK_BENCHMARK_H
+
+
+/**
+ * Measures the host time the scheduler needs per tick and to attach and detach a task,
+ * for 10, 50 and 200 attached tasks. Tasks have empty threads, rates from 500 to 2000Hz and
+ * are spread over all priorities. Attaching is measured without and with automatic phases.
+ * Time still comes from the virtual clock, so every tick also pays for advancing it.
+ * That part is measured on its own and printed as well.
+ *
+ * Run with: pio run -e native && .pio/build/native/program --benchmark
+*/
+
+
+
+#include "stdint.h"
+
+
+
+//Number of ticks measured per task count. Can be overridden with a build flag.
+#ifndef TICK_BENCHMARK_TICKS
+#define TICK_BENCHMARK_TICKS 20000000
+#endif
+
+//Number of attach and detach pairs measured per task count. Can be overridden with a build flag.
+#ifndef TICK_BENCHMARK_ATTACHES
+#define TICK_BENCHMARK_ATTACHES 10000
+#endif
+
+
+
+/**
+ * Runs the benchmark on the global scheduler and prints the results.
+ * Turns off idle sleep of the global scheduler, so it is run instead of the simulations.
+ */
+void benchmarkSchedulerTick();
+
+
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+
+/**
+ * Timing for things that should run at a fixed rate.
+ * Runs are placed on a grid of timestamps that is advanced by one interval every run. The interval
+ * is kept as an integer number of microseconds plus a fraction that is carried over, so rates that
+ * do not divide a second (e.g. 35kHz = 28.571us) are exact over time and do not drift.
+ * Divisions are only needed when the rate is set or when more than one interval was missed.
+ *
+ * e.g:
+ *
+ * RateControl rate(1000);
+ * if (rate.isTimeToRun()) {
+ *      Stuff to do periodically...
+ * }
+*/
+
+
+
+#include "Arduino.h"
+
+
+
+/**
+ * Decides what happens to runs that were missed because isTimeToRun() was called too late.
+ */
+enum eRateCatchUp_t {
+    //Missed runs are dropped. The next run is the next one on the grid.
+    eRateCatchUp_Skip,
+    //Missed runs are made up back to back, but at most burst limit of them. The rest is dropped.
+    eRateCatchUp_Burst,
+    //Every missed run is made up. Should only be used if the number of runs matters more than the time between them.
+    eRateCatchUp_Strict
+};
+
+
+
+class RateControl {
+public:
+
+    RateControl() {
+        nextRun_us_ = micros();
+        lastRun_us_ = nextRun_us_;
+    }
+
+    /**
+     * @param rate_Hz is the rate to run at. 0 leaves it unset.
+     */
+    RateControl(uint32_t rate_Hz) {
+        nextRun_us_ = micros();
+        lastRun_us_ = nextRun_us_;
+        if (rate_Hz != 0) setRate(rate_Hz);
+    }
+
+    /**
+     * Sets the rate. The next run stays where it is.
+     *
+     * @param rate_Hz is the rate in Hz. Must not be 0.
+     */
+    void setRate(uint32_t rate_Hz) {setInterval(1000000, rate_Hz);}
+
+    /**
+     * Sets the interval as a fraction of microseconds, e.g. setInterval(1000000, 3) for 3Hz.
+     *
+     * @param numerator_us is the numerator of the interval in microseconds.
+     * @param denominator is the denominator of the interval. Must not be 0.
+     */
+    void setInterval(uint32_t numerator_us, uint32_t denominator = 1) {
+        interval_us_ = numerator_us/denominator;
+        intervalRemainder_ = numerator_us%denominator;
+        intervalNumerator_ = numerator_us;
+        denominator_ = denominator;
+        remainder_ = 0;
+    }
+
+    /**
+     * @returns rate in Hz rounded down.
+     */
+    uint32_t getRate() {return intervalNumerator_ == 0 ? 0 : (uint64_t)1000000*denominator_/intervalNumerator_;}
+
+    /**
+     * @returns the interval in microseconds rounded down.
+     */
+    uint32_t getIntervalMicros() {return interval_us_;}
+
+    /**
+     * @returns true if the interval is a whole number of microseconds.
+     */
+    bool isIntervalWhole() {return intervalRemainder_ == 0;}
+
+    /**
+     * Sets the phase of the grid. Runs then happen when micros() % interval == phase_us.
+     * Moves the next run forwards onto the new grid. For intervals with a fraction the
+     * grid starts at the phase and the fraction is carried from there.
+     *
+     * @param phase_us is the phase in microseconds.
+     */
+    void setPhase(uint32_t phase_us) {
+        phase_us_ = phase_us;
+        if (interval_us_ == 0) return;
+        nextRun_us_ += (phase_us_%interval_us_ + interval_us_ - nextRun_us_%interval_us_)%interval_us_;
+        remainder_ = 0;
+    }
+
+    /**
+     * @returns the phase in microseconds.
+     */
+    uint32_t getPhase() {return phase_us_;}
+
+    /**
+     * Sets what happens to missed runs. Default is eRateCatchUp_Skip.
+     *
+     * @param catchUp is of type eRateCatchUp_t.
+     * @param burstLimit is the number of missed runs to make up with eRateCatchUp_Burst.
+     */
+    void setCatchUp(const eRateCatchUp_t &catchUp, uint32_t burstLimit = 4) {
+        catchUp_ = catchUp;
+        burstLimit_ = burstLimit;
+    }
+
+    /**
+     * @returns what happens to missed runs.
+     */
+    eRateCatchUp_t getCatchUp() {return catchUp_;}
+
+    /**
+     * Returns the timestamp in microseconds at which isTimeToRun() will return true.
+     * Used by the scheduler to sort tasks by their next run.
+     *
+     * @returns timestamp of next run.
+     */
+    uint32_t getNextRunMicros() {return nextRun_us_;}
+
+    /**
+     * Returns the amount of time till the next run.
+     * Negative number means how long ago it should have ran.
+     *
+     * @returns remaining time till next run.
+     */
+    int32_t getTimeRemainMicros() {return nextRun_us_ - micros();}
+
+    /**
+     * Starts the grid again from now. The next run is one interval later.
+     * Used if the runs were done by something else, e.g. a pipeline.
+     */
+    void sync() {
+        nextRun_us_ = micros();
+        remainder_ = 0;
+        missedRuns_ = 0;
+        advance();
+    }
+
+    /**
+     * Checks if it is time to run and moves the next run forward if it is.
+     *
+     * @returns true if it is time to run.
+     */
+    bool isTimeToRun() {
+
+        uint32_t now = micros();
+        if ((int32_t)(now - nextRun_us_) < 0) return false;
+
+        lastRun_us_ = now;
+        advance();
+        if ((int32_t)(now - nextRun_us_) >= 0) catchUp(now);
+        else missedRuns_ = 0;
+
+        return true;
+
+    }
+
+    /**
+     * Same as isTimeToRun() but also gives the time since the last time it returned true.
+     * Usefull for measuring rates.
+     *
+     * @param timeDelta is set to the time since the last run in microseconds.
+     * @returns true if it is time to run.
+     */
+    bool isTimeToRun(uint32_t &timeDelta) {
+
+        uint32_t lastRun = lastRun_us_;
+        if (!isTimeToRun()) return false;
+
+        timeDelta = lastRun_us_ - lastRun;
+
+        return true;
+
+    }
+
+
+private:
+
+    /**
+     * Moves the next run forward by one interval and carries the fraction.
+     */
+    void advance() {
+        nextRun_us_ += interval_us_;
+        remainder_ += intervalRemainder_;
+        if (remainder_ >= denominator_) {
+            remainder_ -= denominator_;
+            nextRun_us_++;
+        }
+    }
+
+    /**
+     * Called if the next run is still due after advancing, so at least one run was missed.
+     */
+    void catchUp(const uint32_t &now) {
+
+        if (catchUp_ == eRateCatchUp_t::eRateCatchUp_Strict) return;
+        if (catchUp_ == eRateCatchUp_t::eRateCatchUp_Burst && ++missedRuns_ <= burstLimit_) return;
+
+        missedRuns_ = 0;
+        if (intervalNumerator_ == 0) return;
+
+        //Jump over all missed runs at once, it could be many after a long stall.
+        uint64_t missed = (uint64_t)(now - nextRun_us_)*denominator_/intervalNumerator_;
+        uint64_t remainder = remainder_ + missed*intervalRemainder_;
+        nextRun_us_ += missed*interval_us_ + remainder/denominator_;
+        remainder_ = remainder%denominator_;
+
+        while ((int32_t)(now - nextRun_us_) >= 0) advance();
+
+    }
+
+
+    uint32_t nextRun_us_ = 0;
+    uint32_t lastRun_us_ = 0;
+
+    //Interval is interval_us_ + intervalRemainder_/denominator_ microseconds.
+    uint32_t interval_us_ = 0;
+    uint32_t intervalRemainder_ = 0;
+    uint32_t intervalNumerator_ = 0;
+    uint32_t denominator_ = 1;
+    //Fraction of a microsecond the exact next run is after nextRun_us_. In 1/denominator_.
+    uint32_t remainder_ = 0;
+
+    uint32_t phase_us_ = 0;
+
+    eRateCatchUp_t catchUp_ = eRateCatchUp_t::eRateCatchUp_Skip;
+    uint32_t burstLimit_ = 4;
+    uint32_t missedRuns_ = 0;
+
+};
+
+
+
+#endif
@@ -1,5 +1,30 @@
 #include "simple_scheduler.h"
 
+#include "string.h"
+
+#if defined(__IMXRT1062__)
+#include "IntervalTimer.h"
+#endif
+
+
+
+#if defined(__IMXRT1062__)
+//One shot timer that wakes the CPU from WFI at the next deadline. Shared by all schedulers as only one can sleep at a time.
+static IntervalTimer wakeupTimer;
+
+static void wakeupTimerInterrupt() {
+    wakeupTimer.end();
+}
+
+//Periodic timer that runs the frames of the cyclic executive. Only one scheduler can use it at a time.
+static IntervalTimer frameTimer;
+static Scheduler* frameTimerScheduler = nullptr;
+
+static void frameTimerInterrupt() {
+    if (frameTimerScheduler != nullptr) frameTimerScheduler->runNextFrame();
+}
+#endif
+
 
 
 /**
@@ -10,265 +35,926 @@ void Scheduler::tick() {
 
     yield();
 
-    //Measure and calculate tickrate
-    tickCounter_++;  
+    //Measure tickrate. Only the counter is done here, the rate is calculated once a deadline is reached.
+    tickCounter_++;
+
+    //Tasks were attached or removed, so the frames of the cyclic executive must be placed again.
+    if (framesChanged_) buildFrames();
+
+    //Nothing to do until the closest deadline is reached, unless an interrupt requested a check.
+    uint32_t now = micros();
+    if (wakeupPending_) {
+        wakeupPending_ = false;
+        handleEvents();
+    } else if ((int32_t)(now - nextDeadline_us_) < 0) {
+        if (idleSleep_) idleWait(nextDeadline_us_);
+        return;
+    }
+
+    //Frames run from an interrupt, so their time is collected here.
+    if (numberFrames_ > 0) {
+        for (uint8_t i = 0; i < eTaskPriority_t::eTaskPriority_NumPriorities; i++) {
+            uint32_t busyTime = __atomic_exchange_n(&frameBusyTime_us_[i], 0, __ATOMIC_RELAXED);
+            priorityBusyTime_us_[i] += busyTime;
+            windowBusyTime_us_ += busyTime;
+        }
+    }
+
     uint32_t dTime;
     if (tickCounterResetInterval_.isTimeToRun(dTime)) {
         tickRate_ = (double)tickCounter_/dTime*1000000.0;
         tickCounter_ = 0;
+
+        idleRatio_ = (float)idleTime_us_/dTime;
+        wakeupLatencyMean_us_ = wakeupLatencyCounter_ == 0 ? 0 : wakeupLatencySum_us_/wakeupLatencyCounter_;
+        wakeupLatencyMax_us_ = wakeupLatencyPeak_us_;
+        idleTime_us_ = 0;
+        wakeupLatencySum_us_ = 0;
+        wakeupLatencyCounter_ = 0;
+        wakeupLatencyPeak_us_ = 0;
+
+        //Calculate load from time used in the last second.
+        for (uint8_t i = 0; i < eTaskPriority_t::eTaskPriority_NumPriorities; i++) {
+            priorityLoad_[i] = (float)priorityBusyTime_us_[i]/dTime;
+            priorityBusyTime_us_[i] = 0;
+        }
+
+#ifdef SIMPLE_SCHEDULE_PROFILING
+        for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) if (tasks_.isUsed(i)) tasks_[i].profiler.updateCPUShare(dTime);
+#endif
+
     }
 
-    //Run all tasks with a priority. If none are found then go to next lower priority.
-    ChainObject<Task>* currentTask = tasks_[0].getChainStart();
-    bool taskRan = false; //Set to true if a task was run. Will only be checked if we switch to lower task.
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
-            }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            }
-        //}
-        currentTask = nextTask;
-
-    }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
-
-    if (taskRan) return; //Check if a task ran. If so then leave.
-    //Start with functions without parameters
-    currentTask = tasks_[1].getChainStart(); //Switch to next priority
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
-            }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            }
-        //}
-        currentTask = nextTask;
-
-    }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
-
-    if (taskRan) return; //Check if a task ran. If so then leave.
-    currentTask = tasks_[2].getChainStart(); //Switch to next priority
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
-            }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            }
-        //}
-        currentTask = nextTask;
-
-    }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
-
-    if (taskRan) return; //Check if a task ran. If so then leave.
-    currentTask = tasks_[3].getChainStart(); //Switch to next priority
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
-            }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            }
-        //}
-        currentTask = nextTask;
-
-    }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
-
-    if (taskRan) return; //Check if a task ran. If so then leave.
-    currentTask = tasks_[4].getChainStart(); //Switch to next priority
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
-            }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            }
-        //}
-        currentTask = nextTask;
-
-    }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
-
-    if (taskRan) return; //Check if a task ran. If so then leave.
-    currentTask = tasks_[5].getChainStart(); //Switch to next priority
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
+    if (now - overloadWindowStart_us_ >= overloadPolicy_.window_us) checkOverload(now);
+
+    //Without a timer the frames come before all other tasks. Frames that were missed completely are skipped, so the table stays aligned with time.
+    if (framesPolled_ && numberFrames_ > 0 && (int32_t)(now - nextFrame_us_) >= 0) {
+        uint32_t missedFrames = (now - nextFrame_us_)/frameLength_us_;
+        if (missedFrames > 0) {
+            frameOverruns_ += missedFrames;
+            frame_ = (frame_ + missedFrames)%numberFrames_;
+            nextFrame_us_ += missedFrames*frameLength_us_;
+        }
+        uint32_t frameStart = nextFrame_us_;
+        nextFrame_us_ += frameLength_us_;
+        runFrame(frameStart);
+    }
+
+    if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_EarliestDeadline) tickEarliestDeadline(now);
+    else tickPriority(now);
+
+    updateNextDeadline();
+
+}
+
+
+void Scheduler::tickPriority(const uint32_t &now) {
+
+    //Bitmap of all priorities that have a task due. Bit index is the eTaskPriority_t value.
+    uint32_t readyPriorities = 0;
+    for (uint8_t i = 0; i < eTaskPriority_t::eTaskPriority_NumPriorities; i++) {
+        if (!taskQueues_[i].isEmpty() && (int32_t)(now - taskQueues_[i].getNextDeadline()) >= 0) readyPriorities |= 1UL<<i;
+    }
+
+    //Only run the highest priority that has something to do. Lower priorities have to wait for the next tick.
+    if (readyPriorities != 0) {
+
+        uint8_t priority = 31 - __builtin_clz(readyPriorities);
+        TimerQueue<Task, SIMPLE_SCHEDULE_MAX_TASKS> &queue = taskQueues_[priority];
+
+        //Run all tasks of this priority that are due. Tasks are placed back into the queue with a deadline in the future.
+        while (!queue.isEmpty() && (int32_t)(now - queue.getNextDeadline()) >= 0) {
+            uint32_t deadline = queue.getNextDeadline();
+            runTask(queue.removeNextItem(), deadline);
+        }
+
+    }
+
+}
+
+
+void Scheduler::tickEarliestDeadline(const uint32_t &now) {
+
+    //Move all tasks that became due into the ready queue, which is sorted by deadline instead of release time.
+    for (uint8_t i = 0; i < eTaskPriority_t::eTaskPriority_NumPriorities; i++) {
+
+        TimerQueue<Task, SIMPLE_SCHEDULE_MAX_TASKS> &queue = taskQueues_[i];
+
+        while (!queue.isEmpty() && (int32_t)(now - queue.getNextDeadline()) >= 0) {
+            uint32_t release = queue.getNextDeadline();
+            Task* task = queue.removeNextItem();
+            task->release_us = release;
+            readyQueue_.addItem(task, getTaskEDFDeadline(task, release));
+        }
+
+    }
+
+    //Only a single task is run per tick. A task that becomes due meanwhile can then still be run before others with a later deadline.
+    if (!readyQueue_.isEmpty()) {
+        Task* task = readyQueue_.removeNextItem();
+        runTask(task, task->release_us);
+    }
+
+}
+
+
+uint32_t Scheduler::getTaskEDFDeadline(Task* task, const uint32_t &release) {
+
+    //Init and removal are only done once, so they are due immediately.
+    if (!task->initWasCalled || task->limited) return release;
+    return release + task->interval.getIntervalMicros();
+
+}
+
+
+void Scheduler::setSchedulePolicy(const eSchedulePolicy_t &policy) {
+
+    schedulePolicy_ = policy;
+
+    //Tasks that are waiting in the ready queue are placed back so the priority policy can see them.
+    if (policy != eSchedulePolicy_t::eSchedulePolicy_EarliestDeadline) {
+        while (!readyQueue_.isEmpty()) {
+            Task* task = readyQueue_.removeNextItem();
+            taskQueues_[task->priority].addItem(task, task->release_us);
+        }
+    }
+
+    //Frames are built by initializeTasks() or the next tick. Other policies get the tasks back into their queues at once.
+    if (policy == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) framesChanged_ = true;
+    else if (numberFrames_ > 0) buildFrames();
+
+    updateNextDeadline();
+
+}
+
+
+void Scheduler::runTask(Task* task, const uint32_t &deadline) {
+
+    currentRunningTask_ = task;
+    currentTaskDetached_ = false;
+
+    //Cleared so the task can set it again while running.
+    bool nextRunDue = task->nextRunSet;
+    task->nextRunSet = false;
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    uint32_t slot = tasks_.getIndex(task);
+#endif
+
+    bool initRan = false;
+
+    if (!task->initWasCalled) {
+#ifdef SIMPLE_SCHEDULE_TRACE
+        taskTrace.record(eTraceEvent_t::eTraceEvent_TaskBegin, slot);
+#endif
+        task->thread->init();
+#ifdef SIMPLE_SCHEDULE_TRACE
+        taskTrace.record(eTraceEvent_t::eTraceEvent_TaskEnd, slot);
+#endif
+        task->initWasCalled = true;
+        initRan = true;
+        if (currentTaskDetached_) { //Task was removed during init.
+            currentRunningTask_ = nullptr;
+            return;
+        }
+    }
+
+    if (task->limited) {
+        if (micros() - task->creationTimestamp_us >= task->removeThreshold_us) {
+            task->thread->removal(); //Run removal function before removing.
+            if (!currentTaskDetached_) detachTask(task->thread);
+            currentRunningTask_ = nullptr;
+            return;
+        }
+    } else if (task->nextRunSet) {
+        //Init wants to continue later, thread is not run until then.
+    } else if (overloaded_ && task->shedding == eTaskShedding_t::eTaskShedding_Skip && !task->eventDriven) {
+        //Not run until the overload is over.
+    } else if (nextRunDue || (task->eventDriven ? isEventDue(task, initRan) : task->interval.isTimeToRun())) {
+        uint8_t priority = task->priority; //Task could be removed while running.
+        task->eventPending = false;
+        uint32_t startTime = micros();
+#ifdef SIMPLE_SCHEDULE_TRACE
+        taskTrace.record(eTraceEvent_t::eTraceEvent_TaskBegin, slot);
+#endif
+        task->thread->thread();
+#ifdef SIMPLE_SCHEDULE_TRACE
+        taskTrace.record(eTraceEvent_t::eTraceEvent_TaskEnd, slot);
+#endif
+        uint32_t executionTime = micros() - startTime;
+        priorityBusyTime_us_[priority] += executionTime;
+        windowBusyTime_us_ += executionTime;
+        if (!currentTaskDetached_) {
+            int32_t startJitter = startTime - deadline;
+            //Only tasks that keep their rate show if the scheduler cannot keep up.
+            if (task->shedding == eTaskShedding_t::eTaskShedding_Never && !task->eventDriven) {
+                windowRuns_++;
+                if (startJitter > (int32_t)task->interval.getIntervalMicros()) windowLateRuns_++;
             }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
+#ifdef SIMPLE_SCHEDULE_PROFILING
+            task->profiler.addRun(startJitter > 0 ? startJitter : 0, executionTime, task->interval.getIntervalMicros());
+#endif
+        }
+        if (currentTaskDetached_) { //Task removed itsself.
+            currentRunningTask_ = nullptr;
+            return;
+        }
+        if (task->numberRunsLeft > 0) task->numberRunsLeft--;
+        if (task->numberRunsLeft == 0) {
+            task->thread->removal(); //Run removal function before removing.
+            if (!currentTaskDetached_) detachTask(task->thread);
+            currentRunningTask_ = nullptr;
+            return;
+        }
+    }
+
+    currentRunningTask_ = nullptr;
+
+    //Event tasks without timeout wait outside of the queues until notified.
+    if (!task->eventDriven || task->eventTimeout_us != 0 || task->nextRunSet) {
+        //Back into queue to wait for next run.
+        taskQueues_[task->priority].addItem(task, task->nextRunSet ? task->nextRun_us : getTaskDeadline(task));
+    }
+
+    //Tasks depending on this one run right after it. Within a pipeline the stages are handled by runPipeline().
+    //The cyclic executive runs stages in order within a frame instead, so other tasks run at their own rate.
+    if (task->dependentsReleased && !pipelineRunning_) {
+        if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) task->dependentsReleased = false;
+        else runPipeline(task, deadline);
+    }
+
+}
+
+
+void Scheduler::runPipeline(Task* source, const uint32_t &release) {
+
+    //Bit per table slot of tasks that were released by a task run before them.
+    uint32_t reached[(SIMPLE_SCHEDULE_MAX_TASKS + 31)/32] = {0};
+
+    for (uint8_t i = 0; i < source->numberDependents; i++) reached[source->dependents[i]/32] |= 1UL << (source->dependents[i]%32);
+    source->dependentsReleased = false;
+
+    pipelineRunning_ = true;
+    pipelineChanged_ = false;
+
+    //Order places every task after the tasks it depends on, so a single pass is enough.
+    for (uint32_t i = 0; i < pipelineLength_ && !pipelineChanged_; i++) {
+
+        uint32_t index = pipelineOrder_[i];
+        if ((reached[index/32] & (1UL << (index%32))) == 0) continue;
+
+        Task* task = &tasks_[index];
+
+        //Init and removal are left to the normal deadlines.
+        if (!task->initWasCalled || task->limited) continue;
+
+        //A stage with a lower rate than its upstream task skips releases. A quarter interval early is allowed, so jitter of the upstream task does not make it skip one too many.
+        uint32_t now = micros();
+        uint32_t interval = task->interval.getIntervalMicros();
+        if ((int32_t)(now + interval/4 - task->pipelineDue_us) < 0) continue;
+        task->pipelineDue_us += interval;
+        if ((int32_t)(now - task->pipelineDue_us) >= 0) task->pipelineDue_us = now + interval; //Fell behind by a whole interval.
+
+        //Run now and then wait in its queue for the next release or the fallback deadline.
+        if (!taskQueues_[task->priority].removeItem(task)) readyQueue_.removeItem(task);
+        task->interval.sync();
+        task->nextRunSet = true;
+        task->nextRun_us = now;
+        task->dependentsReleased = false;
+
+        runTask(task, release);
+
+        if (pipelineChanged_ || !tasks_.isUsed(index) || !task->dependentsReleased) continue;
+
+        for (uint8_t j = 0; j < task->numberDependents; j++) reached[task->dependents[j]/32] |= 1UL << (task->dependents[j]%32);
+        task->dependentsReleased = false;
+
+    }
+
+    pipelineRunning_ = false;
+
+}
+
+
+bool Scheduler::updatePipelineOrder() {
+
+    pipelineChanged_ = true;
+
+    //Kahn's algorithm. Tasks are added once all their upstream tasks were added.
+    uint8_t upstreamsLeft[SIMPLE_SCHEDULE_MAX_TASKS];
+    uint32_t numberStages = 0;
+    pipelineLength_ = 0;
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
+        if (!tasks_.isUsed(i) || (tasks_[i].numberDependents == 0 && tasks_[i].numberUpstreams == 0)) continue;
+        numberStages++;
+        upstreamsLeft[i] = tasks_[i].numberUpstreams;
+        if (upstreamsLeft[i] == 0) pipelineOrder_[pipelineLength_++] = i;
+    }
+
+    for (uint32_t i = 0; i < pipelineLength_; i++) {
+        Task* task = &tasks_[pipelineOrder_[i]];
+        for (uint8_t j = 0; j < task->numberDependents; j++) {
+            uint16_t dependent = task->dependents[j];
+            if (--upstreamsLeft[dependent] == 0) pipelineOrder_[pipelineLength_++] = dependent;
+        }
+    }
+
+    //Tasks in a cycle never reach 0 upstream tasks left.
+    return pipelineLength_ == numberStages;
+
+}
+
+
+void Scheduler::removeTaskDependencies(const uint32_t &index) {
+
+    Task* task = &tasks_[index];
+    if (task->numberDependents == 0 && task->numberUpstreams == 0) return;
+
+    for (uint8_t i = 0; i < task->numberDependents; i++) tasks_[task->dependents[i]].numberUpstreams--;
+    task->numberDependents = 0;
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex() && task->numberUpstreams > 0; i++) {
+        if (!tasks_.isUsed(i)) continue;
+        Task* upstream = &tasks_[i];
+        for (uint8_t j = 0; j < upstream->numberDependents; j++) {
+            if (upstream->dependents[j] != index) continue;
+            upstream->dependents[j] = upstream->dependents[--upstream->numberDependents];
+            task->numberUpstreams--;
+            break;
+        }
+    }
+
+    updatePipelineOrder();
+
+}
+
+
+uint32_t Scheduler::getTaskDeadline(Task* task) {
+
+    if (!task->initWasCalled) return micros(); //Init is to be run on the next tick.
+    if (task->limited) return task->creationTimestamp_us + task->removeThreshold_us;
+    if (task->eventDriven) return micros() + task->eventTimeout_us;
+    //Skipped tasks are checked again once the overload could be over.
+    if (overloaded_ && task->shedding == eTaskShedding_t::eTaskShedding_Skip) return micros() + overloadPolicy_.window_us;
+
+    uint32_t deadline = task->interval.getNextRunMicros();
+    //Pipeline stages are normally run by their upstream task. Running on their own is only a fallback once a whole interval was missed.
+    if (task->numberUpstreams > 0 && schedulePolicy_ != eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) deadline += task->interval.getIntervalMicros();
+    if (overloaded_ && task->shedding == eTaskShedding_t::eTaskShedding_ReduceRate) deadline += (overloadPolicy_.rateDivider - 1)*task->interval.getIntervalMicros();
+
+    return deadline;
+
+}
+
+
+void Scheduler::handleEvents() {
+
+    for (uint32_t i = 0; i < sizeof(pendingEvents_)/sizeof(pendingEvents_[0]); i++) {
+
+        //Taken atomically so notifications in between are not lost.
+        uint32_t events = __atomic_exchange_n(&pendingEvents_[i], 0, __ATOMIC_ACQUIRE);
+
+        while (events != 0) {
+
+            uint32_t index = i*32 + __builtin_ctz(events);
+            events &= events - 1;
+
+            if (!tasks_.isUsed(index) || !tasks_[index].eventDriven) continue;
+
+            Task* task = &tasks_[index];
+            task->eventPending = true;
+
+            //Task could be waiting for its timeout. Is placed back as due now.
+            if (!taskQueues_[task->priority].removeItem(task)) readyQueue_.removeItem(task);
+            uint32_t release = eventTimestamps_us_[index];
+            taskQueues_[task->priority].addItem(task, release);
+
+        }
+
+    }
+
+}
+
+
+bool Scheduler::isEventDue(Task* task, const bool &initRan) {
+
+    return task->eventPending || (task->eventTimeout_us != 0 && !initRan);
+
+}
+
+
+bool Scheduler::isFrameTask(Task* task) {
+
+    //Only tasks with a budget. Others could block or lock the bus, which would stall the frame interrupt.
+    return task->budget_us > 0 && task->periodic && !task->limited && task->numberRunsLeft < 0 && task->priority >= cyclicPriority_ && task->interval.getIntervalMicros() > 0 && task->interval.isIntervalWhole();
+
+}
+
+
+bool Scheduler::buildFrames() {
+
+    framesChanged_ = false;
+
+    //Stopped first, so the frame timer does not use the table while it is changed.
+    setFrameTimer(0);
+    numberFrames_ = 0;
+    frameBudgetPeak_us_ = 0;
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
+        if (!tasks_.isUsed(i) || !tasks_[i].framed) continue;
+        Task* task = &tasks_[i];
+        task->framed = false;
+        task->interval.sync();
+        taskQueues_[task->priority].addItem(task, getTaskDeadline(task));
+    }
+
+    if (schedulePolicy_ != eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) {
+        updateNextDeadline();
+        return false;
+    }
+
+    //Frames start right away, so tasks placed into them must be initialised before.
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
+        if (!tasks_.isUsed(i) || tasks_[i].initWasCalled || !isFrameTask(&tasks_[i])) continue;
+        tasks_[i].thread->init();
+        tasks_[i].initWasCalled = true;
+    }
+
+    //Tasks to place sorted by interval. Minor frame is the gcd and major frame the lcm of all intervals.
+    uint16_t order[SIMPLE_SCHEDULE_MAX_TASKS];
+    uint32_t numberTasks = 0;
+    bool isFramed[SIMPLE_SCHEDULE_MAX_TASKS] = {false};
+    uint32_t frameLength = 0;
+    uint64_t majorFrame = 1;
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
+
+        if (!tasks_.isUsed(i) || !isFrameTask(&tasks_[i])) continue;
+
+        uint32_t interval = tasks_[i].interval.getIntervalMicros();
+
+        uint32_t a = frameLength, b = interval;
+        while (b != 0) {uint32_t t = a%b; a = b; b = t;}
+        frameLength = a;
+        a = majorFrame%interval; b = interval;
+        while (a != 0) {uint32_t t = b%a; b = a; a = t;}
+        majorFrame = majorFrame/b*interval;
+
+        //Rates that do not fit together give too many frames.
+        if (majorFrame/frameLength > SIMPLE_SCHEDULE_MAX_FRAMES) {
+            updateNextDeadline();
+            return false;
+        }
+
+        uint32_t j = numberTasks++;
+        for (; j > 0 && tasks_[order[j - 1]].interval.getIntervalMicros() > interval; j--) order[j] = order[j - 1];
+        order[j] = i;
+        isFramed[i] = true;
+
+    }
+
+    if (numberTasks == 0) {
+        updateNextDeadline();
+        return false;
+    }
+
+    //A task longer than a frame would make every frame it is in overrun.
+    for (uint32_t i = 0; i < numberTasks; i++) {
+        if (tasks_[order[i]].budget_us > frameLength) {
+            frameBudgetPeak_us_ = tasks_[order[i]].budget_us;
+            updateNextDeadline();
+            return false;
+        }
+    }
+
+    uint32_t numberFrames = majorFrame/frameLength;
+    uint32_t numberEntries = 0;
+    for (uint32_t i = 0; i < numberTasks; i++) numberEntries += numberFrames/(tasks_[order[i]].interval.getIntervalMicros()/frameLength);
+    if (numberEntries > SIMPLE_SCHEDULE_MAX_FRAME_ENTRIES) {
+        updateNextDeadline();
+        return false;
+    }
+
+    //Stages of a pipeline must come after their upstream tasks. Of the tasks that can come next, the fastest is taken.
+    uint8_t upstreamsLeft[SIMPLE_SCHEDULE_MAX_TASKS] = {0};
+    for (uint32_t i = 0; i < numberTasks; i++) {
+        Task* task = &tasks_[order[i]];
+        for (uint8_t j = 0; j < task->numberDependents; j++) if (isFramed[task->dependents[j]]) upstreamsLeft[task->dependents[j]]++;
+    }
+
+    uint16_t sorted[SIMPLE_SCHEDULE_MAX_TASKS];
+    for (uint32_t i = 0; i < numberTasks; i++) {
+        uint32_t j = 0;
+        while (order[j] == UINT16_MAX || upstreamsLeft[order[j]] > 0) j++; //Dependencies cannot form cycles, so one is always found.
+        sorted[i] = order[j];
+        order[j] = UINT16_MAX;
+        Task* task = &tasks_[sorted[i]];
+        for (uint8_t k = 0; k < task->numberDependents; k++) if (isFramed[task->dependents[k]]) upstreamsLeft[task->dependents[k]]--;
+    }
+
+    //Every task goes to the offset within its period that keeps the fullest frame smallest.
+    uint32_t frameLoad[SIMPLE_SCHEDULE_MAX_FRAMES];
+    for (uint32_t i = 0; i < numberFrames; i++) frameLoad[i] = 0;
+    uint32_t periods[SIMPLE_SCHEDULE_MAX_TASKS];
+    uint32_t offsets[SIMPLE_SCHEDULE_MAX_TASKS];
+
+    for (uint32_t i = 0; i < numberTasks; i++) {
+
+        Task* task = &tasks_[sorted[i]];
+        uint32_t period = task->interval.getIntervalMicros()/frameLength;
+        uint32_t budget = task->budget_us;
+
+        uint32_t bestOffset = 0;
+        bool bestWithUpstreams = false;
+        uint32_t bestPeak = UINT32_MAX;
+        uint32_t bestSum = UINT32_MAX;
+
+        for (uint32_t offset = 0; offset < period; offset++) {
+
+            //Stages run in a frame of their upstream tasks, so they get new data without waiting a frame.
+            bool withUpstreams = true;
+            for (uint32_t j = 0; j < i && withUpstreams; j++) {
+                Task* upstream = &tasks_[sorted[j]];
+                for (uint8_t k = 0; k < upstream->numberDependents; k++) {
+                    if (upstream->dependents[k] == sorted[i] && (offset + periods[j] - offsets[j])%periods[j] != 0) withUpstreams = false;
                 }
             }
-        //}
-        currentTask = nextTask;
-
-    }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
-
-    if (taskRan) return; //Check if a task ran. If so then leave.
-    currentTask = tasks_[6].getChainStart(); //Switch to next priority
-    while(currentTask != nullptr) {
-        ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
-        //currentRunningTask_ = &(currentTask->item);
-        //if (!currentTask->item.isSuspended) {
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-                taskRan = true;
+
+            uint32_t peak = 0;
+            uint32_t sum = 0;
+            for (uint32_t frame = offset; frame < numberFrames; frame += period) {
+                if (frameLoad[frame] > peak) peak = frameLoad[frame];
+                sum += frameLoad[frame];
             }
-            if (currentTask->item.limited) {
-                if (micros() - currentTask->item.creationTimestamp_us >= currentTask->item.removeThreshold_us) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
-            } else if (currentTask->item.interval.isTimeToRun()) {
-                currentTask->item.thread->thread();
-                taskRan = true;
-                if (currentTask->item.numberRunsLeft > 0) currentTask->item.numberRunsLeft--;
-                if (currentTask->item.numberRunsLeft == 0) {
-                    currentTask->item.thread->removal(); //Run removal function before removing.
-                    detachTask(currentTask->item.thread);
-                }
+
+            if ((withUpstreams && !bestWithUpstreams) || (withUpstreams == bestWithUpstreams && (peak < bestPeak || (peak == bestPeak && sum < bestSum)))) {
+                bestOffset = offset;
+                bestWithUpstreams = withUpstreams;
+                bestPeak = peak;
+                bestSum = sum;
             }
-        //}
-        currentTask = nextTask;
 
+        }
+
+        periods[i] = period;
+        offsets[i] = bestOffset;
+        for (uint32_t frame = bestOffset; frame < numberFrames; frame += period) {
+            frameLoad[frame] += budget;
+            if (frameLoad[frame] > frameBudgetPeak_us_) frameBudgetPeak_us_ = frameLoad[frame];
+        }
+
+    }
+
+    //Frames run in an interrupt, so if they do not fit they would block everything else.
+    if (frameBudgetPeak_us_ > frameLength) {
+        updateNextDeadline();
+        return false;
     }
-    //currentRunningTask_ = nullptr; //Set to nullpointer when leaving as nothing is running
+
+    //Table with the tasks of every frame in the sorted order.
+    numberEntries = 0;
+    for (uint32_t frame = 0; frame < numberFrames; frame++) {
+        frameStarts_[frame] = numberEntries;
+        for (uint32_t i = 0; i < numberTasks; i++) if (frame%periods[i] == offsets[i]) frameEntries_[numberEntries++] = sorted[i];
+    }
+    frameStarts_[numberFrames] = numberEntries;
+
+    //Tasks in frames are not run from their queues anymore.
+    for (uint32_t i = 0; i < numberTasks; i++) {
+        Task* task = &tasks_[sorted[i]];
+        if (!taskQueues_[task->priority].removeItem(task)) readyQueue_.removeItem(task);
+        task->framed = true;
+    }
+
+#if defined(__IMXRT1062__)
+    framesPolled_ = false;
+#else
+    framesPolled_ = frameTimerFunction_ == nullptr;
+#endif
+
+    frameLength_us_ = frameLength;
+    frame_ = 0;
+    nextFrame_us_ = micros() + frameLength;
+    numberFrames_ = numberFrames;
+
+    setFrameTimer(frameLength);
+    updateNextDeadline();
+
+    return true;
 
 }
 
-void Scheduler::initializeTasks() {
 
-    for (uint8_t i = 0; i < 7; i++) {
+void Scheduler::runFrame(const uint32_t &frameStart) {
 
-        ChainObject<Task>* currentTask = tasks_[i].getChainStart(); //Switch to next priority
+    uint32_t frame = frame_;
 
-        while(currentTask != nullptr) {
-            ChainObject<Task>* nextTask = currentTask->nextObject; // Must be selected before it is removed
+    for (uint32_t i = frameStarts_[frame]; i < frameStarts_[frame + 1]; i++) {
 
-            if (!currentTask->item.initWasCalled) {
-                currentTask->item.thread->init();
-                currentTask->item.initWasCalled = true;
-            }
-            
-            currentTask = nextTask;
+        uint16_t index = frameEntries_[i];
+        if (index == UINT16_MAX) continue; //Task was detached.
+
+        Task* task = &tasks_[index];
+        uint8_t priority = task->priority;
+        uint32_t startTime = micros();
+#ifdef SIMPLE_SCHEDULE_TRACE
+        taskTrace.record(eTraceEvent_t::eTraceEvent_TaskBegin, index);
+#endif
+        task->thread->thread();
+#ifdef SIMPLE_SCHEDULE_TRACE
+        taskTrace.record(eTraceEvent_t::eTraceEvent_TaskEnd, index);
+#endif
+        uint32_t executionTime = micros() - startTime;
+        frameBusyTime_us_[priority] += executionTime;
+
+        if (frameEntries_[i] != index) continue; //Task removed itsself.
+
+        //Stages after this task are already in the right order in the frames.
+        task->dependentsReleased = false;
+
+#ifdef SIMPLE_SCHEDULE_PROFILING
+        task->profiler.addRun(startTime - frameStart, executionTime, task->interval.getIntervalMicros());
+#endif
+
+    }
+
+    if (micros() - frameStart > frameLength_us_) frameOverruns_++;
+
+    frame_ = frame + 1 < numberFrames_ ? frame + 1 : 0;
+
+}
+
+
+void Scheduler::setFrameTimer(const uint32_t &frameLength_us) {
 
+    if (frameTimerFunction_ != nullptr) {
+        frameTimerFunction_(frameLength_us);
+        return;
+    }
+
+#if defined(__IMXRT1062__)
+    frameTimer.end();
+    if (frameLength_us == 0) return;
+    frameTimerScheduler = this;
+    frameTimer.priority(SIMPLE_SCHEDULE_FRAME_PRIORITY);
+    frameTimer.begin(frameTimerInterrupt, frameLength_us);
+#endif
+
+}
+
+
+void Scheduler::checkOverload(const uint32_t &now) {
+
+    uint32_t window = now - overloadWindowStart_us_;
+    overloadWindowStart_us_ = now;
+
+    windowLoad_ = (float)windowBusyTime_us_/window;
+
+    //A task that has been due for longer than a window is starved by higher priorities.
+    bool starving = !readyQueue_.isEmpty() && now - readyQueue_.getNextItem()->release_us > overloadPolicy_.window_us;
+    for (uint8_t i = 0; i < eTaskPriority_t::eTaskPriority_NumPriorities; i++) {
+        if (!taskQueues_[i].isEmpty() && (int32_t)(now - taskQueues_[i].getNextDeadline()) > (int32_t)overloadPolicy_.window_us) starving = true;
+    }
+
+    float lateRuns = windowRuns_ > 0 ? (float)windowLateRuns_/windowRuns_ : 0;
+
+    bool overloaded = windowLoad_ > overloadPolicy_.overloadLoad || lateRuns > overloadPolicy_.overloadLateRuns || starving;
+    bool recovering = windowLoad_ < overloadPolicy_.recoverLoad && lateRuns < overloadPolicy_.recoverLateRuns && !starving;
+
+    windowBusyTime_us_ = 0;
+    windowLateRuns_ = 0;
+    windowRuns_ = 0;
+
+    //Different limits for starting and stopping, so shedding does not switch on and off every window.
+    if (!overloaded_) {
+        if (windowsSinceRecovery_ < UINT8_MAX) windowsSinceRecovery_++;
+        overloadedWindows_ = overloaded ? overloadedWindows_ + 1 : 0;
+        if (overloadedWindows_ >= overloadPolicy_.overloadWindows) {
+            overloaded_ = true;
+            overloadCount_++;
+            recoveredWindows_ = 0;
+            //Overloaded again right after recovering means the shed tasks still do not fit. Waits longer before trying again.
+            if (windowsSinceRecovery_ > recoverWindows_) recoverWindows_ = overloadPolicy_.recoverWindows;
+            else if (2*recoverWindows_ < overloadPolicy_.maxRecoverWindows) recoverWindows_ = 2*recoverWindows_;
+            else recoverWindows_ = overloadPolicy_.maxRecoverWindows;
         }
+    } else {
+        recoveredWindows_ = recovering ? recoveredWindows_ + 1 : 0;
+        if (recoveredWindows_ >= recoverWindows_) {
+            overloaded_ = false;
+            overloadedWindows_ = 0;
+            windowsSinceRecovery_ = 0;
+        }
+    }
+
+}
+
+
+void Scheduler::updateNextDeadline() {
+
+    //Tasks in the ready queue are already due.
+    if (!readyQueue_.isEmpty()) {
+        nextDeadline_us_ = readyQueue_.getNextItem()->release_us;
+        return;
+    }
+
+    //The tickrate calculation and overload check must also be done, even if no task is attached.
+    uint32_t deadline = tickCounterResetInterval_.getNextRunMicros();
+    uint32_t windowEnd = overloadWindowStart_us_ + overloadPolicy_.window_us;
+    if ((int32_t)(windowEnd - deadline) < 0) deadline = windowEnd;
+
+    for (uint8_t i = 0; i < eTaskPriority_t::eTaskPriority_NumPriorities; i++) {
+        if (!taskQueues_[i].isEmpty() && (int32_t)(taskQueues_[i].getNextDeadline() - deadline) < 0) deadline = taskQueues_[i].getNextDeadline();
+    }
+
+    if (framesPolled_ && numberFrames_ > 0 && (int32_t)(nextFrame_us_ - deadline) < 0) deadline = nextFrame_us_;
+
+    nextDeadline_us_ = deadline;
+
+}
+
+
+void Scheduler::idleWait(const uint32_t &until_us) {
+
+    uint32_t start = micros();
+    int32_t waitTime = until_us - start;
+    if (waitTime < SIMPLE_SCHEDULE_MIN_IDLE_US) return;
+
+#if !defined(__IMXRT1062__)
+    if (idleFunction_ == nullptr) return; //No way to sleep, tick() will be called again immediately.
+#endif
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    taskTrace.record(eTraceEvent_t::eTraceEvent_IdleBegin, 0);
+#endif
+
+    if (idleFunction_ != nullptr) idleFunction_(until_us);
+#if defined(__IMXRT1062__)
+    else {
+        wakeupTimer.begin(wakeupTimerInterrupt, waitTime);
+        //Interrupts are disabled so an interrupt between the check and WFI cannot be missed. WFI still wakes up on a pending interrupt.
+        __disable_irq();
+        if (!wakeupPending_) asm volatile("wfi");
+        __enable_irq();
+        wakeupTimer.end();
+    }
+#endif
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    taskTrace.record(eTraceEvent_t::eTraceEvent_IdleEnd, 0);
+#endif
+
+    uint32_t end = micros();
+    idleTime_us_ += end - start;
+
+    //Woken by deadline and not by another interrupt.
+    int32_t latency = end - until_us;
+    if (latency >= 0) {
+        wakeupLatencySum_us_ += latency;
+        wakeupLatencyCounter_++;
+        if ((uint32_t)latency > wakeupLatencyPeak_us_) wakeupLatencyPeak_us_ = latency;
+    }
+
+}
+
+
+void Scheduler::initializeTasks() {
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
+
+        if (!tasks_.isUsed(i) || tasks_[i].initWasCalled) continue;
+
+        tasks_[i].thread->init();
+        tasks_[i].initWasCalled = true;
 
     }
 
+    if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) buildFrames();
+
+}
+
+
+Scheduler::Task* Scheduler::findTask(Thread_Interface* function) {
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
+        if (tasks_.isUsed(i) && tasks_[i].thread == function) return &tasks_[i];
+    }
+
+    return nullptr;
+
+}
+
+
+void Scheduler::fillTaskStatistics(Task* task, TaskStatistics* statistics) {
+
+    *statistics = TaskStatistics();
+
+    const char* name = task->thread->getThreadName();
+    if (name == nullptr) name = "";
+    strncpy(statistics->name, name, sizeof(statistics->name) - 1);
+    statistics->name[sizeof(statistics->name) - 1] = '\0';
+
+    statistics->priority = task->priority;
+    statistics->rate_Hz = task->rate_Hz;
+
+#ifdef SIMPLE_SCHEDULE_PROFILING
+    task->profiler.getStatistics(statistics);
+#endif
+
+}
+
+
+uint32_t Scheduler::getNumberTasks() {
+
+    return tasks_.length();
+
+}
+
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+void Scheduler::updateTraceNames() {
+
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) if (tasks_.isUsed(i)) taskTrace.setTaskName(i, tasks_[i].thread->getThreadName());
+
+}
+#endif
+
+
+bool Scheduler::getTaskStatistics(Thread_Interface* function, TaskStatistics* statistics) {
+
+    Task* task = findTask(function);
+    if (task == nullptr) return false;
+
+    fillTaskStatistics(task, statistics);
+
+    return true;
+
+}
+
+
+bool Scheduler::getTaskStatistics(const uint32_t &index, TaskStatistics* statistics) {
+
+    uint32_t counter = 0;
+
+    //Highest priority first.
+    for (int8_t i = eTaskPriority_t::eTaskPriority_NumPriorities - 1; i >= 0; i--) {
+        for (uint32_t j = 0; j < tasks_.getEndIndex(); j++) {
+            if (!tasks_.isUsed(j) || tasks_[j].priority != i) continue;
+            if (counter == index) {
+                fillTaskStatistics(&tasks_[j], statistics);
+                return true;
+            }
+            counter++;
+        }
+    }
+
+    return false;
+
+}
+
+
+void Scheduler::resetTaskStatistics() {
+
+#ifdef SIMPLE_SCHEDULE_PROFILING
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) if (tasks_.isUsed(i)) tasks_[i].profiler.clear();
+#endif
+
+}
+
+
+bool Scheduler::addTask(const Task &task, eTaskPriority_t priority) {
+
+    if (priority >= eTaskPriority_t::eTaskPriority_NumPriorities) priority = eTaskPriority_t::eTaskPriority_None;
+
+    //Every queue can hold all tasks, so only the table can be full.
+    Task* newTask = tasks_.addItem(task);
+    if (newTask == nullptr) return false;
+
+    newTask->priority = priority;
+
+    //A notification for the slot that came after its last task was removed must not run the new one.
+    uint32_t index = tasks_.getIndex(newTask);
+    __atomic_fetch_and(&pendingEvents_[index/32], ~(1UL << (index%32)), __ATOMIC_RELAXED);
+
+    taskQueues_[priority].addItem(newTask, getTaskDeadline(newTask));
+
+    //Task could be due before the current closest deadline.
+    updateNextDeadline();
+
+    if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) framesChanged_ = true;
+
+    return true;
 
 }
 
 /**
  * This adds a function to the scheduler.
- * 
+ *
  * Functions cannot return.
- * 
+ *
  * Will return false if fails to add function to scheduler.
- * 
+ *
  * e.g. attachTask(FunctionToBeCalled, 1000, eTaskPriority_t::eTaskPriority_Realtime);
  *
  * @param values function pointer, rate_Hz, priority
@@ -280,53 +966,24 @@ bool Scheduler::attachTask(Thread_Interface* function, uint32_t rate_Hz, eTaskPr
 
     Task task;
     task.thread = function;
-    task.interval = IntervalControl(rate_Hz);
-    task.interval.setLimit(false);
+    task.interval = RateControl(rate_Hz);
     task.numberRunsLeft = numberRuns;
+    task.rate_Hz = rate_Hz;
+    task.periodic = true;
+    if (autoPhase_) task.interval.setPhase(findTaskPhase(task.interval.getIntervalMicros()));
 
-    switch (priority) {
-
-    case eTaskPriority_t::eTaskPriority_Realtime:
-        tasks_[0].addItem(task);
-        break;
-
-    case eTaskPriority_t::eTaskPriority_VeryHigh :
-        tasks_[1].addItem(task);
-        break;
-
-    case eTaskPriority_t::eTaskPriority_High :
-        tasks_[2].addItem(task);
-        break;
-
-    case eTaskPriority_t::eTaskPriority_Middle :
-        tasks_[3].addItem(task);
-        break;
-
-    case eTaskPriority_t::eTaskPriority_Low :
-        tasks_[4].addItem(task);
-        break;
-
-    case eTaskPriority_t::eTaskPriority_VeryLow :
-        tasks_[5].addItem(task);
-        break;
-    
-    default:
-        tasks_[6].addItem(task);
-        break;
-    }
-
-    return true;
+    return addTask(task, priority);
 }
 
 
 /**
  * The given function will be ran at the given time.
- * 
- * 
+ *
+ *
  * Functions cannot return.
- * 
+ *
  * Will return false if fails to add function to scheduler.
- * 
+ *
  * e.g. attachTask(FunctionToBeCalled, 1000, eTaskPriority_t::eTaskPriority_Realtime);
  *
  * @param values function pointer, rate_Hz, priority
@@ -336,50 +993,256 @@ bool Scheduler::attachTask(Thread_Interface* function, uint32_t rate_Hz, eTaskPr
 
     Task task;
     task.thread = function;
-    task.interval = IntervalControl(rate_Hz);
-    //task.interval.setLimit(false);
+    task.interval = RateControl(rate_Hz);
     task.creationTimestamp_us = micros();
     task.removeThreshold_us = time_us;
     task.numberRunsLeft = numberRuns;
     task.limited = true;
+    task.rate_Hz = rate_Hz;
+
+    return addTask(task, priority);
+}
+
+/**
+ * This adds a function that is run when notified.
+ *
+ * Will return false if fails to add function to scheduler.
+ *
+ * e.g. attachEventTask(FunctionToBeCalled, eTaskPriority_t::eTaskPriority_Realtime, 10000);
+ *
+ * @param values function pointer, priority, timeout_us, numberRuns
+ * @return bool.
+ */
+bool Scheduler::attachEventTask(Thread_Interface* function, eTaskPriority_t priority, uint32_t timeout_us, int32_t numberRuns) {
+
+    Task task;
+    task.thread = function;
+    task.numberRunsLeft = numberRuns;
+    task.eventDriven = true;
+    task.eventTimeout_us = timeout_us;
+
+    return addTask(task, priority);
+}
+
+
+bool Scheduler::setTaskNextRun(Thread_Interface* function, const uint32_t &time_us) {
+
+    Task* task = findTask(function);
+    if (task == nullptr || task->framed) return false;
+
+    task->nextRun_us = time_us;
+    task->nextRunSet = true;
+
+    //A running task is placed into its queue once it returns.
+    if (task != currentRunningTask_) {
+        if (!taskQueues_[task->priority].removeItem(task)) readyQueue_.removeItem(task);
+        taskQueues_[task->priority].addItem(task, time_us);
+        updateNextDeadline();
+    }
+
+    return true;
+
+}
+
+
+bool Scheduler::setTaskPhase(Thread_Interface* function, const uint32_t &phase_us) {
+
+    Task* task = findTask(function);
+    if (task == nullptr || !task->periodic) return false;
+
+    task->interval.setPhase(phase_us%task->interval.getIntervalMicros());
+
+    //The next run moved onto the new phase.
+    if (task != currentRunningTask_ && taskQueues_[task->priority].removeItem(task)) {
+        taskQueues_[task->priority].addItem(task, task->nextRunSet ? task->nextRun_us : getTaskDeadline(task));
+        updateNextDeadline();
+    }
+
+    return true;
+
+}
+
+
+uint32_t Scheduler::findTaskPhase(const uint32_t &interval_us) {
+
+    if (interval_us == 0) return 0;
+
+    uint32_t minDistances[SIMPLE_SCHEDULE_PHASE_STEPS];
+    uint32_t distanceSums[SIMPLE_SCHEDULE_PHASE_STEPS];
+    for (uint32_t step = 0; step < SIMPLE_SCHEDULE_PHASE_STEPS; step++) {
+        minDistances[step] = UINT32_MAX;
+        distanceSums[step] = 0;
+    }
 
-    switch (priority) {
+    //Tasks in the outer loop, so the gcd is calculated once per task instead of for every step.
+    for (uint32_t i = 0; i < tasks_.getEndIndex(); i++) {
 
-    case eTaskPriority_t::eTaskPriority_Realtime:
-        tasks_[0].addItem(task);
-        break;
+        if (!tasks_.isUsed(i) || !tasks_[i].periodic) continue;
 
-    case eTaskPriority_t::eTaskPriority_VeryHigh :
-        tasks_[1].addItem(task);
-        break;
+        //Runs of both tasks repeat relative to each other every gcd of the intervals, so the closest two runs get is the phase difference modulo the gcd.
+        uint32_t a = interval_us, b = tasks_[i].interval.getIntervalMicros();
+        while (b != 0) {uint32_t t = a%b; a = b; b = t;}
 
-    case eTaskPriority_t::eTaskPriority_High :
-        tasks_[2].addItem(task);
-        break;
+        uint32_t taskPhase = tasks_[i].interval.getPhase()%a;
 
-    case eTaskPriority_t::eTaskPriority_Middle :
-        tasks_[3].addItem(task);
-        break;
+        for (uint32_t step = 0; step < SIMPLE_SCHEDULE_PHASE_STEPS; step++) {
 
-    case eTaskPriority_t::eTaskPriority_Low :
-        tasks_[4].addItem(task);
-        break;
+            uint32_t phase = (uint64_t)interval_us*step/SIMPLE_SCHEDULE_PHASE_STEPS;
+            uint32_t difference = (phase%a + a - taskPhase)%a;
+            uint32_t distance = difference < a - difference ? difference : a - difference;
 
-    case eTaskPriority_t::eTaskPriority_VeryLow :
-        tasks_[5].addItem(task);
-        break;
-    
-    default:
-        tasks_[6].addItem(task);
-        break;
+            if (distance < minDistances[step]) minDistances[step] = distance;
+            distanceSums[step] += distance;
+
+        }
+
+    }
+
+    uint32_t bestStep = 0;
+    for (uint32_t step = 1; step < SIMPLE_SCHEDULE_PHASE_STEPS; step++) {
+        if (minDistances[step] > minDistances[bestStep] || (minDistances[step] == minDistances[bestStep] && distanceSums[step] > distanceSums[bestStep])) bestStep = step;
     }
 
+    return (uint64_t)interval_us*bestStep/SIMPLE_SCHEDULE_PHASE_STEPS;
+
+}
+
+
+bool Scheduler::setTaskCatchUp(Thread_Interface* function, const eRateCatchUp_t &catchUp, const uint32_t &burstLimit) {
+
+    Task* task = findTask(function);
+    if (task == nullptr) return false;
+
+    task->interval.setCatchUp(catchUp, burstLimit);
+
+    return true;
+
+}
+
+
+bool Scheduler::setTaskBudget(Thread_Interface* function, const uint32_t &budget_us) {
+
+    Task* task = findTask(function);
+    if (task == nullptr) return false;
+
+    task->budget_us = budget_us;
+    if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) framesChanged_ = true;
+
     return true;
+
 }
 
+
+void Scheduler::setCyclicPriority(const eTaskPriority_t &priority) {
+
+    cyclicPriority_ = priority;
+    if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) framesChanged_ = true;
+
+}
+
+
+bool Scheduler::setTaskShedding(Thread_Interface* function, const eTaskShedding_t &shedding) {
+
+    Task* task = findTask(function);
+    if (task == nullptr) return false;
+
+    task->shedding = shedding;
+
+    return true;
+
+}
+
+
+int32_t Scheduler::getTaskHandle(Thread_Interface* function) {
+
+    Task* task = findTask(function);
+    if (task == nullptr) return -1;
+
+    return tasks_.getIndex(task);
+
+}
+
+
+void Scheduler::notifyFromISR(const uint32_t &taskHandle) {
+
+    if (taskHandle >= SIMPLE_SCHEDULE_MAX_TASKS) return;
+
+    uint32_t bit = 1UL << (taskHandle%32);
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    taskTrace.record(eTraceEvent_t::eTraceEvent_Notify, taskHandle);
+#endif
+
+    //Only the first notification sets the release time, so the start jitter includes all waiting.
+    if ((pendingEvents_[taskHandle/32] & bit) == 0) eventTimestamps_us_[taskHandle] = micros();
+    __atomic_fetch_or(&pendingEvents_[taskHandle/32], bit, __ATOMIC_RELEASE);
+
+    wakeupPending_ = true;
+
+}
+
+
+bool Scheduler::addTaskDependency(Thread_Interface* upstream, Thread_Interface* downstream) {
+
+    Task* upstreamTask = findTask(upstream);
+    Task* downstreamTask = findTask(downstream);
+    if (upstreamTask == nullptr || downstreamTask == nullptr || upstreamTask == downstreamTask) return false;
+    if (upstreamTask->numberDependents >= SIMPLE_SCHEDULE_MAX_DEPENDENTS) return false;
+
+    uint16_t index = tasks_.getIndex(downstreamTask);
+    for (uint8_t i = 0; i < upstreamTask->numberDependents; i++) if (upstreamTask->dependents[i] == index) return true; //Already added.
+
+    upstreamTask->dependents[upstreamTask->numberDependents++] = index;
+    downstreamTask->numberUpstreams++;
+
+    if (!updatePipelineOrder()) {
+        upstreamTask->numberDependents--;
+        downstreamTask->numberUpstreams--;
+        updatePipelineOrder();
+        return false;
+    }
+
+    downstreamTask->pipelineDue_us = micros();
+
+    //Order within the frames changed.
+    if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) framesChanged_ = true;
+
+    return true;
+
+}
+
+
+bool Scheduler::removeTaskDependency(Thread_Interface* upstream, Thread_Interface* downstream) {
+
+    Task* upstreamTask = findTask(upstream);
+    Task* downstreamTask = findTask(downstream);
+    if (upstreamTask == nullptr || downstreamTask == nullptr) return false;
+
+    uint16_t index = tasks_.getIndex(downstreamTask);
+    for (uint8_t i = 0; i < upstreamTask->numberDependents; i++) {
+        if (upstreamTask->dependents[i] != index) continue;
+        upstreamTask->dependents[i] = upstreamTask->dependents[--upstreamTask->numberDependents];
+        downstreamTask->numberUpstreams--;
+        updatePipelineOrder();
+        if (schedulePolicy_ == eSchedulePolicy_t::eSchedulePolicy_CyclicExecutive) framesChanged_ = true;
+        return true;
+    }
+
+    return false;
+
+}
+
+
+void Scheduler::releaseDependents(const uint32_t &taskHandle) {
+
+    if (tasks_.isUsed(taskHandle)) tasks_[taskHandle].dependentsReleased = true;
+
+}
+
+
 /**
  * This removes a function from the scheduler.
- * 
+ *
  * Returns false if function not found.
  *
  * @param values none.
@@ -387,14 +1250,33 @@ bool Scheduler::attachTask(Thread_Interface* function, uint32_t rate_Hz, eTaskPr
  */
 bool Scheduler::detachTask(Thread_Interface* function) {
 
-    Task toBeRemoved;
-    toBeRemoved.thread = function;
+    Task* task = findTask(function);
+    if (task == nullptr) return false;
 
-    for (uint8_t i = 0; i < 7; i++) {
-        if (tasks_[i].removeItem(toBeRemoved)) {
-            return true;
-        }
+    //A running task is not in its queue and must not be touched after returning.
+    if (task == currentRunningTask_) currentTaskDetached_ = true;
+    else if (!taskQueues_[task->priority].removeItem(task)) readyQueue_.removeItem(task);
+
+    //A notification that was not handled yet must not run a task that later reuses the slot.
+    uint32_t index = tasks_.getIndex(task);
+    __atomic_fetch_and(&pendingEvents_[index/32], ~(1UL << (index%32)), __ATOMIC_RELAXED);
+
+    //Same for the frames, which are only built again on the next tick. Every entry is a single write, so the frame timer sees either the task or nothing.
+    if (task->framed) {
+        for (uint32_t i = 0; i < frameStarts_[numberFrames_]; i++) if (frameEntries_[i] == index) frameEntries_[i] = UINT16_MAX;
+        framesChanged_ = true;
     }
 
-    return false;
+    //The slot can be reused by another task, which must not inherit dependencies.
+    removeTaskDependencies(index);
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    //Events of the removed task keep its name until another task uses the slot.
+    taskTrace.setTaskName(index, function->getThreadName());
+#endif
+
+    tasks_.removeItem(task);
+
+    return true;
+
 }
@@ -3,8 +3,53 @@
 
 
 
-#include "chain_buffer.h"
-#include "interval_control.h"
+#include "rate_control.h"
+#include "timer_queue.h"
+#include "task_table.h"
+#include "task_profiler.h"
+#include "task_trace.h"
+
+
+
+//Maximum number of tasks that can be attached to a scheduler. Memory for all of them is reserved. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_MAX_TASKS
+#define SIMPLE_SCHEDULE_MAX_TASKS 64
+#endif
+
+//Maximum number of tasks that can directly depend on a single task. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_MAX_DEPENDENTS
+#define SIMPLE_SCHEDULE_MAX_DEPENDENTS 4
+#endif
+
+//Number of phases within its interval that are tried when placing a periodic task. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_PHASE_STEPS
+#define SIMPLE_SCHEDULE_PHASE_STEPS 32
+#endif
+
+//Maximum number of minor frames in the major frame of the cyclic executive. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_MAX_FRAMES
+#define SIMPLE_SCHEDULE_MAX_FRAMES 1024
+#endif
+
+//Maximum number of task runs over all frames of the major frame. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_MAX_FRAME_ENTRIES
+#define SIMPLE_SCHEDULE_MAX_FRAME_ENTRIES 2048
+#endif
+
+//Interrupt priority of the frame timer on the Teensy 4. Below the default of 128, so sensor and radio interrupts are not delayed by a frame.
+#ifndef SIMPLE_SCHEDULE_FRAME_PRIORITY
+#define SIMPLE_SCHEDULE_FRAME_PRIORITY 160
+#endif
+
+//Waits shorter than this are not worth sleeping for and are spun instead. In microseconds.
+#ifndef SIMPLE_SCHEDULE_MIN_IDLE_US
+#define SIMPLE_SCHEDULE_MIN_IDLE_US 5
+#endif
+
+//Records execution time, start jitter and missed deadlines of every task. Define SIMPLE_SCHEDULE_NO_PROFILING to remove.
+#ifndef SIMPLE_SCHEDULE_NO_PROFILING
+#define SIMPLE_SCHEDULE_PROFILING
+#endif
 
 
 
@@ -24,6 +69,9 @@ public:
     //This is ran only when the Task is removed from scheduler.
     virtual void removal() = 0;
 
+    //Name used in task statistics. Optional.
+    virtual const char* getThreadName() {return "";}
+
 };
 
 
@@ -100,6 +148,71 @@ enum eTaskPriority_t {
     eTaskPriority_VeryHigh,
     //Will always run once it needs to.
     eTaskPriority_Realtime,
+    //Not a priority. Number of priorities there are.
+    eTaskPriority_NumPriorities
+};
+
+
+
+/**
+ * Decides which of the due tasks the scheduler runs first.
+ */
+enum eSchedulePolicy_t {
+    //Only the highest priority with due tasks is run. Lower priorities wait until higher ones are done.
+    eSchedulePolicy_Priority,
+    //Due task with the closest deadline is run first. The deadline of a run is the time its next run is due, so it follows from the rate. Priorities are ignored.
+    eSchedulePolicy_EarliestDeadline,
+    //Periodic tasks with at least the cyclic priority and a budget run from a fixed table of frames that is built once. The rest are background tasks run by priority in the time left.
+    //See Scheduler::setCyclicPriority().
+    eSchedulePolicy_CyclicExecutive
+};
+
+
+
+/**
+ * Decides what happens to a task while the scheduler is overloaded.
+ */
+enum eTaskShedding_t {
+    //Task keeps its rate. Default and meant for everything needed to fly.
+    eTaskShedding_Never,
+    //Task runs at a fraction of its rate. E.g. telemetry and heartbeats.
+    eTaskShedding_ReduceRate,
+    //Task is not run until the overload is over. E.g. displays.
+    eTaskShedding_Skip
+};
+
+
+
+/**
+ * Settings of the overload detection. See Scheduler::setOverloadPolicy().
+ * Time is split into windows. A window is overloaded if the tasks used too much of it, too many runs of
+ * tasks that are never shed started more than a whole interval late, or a due task waited longer than the window.
+ */
+struct OverloadPolicy {
+
+    //Length of a window in microseconds.
+    uint32_t window_us = 100000;
+
+    //Part of a window used by tasks above which it is overloaded. From 0 to 1.
+    float overloadLoad = 0.9f;
+    //Part of a window used by tasks below which it counts towards recovering. From 0 to 1.
+    float recoverLoad = 0.7f;
+
+    //Part of the runs of tasks that are never shed that started more than an interval late, above which it is overloaded. From 0 to 1.
+    float overloadLateRuns = 0.05f;
+    //Part of late runs below which it counts towards recovering. From 0 to 1.
+    float recoverLateRuns = 0.02f;
+
+    //Number of overloaded windows in a row before tasks are shed.
+    uint8_t overloadWindows = 2;
+    //Number of recovering windows in a row before tasks run normally again.
+    uint8_t recoverWindows = 10;
+    //Most recovering windows needed after repeated overloads. An overload that starts within the last recovery time after recovering doubles the time, as its cause is still there.
+    uint8_t maxRecoverWindows = 80;
+
+    //Tasks with eTaskShedding_ReduceRate run at their rate divided by this while overloaded.
+    uint8_t rateDivider = 4;
+
 };
 
 
@@ -112,6 +225,9 @@ public:
     /**
      * This is the loop for the scheduler.
      * It will check for functions that need to be ran and run them.
+     * 
+     * Tasks are kept in a queue per priority, sorted by their next run. If nothing 
+     * is due then this only compares the current time with the closest deadline.
      *
      * @param values none.
      * @return none.
@@ -119,7 +235,8 @@ public:
     void tick();
 
     /**
-     * Calls all initialisation functions that are attached
+     * Calls all initialisation functions that are attached.
+     * With eSchedulePolicy_CyclicExecutive this also builds the frames and starts running them.
      */
     void initializeTasks();
 
@@ -177,6 +294,211 @@ public:
      */
     bool attachTask(Thread_Interface* function, uint32_t rate_Hz, eTaskPriority_t priority, uint32_t time_us, int32_t numberRuns = -1);
 
+    /**
+     * Adds a function that is not run at a rate but only after notifyFromISR() was called with its handle.
+     * If a timeout is given, then it is also run once no notification came for that long.
+     * 
+     * Will return false if fails to add function to scheduler.
+     * 
+     * e.g. attachEventTask(FunctionToBeCalled, eTaskPriority_t::eTaskPriority_Realtime, 10000);
+     *
+     * @param function Function to be run.
+     * @param priority Priority of the function.
+     * @param timeout_us Time in microseconds after the last run at which to run without notification. 0 to only run on notifications.
+     * @param numberRuns Number of runs before removal. -1 for infinite.
+     * @return bool.
+     */
+    bool attachEventTask(Thread_Interface* function, eTaskPriority_t priority, uint32_t timeout_us = 0, int32_t numberRuns = -1);
+
+    /**
+     * Makes the next run of a task happen at the given time instead of its normal deadline.
+     * A task can call this on itsself to continue later without blocking, e.g. a coroutine waiting.
+     * 
+     * @param function Task to move.
+     * @param time_us Timestamp in microseconds at which the task should run.
+     * @returns false if task not found or in the frames of the cyclic executive.
+     */
+    bool setTaskNextRun(Thread_Interface* function, const uint32_t &time_us);
+
+    /**
+     * Sets the phase of a periodic task. It then runs when micros() % interval == phase_us.
+     * Overrides the phase chosen by auto phasing. Tasks attached later are placed around it.
+     * 
+     * @param function Task to change.
+     * @param phase_us Phase in microseconds.
+     * @returns false if task not found.
+     */
+    bool setTaskPhase(Thread_Interface* function, const uint32_t &phase_us);
+
+    /**
+     * If enabled then periodic tasks get a phase when attached, so that their runs are
+     * as far as possible from the runs of all tasks attached before. Tasks with the same
+     * or harmonic rates then do not all become due on the same tick. Default is disabled.
+     * The search takes SIMPLE_SCHEDULE_PHASE_STEPS times the number of periodic tasks on every
+     * attach, so enable it while setting up and disable it before tasks are attached while running.
+     * Tasks that use each others data without a pipeline can get more latency from their phases.
+     * 
+     * @param enable true to choose phases automatically.
+     */
+    void setAutoPhase(const bool &enable) {autoPhase_ = enable;}
+
+    /**
+     * Sets what happens to the runs of a periodic task that were missed, e.g. because higher priorities
+     * took too long. Default is eRateCatchUp_Skip, which keeps the task on its grid without making up runs.
+     * 
+     * @param function Task to change.
+     * @param catchUp is of type eRateCatchUp_t.
+     * @param burstLimit is the number of missed runs to make up with eRateCatchUp_Burst.
+     * @returns false if task not found.
+     */
+    bool setTaskCatchUp(Thread_Interface* function, const eRateCatchUp_t &catchUp, const uint32_t &burstLimit = 4);
+
+    /**
+     * Sets the worst case execution time of a task. Only tasks with a budget are placed into the frames of the
+     * cyclic executive, which uses it to spread them so no frame takes longer than the others. If a budget or the
+     * budgets of a frame are longer than the frame length, no frames are built and all tasks run from their queues by priority.
+     * 
+     * @param function Task to change.
+     * @param budget_us Execution time in microseconds. 0 to keep the task out of the frames.
+     * @returns false if task not found.
+     */
+    bool setTaskBudget(Thread_Interface* function, const uint32_t &budget_us);
+
+    /**
+     * Sets which tasks the cyclic executive places into frames. These are all tasks with at least the given priority and
+     * a budget set with setTaskBudget() that run forever at a rate that is a whole number of microseconds. Default is eTaskPriority_High.
+     * On the Teensy 4 these tasks run inside the frame timer interrupt. They must never block or wait for anything,
+     * e.g. SPI transfers, bus locks, delay() or yield().
+     * 
+     * @param priority Lowest priority to place into frames.
+     */
+    void setCyclicPriority(const eTaskPriority_t &priority);
+
+    /**
+     * Replaces the timer that runs the frames of the cyclic executive. The given function is called with the
+     * frame length when the frames start and with 0 when they stop. It must then call runNextFrame() every frame length.
+     * Without a timer function the frames are run from an IntervalTimer on the Teensy 4 and from tick() elsewhere.
+     * 
+     * @param frameTimerFunction Function to call or nullptr to use the default.
+     */
+    void setFrameTimerFunction(void (*frameTimerFunction)(uint32_t frameLength_us)) {frameTimerFunction_ = frameTimerFunction;}
+
+    /**
+     * Runs the tasks of the next minor frame of the cyclic executive. Called by the frame timer.
+     */
+    void runNextFrame() {if (numberFrames_ > 0) runFrame(micros());}
+
+    /**
+     * @returns length of a minor frame in microseconds. 0 if the cyclic executive is not running.
+     */
+    uint32_t getFrameLength_us() {return numberFrames_ > 0 ? frameLength_us_ : 0;}
+
+    /**
+     * @returns number of minor frames in the major frame. 0 if the cyclic executive is not running.
+     */
+    uint32_t getNumberFrames() {return numberFrames_;}
+
+    /**
+     * @returns sum of the task budgets of the fullest frame in microseconds. If above the frame length
+     * then the frames were not used.
+     */
+    uint32_t getFrameBudgetPeak_us() {return frameBudgetPeak_us_;}
+
+    /**
+     * @returns how often a frame took longer than the frame length or was skipped since start.
+     */
+    uint32_t getFrameOverruns() {return frameOverruns_;}
+
+    /**
+     * Returns the handle used to notify a task.
+     * The handle stays valid until the task is detached.
+     * 
+     * @param function Task to get the handle from.
+     * @returns handle or -1 if task not found.
+     */
+    int32_t getTaskHandle(Thread_Interface* function);
+
+    /**
+     * Makes an event task due on the next tick. Only sets a bit, so it is safe to call 
+     * from interrupts and from other tasks. Multiple notifications before the task 
+     * runs result in a single run.
+     * 
+     * @param taskHandle Handle from getTaskHandle().
+     */
+    void notifyFromISR(const uint32_t &taskHandle);
+
+    /**
+     * Makes a task a stage of a pipeline that runs after its upstream task.
+     * Once the upstream task called releaseDependents() during its run, all tasks depending on it
+     * are run directly after it in the same tick, in dependency order. This way data from a sensor
+     * goes through e.g. navigation and control without waiting for each stage's next deadline.
+     * 
+     * A downstream task is run at most at its own rate. Tasks with a rate of 0 run on every release.
+     * It is only run on its own after missing a whole interval of releases, e.g. if the upstream task stopped.
+     * Both tasks must be attached. Dependencies are removed once either of them is detached.
+     * 
+     * @param upstream Task that produces data.
+     * @param downstream Task that uses the data.
+     * @returns false if a task was not found, the upstream task has too many dependents or a cycle would be formed.
+     */
+    bool addTaskDependency(Thread_Interface* upstream, Thread_Interface* downstream);
+
+    /**
+     * Removes a dependency added with addTaskDependency().
+     * 
+     * @param upstream Task that produces data.
+     * @param downstream Task that uses the data.
+     * @returns false if the dependency was not found.
+     */
+    bool removeTaskDependency(Thread_Interface* upstream, Thread_Interface* downstream);
+
+    /**
+     * Marks that a task produced new data. Should be called by the task during its run.
+     * Its dependent tasks are run once it returns.
+     * 
+     * @param taskHandle Handle from getTaskHandle().
+     */
+    void releaseDependents(const uint32_t &taskHandle);
+
+    /**
+     * Sets what happens to a task while the scheduler is overloaded. Default is eTaskShedding_Never.
+     * Tasks that run on notifications are never shed.
+     * 
+     * @param function Task to change.
+     * @param shedding What to do with the task.
+     * @returns false if task not found.
+     */
+    bool setTaskShedding(Thread_Interface* function, const eTaskShedding_t &shedding);
+
+    /**
+     * Sets when the scheduler counts as overloaded and how much tasks are shed.
+     * 
+     * @param policy is the policy to use.
+     */
+    void setOverloadPolicy(const OverloadPolicy &policy) {overloadPolicy_ = policy;}
+
+    /**
+     * @returns the policy used to detect overloads.
+     */
+    OverloadPolicy getOverloadPolicy() {return overloadPolicy_;}
+
+    /**
+     * Returns true while the scheduler is overloaded and tasks are shed.
+     * 
+     * @returns true if overloaded.
+     */
+    bool isOverloaded() {return overloaded_;}
+
+    /**
+     * @returns how often the scheduler became overloaded since start.
+     */
+    uint32_t getOverloadCount() {return overloadCount_;}
+
+    /**
+     * @returns part of the last window used by tasks. From 0 to 1.
+     */
+    float getWindowLoad() {return windowLoad_;}
+
     /**
      * This removes a function from the scheduler.
      * 
@@ -194,6 +516,110 @@ public:
      */
     uint32_t getTickRate() {return tickRate_;}
 
+    /**
+     * If enabled then tick() will put the CPU to sleep until the next task is due
+     * instead of returning immediately. Any interrupt also wakes it up.
+     * On the Teensy 4 a timer is set to the next deadline and WFI is used.
+     * Default is disabled.
+     * 
+     * @param enable true to sleep when nothing is to be done.
+     */
+    void setIdleSleep(const bool &enable) {idleSleep_ = enable;}
+
+    /**
+     * Replaces the way the scheduler sleeps. The given function is called with the timestamp 
+     * of the next deadline and should return once it was reached or something else has to be done.
+     * Can be used on platforms without WFI, e.g. to advance a virtual clock on the host.
+     * 
+     * @param idleFunction Function to call or nullptr to use the default.
+     */
+    void setIdleFunction(void (*idleFunction)(uint32_t until_us)) {idleFunction_ = idleFunction;}
+
+    /**
+     * Makes the scheduler check all tasks on the next tick, even if no deadline was reached. 
+     * Wakes it up if sleeping. Safe to call from interrupts.
+     */
+    void wakeupFromISR() {wakeupPending_ = true;}
+
+    /**
+     * Returns how much of the last second the scheduler was sleeping.
+     * 
+     * @returns idle time from 0 to 1.
+     */
+    float getIdleRatio() {return idleRatio_;}
+
+    /**
+     * Returns by how much waking up missed the deadline it was sleeping for, averaged over the last second.
+     * Wakeups by other interrupts before the deadline are not counted.
+     * 
+     * @returns latency in microseconds.
+     */
+    uint32_t getWakeupLatencyMean_us() {return wakeupLatencyMean_us_;}
+
+    /**
+     * @returns largest wakeup latency in the last second in microseconds.
+     */
+    uint32_t getWakeupLatencyMax_us() {return wakeupLatencyMax_us_;}
+
+    /**
+     * Sets how the scheduler decides which task to run. Can be changed at any time.
+     * Default is eSchedulePolicy_Priority.
+     * 
+     * @param policy is the policy to use.
+     */
+    void setSchedulePolicy(const eSchedulePolicy_t &policy);
+
+    /**
+     * @returns the policy that is used to decide which task to run.
+     */
+    eSchedulePolicy_t getSchedulePolicy() {return schedulePolicy_;}
+
+    /**
+     * @returns number of tasks attached to the scheduler.
+     */
+    uint32_t getNumberTasks();
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+    /**
+     * Gives the trace the names of all attached tasks. Must be called before reading the trace,
+     * as names are mostly set after a task was attached.
+     */
+    void updateTraceNames();
+#endif
+
+    /**
+     * Gets the execution time, jitter and missed deadline statistics of a task.
+     * Only filled with measurements if SIMPLE_SCHEDULE_PROFILING is defined.
+     * 
+     * @param function Task to get statistics from.
+     * @param statistics Struct to be written into.
+     * @returns false if task was not found.
+     */
+    bool getTaskStatistics(Thread_Interface* function, TaskStatistics* statistics);
+
+    /**
+     * Gets the statistics of the task at the given index. Can be used to go through all tasks.
+     * Indexes start at the highest priority. Attaching or detaching tasks changes the indexes.
+     * 
+     * @param index From 0 to getNumberTasks()-1.
+     * @param statistics Struct to be written into.
+     * @returns false if index is out of range.
+     */
+    bool getTaskStatistics(const uint32_t &index, TaskStatistics* statistics);
+
+    /**
+     * Removes all measurements of all tasks.
+     */
+    void resetTaskStatistics();
+
+    /**
+     * Returns how much of the CPU time all tasks of a priority used in the last second.
+     * 
+     * @param priority Priority to get load from.
+     * @returns load from 0 to 1.
+     */
+    float getPriorityLoad(const eTaskPriority_t &priority) {return priority < eTaskPriority_t::eTaskPriority_NumPriorities ? priorityLoad_[priority] : 0;}
+
 
 private:
 
@@ -201,7 +627,10 @@ private:
     struct Task {
 
         Thread_Interface* thread;
-        IntervalControl interval;
+        RateControl interval;
+
+        //Index of the priority queue this task is in. Same as eTaskPriority_t value.
+        uint8_t priority = eTaskPriority_t::eTaskPriority_None;
 
         //If true then do not run task.
         bool isSuspended = false;
@@ -215,27 +644,287 @@ private:
 
         //If set to true then remove once remove timestamp is reached.
         bool limited = false;
+
+        //If set to true then only run on notifications or after the timeout.
+        bool eventDriven = false;
+        //Time without notification after which an event task is run anyways. 0 for no timeout.
+        uint32_t eventTimeout_us = 0;
+        //Set once an event task was notified. Cleared when its thread runs.
+        bool eventPending = false;
+
+        //If set to true then the next run is at nextRun_us and not at the normal deadline.
+        bool nextRunSet = false;
+        uint32_t nextRun_us = 0;
         //If set to 0 then no limit. Should be decremented every run.
         int32_t numberRunsLeft = 0;
 
-        //Operator must be overloaded for the Chainbuffer to find the correct Task. Only the function pointers must be the same.
-        bool operator == (Task b) {
-            return thread == b.thread;
-        }
+        //Rate the task was attached with. Only used for statistics.
+        uint32_t rate_Hz = 0;
+
+        //Timestamp the task became due at. Only valid while in the ready queue.
+        uint32_t release_us = 0;
+
+        //Table slots of tasks that run after this one released them.
+        uint16_t dependents[SIMPLE_SCHEDULE_MAX_DEPENDENTS];
+        uint8_t numberDependents = 0;
+        //Number of tasks this one depends on. If not 0 it is mostly run by its pipeline.
+        uint8_t numberUpstreams = 0;
+        //Set during a run to run the dependents afterwards.
+        bool dependentsReleased = false;
+        //Time the next pipeline run is due. Keeps pipeline runs at the task rate.
+        uint32_t pipelineDue_us = 0;
+
+        //What to do with this task while overloaded. eTaskShedding_t value.
+        uint8_t shedding = eTaskShedding_t::eTaskShedding_Never;
+
+        //If set then the runs are aligned to the phase of the interval.
+        bool periodic = false;
+
+        //Set while the task is run from the frames of the cyclic executive and not from its queue.
+        bool framed = false;
+        //Worst case execution time in microseconds used to place the task into frames. 0 if unknown.
+        uint32_t budget_us = 0;
+
+#ifdef SIMPLE_SCHEDULE_PROFILING
+        TaskProfiler profiler;
+#endif
 
     };
 
-    ChainBuffer<Task> tasks_[7]; //array size must be as big, as the number of priorities there are.
+    /**
+     * Adds the task to the table and queue of its priority.
+     * 
+     * @returns false if the table is full.
+     */
+    bool addTask(const Task &task, eTaskPriority_t priority);
+
+    /**
+     * Finds the phase at which a task with the given interval has the most time between its
+     * runs and the runs of all periodic tasks already attached.
+     * 
+     * @param interval_us Interval of the task to place.
+     * @returns phase in microseconds.
+     */
+    uint32_t findTaskPhase(const uint32_t &interval_us);
+
+    /**
+     * Runs init, thread or removal of a task that is due and puts it back into its queue.
+     * 
+     * @param task Task to run.
+     * @param deadline Timestamp the task was due at. Used for statistics.
+     */
+    void runTask(Task* task, const uint32_t &deadline);
+
+    /**
+     * Searches for a task in all priorities.
+     * 
+     * @returns pointer to task or nullptr if not found.
+     */
+    Task* findTask(Thread_Interface* function);
+
+    /**
+     * Fills statistics struct from task.
+     */
+    void fillTaskStatistics(Task* task, TaskStatistics* statistics);
+
+    /**
+     * Returns the timestamp at which the task must next be checked.
+     */
+    uint32_t getTaskDeadline(Task* task);
+
+    /**
+     * Places all notified event tasks into their queue so they are due.
+     */
+    void handleEvents();
+
+    /**
+     * Event tasks only run when notified or once their timeout passed without a notification.
+     *
+     * @param initRan if true then the task was only due to run init.
+     * @returns true if the thread of the event task should run.
+     */
+    bool isEventDue(Task* task, const bool &initRan);
+
+    /**
+     * Runs all due tasks of the highest priority that has due tasks. Used by eSchedulePolicy_Priority.
+     */
+    void tickPriority(const uint32_t &now);
+
+    /**
+     * Returns the deadline used by eSchedulePolicy_EarliestDeadline for a task that is due.
+     * This is the time its next run would be due.
+     */
+    uint32_t getTaskEDFDeadline(Task* task, const uint32_t &release);
+
+    /**
+     * Runs the due task with the earliest deadline. Used by eSchedulePolicy_EarliestDeadline.
+     */
+    void tickEarliestDeadline(const uint32_t &now);
+
+    /**
+     * Runs all tasks reached from the source over released dependencies in dependency order.
+     * 
+     * @param source Task that released its dependents.
+     * @param release Time the source was due at. Start jitter of all stages is measured from this.
+     */
+    void runPipeline(Task* source, const uint32_t &release);
+
+    /**
+     * Sorts all tasks with dependencies so every task comes after all tasks it depends on.
+     * 
+     * @returns false if the dependencies contain a cycle.
+     */
+    bool updatePipelineOrder();
+
+    /**
+     * Removes all dependencies from and to the task in the given slot.
+     */
+    void removeTaskDependencies(const uint32_t &index);
+
+    /**
+     * Puts all tasks back into their queues and, if the cyclic executive is used, builds the frames again and starts them.
+     * Tasks are placed fastest first into the frames with the least budget. Pipeline stages come after their upstream
+     * tasks within a frame and are placed into frames their upstream tasks run in.
+     * 
+     * @returns false if no frames could be built, e.g. because the rates need more than SIMPLE_SCHEDULE_MAX_FRAMES.
+     */
+    bool buildFrames();
+
+    /**
+     * @returns true if the task can be run from frames.
+     */
+    bool isFrameTask(Task* task);
+
+    /**
+     * Runs all tasks of the current frame and moves on to the next one.
+     * 
+     * @param frameStart Time the frame started at. Start jitter of its tasks is measured from this.
+     */
+    void runFrame(const uint32_t &frameStart);
+
+    /**
+     * Starts the frame timer with the given frame length or stops it if 0.
+     */
+    void setFrameTimer(const uint32_t &frameLength_us);
+
+    /**
+     * Evaluates the window that just ended and starts or stops shedding tasks.
+     */
+    void checkOverload(const uint32_t &now);
+
+    /**
+     * Recalculates the closest deadline over all priority queues.
+     */
+    void updateNextDeadline();
+
+    /**
+     * Sleeps until the given timestamp or an interrupt. Records idle time and wakeup latency.
+     */
+    void idleWait(const uint32_t &until_us);
+
+    //All attached tasks. Tasks do not move in memory, so the queues can point to them.
+    TaskTable<Task, SIMPLE_SCHEDULE_MAX_TASKS> tasks_;
+
+    //Tasks of every priority sorted by their next deadline.
+    TimerQueue<Task, SIMPLE_SCHEDULE_MAX_TASKS> taskQueues_[eTaskPriority_t::eTaskPriority_NumPriorities];
+
+    //Due tasks sorted by their deadline. Only used by eSchedulePolicy_EarliestDeadline.
+    TimerQueue<Task, SIMPLE_SCHEDULE_MAX_TASKS> readyQueue_;
+
+    eSchedulePolicy_t schedulePolicy_ = eSchedulePolicy_t::eSchedulePolicy_Priority;
+
+    //Choose phases of periodic tasks when attached.
+    bool autoPhase_ = false;
+
+    //Closest deadline over all queues and the tickrate measurement. Nothing has to be done before this is reached.
+    uint32_t nextDeadline_us_ = 0;
+
+    //Slots of all tasks with dependencies sorted so that a task comes after its upstream tasks.
+    uint16_t pipelineOrder_[SIMPLE_SCHEDULE_MAX_TASKS];
+    uint32_t pipelineLength_ = 0;
+    //Set while a pipeline is run, so stages do not start pipelines themselves.
+    bool pipelineRunning_ = false;
+    //Set if the order changed. A running pipeline then stops as slots could have been reused.
+    bool pipelineChanged_ = false;
 
     //Points to the thread the is currently running.
     Task* currentRunningTask_ = nullptr;
+    //Set to true if the currently running task was detached while running.
+    bool currentTaskDetached_ = false;
+
+    //Time used by each priority since last tickrate calculation.
+    uint32_t priorityBusyTime_us_[eTaskPriority_t::eTaskPriority_NumPriorities] = {0};
+    //Load of each priority over the last second.
+    float priorityLoad_[eTaskPriority_t::eTaskPriority_NumPriorities] = {0};
+
+    OverloadPolicy overloadPolicy_;
+    //Set while tasks are shed.
+    bool overloaded_ = false;
+    uint32_t overloadCount_ = 0;
+    //Counters of windows in a row that were overloaded or recovering.
+    uint8_t overloadedWindows_ = 0;
+    uint8_t recoveredWindows_ = 0;
+    //Recovering windows needed to end the current overload and windows since the last one ended.
+    uint8_t recoverWindows_ = 0;
+    uint8_t windowsSinceRecovery_ = UINT8_MAX;
+    //Measurements of the current window.
+    uint32_t overloadWindowStart_us_ = 0;
+    uint32_t windowBusyTime_us_ = 0;
+    uint32_t windowLateRuns_ = 0;
+    uint32_t windowRuns_ = 0;
+    //Load of the last window.
+    float windowLoad_ = 0;
+
+    //Lowest priority that is run from frames by the cyclic executive.
+    eTaskPriority_t cyclicPriority_ = eTaskPriority_t::eTaskPriority_High;
+    //Set if tasks changed so the frames are built again on the next tick.
+    volatile bool framesChanged_ = false;
+    //Table of the major frame. The tasks of frame i are frameEntries_[frameStarts_[i]] up to frameStarts_[i + 1]. UINT16_MAX marks removed tasks.
+    uint16_t frameStarts_[SIMPLE_SCHEDULE_MAX_FRAMES + 1] = {0};
+    uint16_t frameEntries_[SIMPLE_SCHEDULE_MAX_FRAME_ENTRIES];
+    //0 while no frames are run.
+    volatile uint32_t numberFrames_ = 0;
+    uint32_t frameLength_us_ = 0;
+    //Frame run next.
+    uint32_t frame_ = 0;
+    //If set then tick() runs the frames instead of a timer. Start time of the next frame.
+    bool framesPolled_ = false;
+    uint32_t nextFrame_us_ = 0;
+    uint32_t frameBudgetPeak_us_ = 0;
+    volatile uint32_t frameOverruns_ = 0;
+    //Time used by frames per priority. Written from the frame timer interrupt and collected by tick().
+    volatile uint32_t frameBusyTime_us_[eTaskPriority_t::eTaskPriority_NumPriorities] = {0};
+    //Replaces the default frame timer if not nullptr.
+    void (*frameTimerFunction_)(uint32_t frameLength_us) = nullptr;
+
+    //Sleep if nothing is to be done.
+    bool idleSleep_ = false;
+    //Replaces default way of sleeping if not nullptr.
+    void (*idleFunction_)(uint32_t until_us) = nullptr;
+    //Set from interrupts to skip the deadline check once.
+    volatile bool wakeupPending_ = false;
+
+    //Bit per task table slot that is set by notifications.
+    volatile uint32_t pendingEvents_[(SIMPLE_SCHEDULE_MAX_TASKS + 31)/32] = {0};
+    //Time of the first notification since the task last ran. Used as release time.
+    volatile uint32_t eventTimestamps_us_[SIMPLE_SCHEDULE_MAX_TASKS] = {0};
+
+    //Idle and wakeup measurements since the last tickrate calculation.
+    uint32_t idleTime_us_ = 0;
+    uint32_t wakeupLatencySum_us_ = 0;
+    uint32_t wakeupLatencyCounter_ = 0;
+    uint32_t wakeupLatencyPeak_us_ = 0;
+    //Results of last tickrate calculation.
+    float idleRatio_ = 0;
+    uint32_t wakeupLatencyMean_us_ = 0;
+    uint32_t wakeupLatencyMax_us_ = 0;
 
     //Incremented every tick
     uint32_t tickCounter_ = 0;
     //Stores loopRate
     uint32_t tickRate_ = 0;
     //Used to reset loopcounter and save Looprate
-    IntervalControl tickCounterResetInterval_ = IntervalControl(1);
+    RateControl tickCounterResetInterval_ = RateControl(1);
 
 
 };
@@ -4,12 +4,20 @@
 
 
 #include "simple_scheduler.h"
+#include "task_coroutine.h"
 
 
 
-namespace {
+/**
+ * Returns the scheduler all Task_Abstract instances are attached to.
+ * It is created on first use, so tasks constructed as globals in any
+ * file are all placed on the same scheduler.
+ */
+inline Scheduler& getGlobalScheduler() {
 
-    Scheduler g_scheduler;
+    static Scheduler scheduler;
+
+    return scheduler;
 
 }
 
@@ -21,7 +29,7 @@ public:
     /**
      * Sets up the task and attaches it to the internal scheduler.
      * 
-     * @param rate is the rate at which to run the Task
+     * @param rate is the rate at which to run the Task. 0 to only run when notified. See notifyFromISR().
      * @param priority is of type eTaskPriority_t and gives the priority of the task
      * @param startRunning will auto start threading if set to true. Default is true.
      * @param runs sets the number of times to run the thread function. Set to -1 for infinite. Default is -1.
@@ -36,19 +44,25 @@ public:
      * Will remove Task from scheduler.
      */
     ~Task_Abstract() {
-        g_scheduler.detachTask(this);
+        getGlobalScheduler().detachTask(this);
     }
 
     /**
      * Starts the threading for the task.
      * 
      * @param numberRuns sets the number of times to run the thread function. Set to -1 for infinite. Default is -1.
-     * @returns true if added or false if rate is set to 0 or scheduler failed to add task.
+     * @returns true if added or false if scheduler failed to add task.
      */
     bool startTaskThreading(const int32_t &numberRuns = -1) {
-        if (rate_ == 0) return false;
         if (attached_) return true; //Keep from attaching itsself multiple times
-        return g_scheduler.attachTask(this, rate_, priority_, numberRuns);
+        if (rate_ == 0) attached_ = getGlobalScheduler().attachEventTask(this, priority_, eventTimeout_us_, numberRuns);
+        else attached_ = getGlobalScheduler().attachTask(this, rate_, priority_, numberRuns);
+        taskHandle_ = attached_ ? getGlobalScheduler().getTaskHandle(this) : -1;
+        if (attached_) getGlobalScheduler().setTaskShedding(this, shedding_);
+        if (attached_ && phase_us_ >= 0) getGlobalScheduler().setTaskPhase(this, phase_us_);
+        if (attached_) getGlobalScheduler().setTaskCatchUp(this, catchUp_, burstLimit_);
+        if (attached_ && budget_us_ > 0) getGlobalScheduler().setTaskBudget(this, budget_us_);
+        return attached_;
     }
 
     /**
@@ -56,7 +70,106 @@ public:
      */
     void stopTaskThreading() {
         if (!attached_) return; //Dont need to remove itsself if not attached
-        g_scheduler.detachTask(this);
+        taskHandle_ = -1;
+        getGlobalScheduler().detachTask(this);
+        attached_ = false;
+    }
+
+    /**
+     * Makes the task run on the next scheduler tick. Meant for tasks with a rate of 0
+     * that only run when something happened, e.g. a sensor interrupt.
+     * Safe to call from interrupts.
+     */
+    void notifyFromISR() {
+        int32_t handle = taskHandle_;
+        if (handle >= 0) getGlobalScheduler().notifyFromISR(handle);
+    }
+
+    /**
+     * Makes the next run of this task happen at the given time instead of its normal deadline.
+     * Used by the TASK_CO_ macros to continue a coroutine.
+     * 
+     * @param time_us is the timestamp in microseconds of the next run.
+     */
+    void setTaskNextRun(const uint32_t &time_us) {
+        if (attached_) getGlobalScheduler().setTaskNextRun(this, time_us);
+    }
+
+    /**
+     * Makes this task run directly after the given task whenever it calls releaseDependentTasks().
+     * Used to chain e.g. sensor, navigation and control into a pipeline that runs in one scheduler pass.
+     * Both tasks must be threading. See Scheduler::addTaskDependency().
+     *
+     * @param upstream is the task whose data this task uses.
+     * @returns false if the dependency could not be added.
+     */
+    bool addTaskUpstream(Thread_Interface* upstream) {
+        if (!attached_) return false;
+        return getGlobalScheduler().addTaskDependency(upstream, this);
+    }
+
+    /**
+     * Tells the scheduler that this task produced new data. Tasks that added this one
+     * as upstream are run once the current run returns. Should be called from thread().
+     */
+    void releaseDependentTasks() {
+        int32_t handle = taskHandle_;
+        if (handle >= 0) getGlobalScheduler().releaseDependents(handle);
+    }
+
+    /**
+     * Sets after how long without notification a task with rate 0 is run anyways.
+     * Must be set before threading is started.
+     * 
+     * @param timeout_us is the timeout in microseconds. 0 for no timeout.
+     */
+    void setTaskEventTimeout(const uint32_t &timeout_us) {eventTimeout_us_ = timeout_us;}
+
+    /**
+     * Sets what happens to this task while the scheduler is overloaded. Default is eTaskShedding_Never.
+     * Should be used for everything not needed to fly, e.g. telemetry or displays.
+     * 
+     * @param shedding is of type eTaskShedding_t.
+     */
+    void setTaskShedding(const eTaskShedding_t &shedding) {
+        shedding_ = shedding;
+        if (attached_) getGlobalScheduler().setTaskShedding(this, shedding);
+    }
+
+    /**
+     * Sets when within its interval the task runs, e.g. a 1kHz task with a phase of 500
+     * runs half way between full milliseconds. By default the scheduler chooses the phase
+     * so tasks with the same rate are spread over the interval. See Scheduler::setTaskPhase().
+     * 
+     * @param phase_us is the phase in microseconds.
+     */
+    void setTaskPhase(const uint32_t &phase_us) {
+        phase_us_ = phase_us;
+        if (attached_) getGlobalScheduler().setTaskPhase(this, phase_us);
+    }
+
+    /**
+     * Sets what happens to runs that were missed because the task could not start in time.
+     * Default is eRateCatchUp_Skip. See RateControl.
+     * 
+     * @param catchUp is of type eRateCatchUp_t.
+     * @param burstLimit is the number of missed runs to make up with eRateCatchUp_Burst.
+     */
+    void setTaskCatchUp(const eRateCatchUp_t &catchUp, const uint32_t &burstLimit = 4) {
+        catchUp_ = catchUp;
+        burstLimit_ = burstLimit;
+        if (attached_) getGlobalScheduler().setTaskCatchUp(this, catchUp, burstLimit);
+    }
+
+    /**
+     * Sets the worst case execution time of this task. Only tasks with a budget are run from the frames
+     * of the cyclic executive, which uses it to spread them. See Scheduler::setTaskBudget().
+     * 
+     * @param budget_us is the execution time in microseconds. 0 to keep the task out of the frames.
+     */
+    void setTaskBudget(const uint32_t &budget_us) {
+        budget_us_ = budget_us;
+        if (attached_) getGlobalScheduler().setTaskBudget(this, budget_us);
     }
 
     /**
@@ -91,6 +204,27 @@ public:
         return rate_;
     }
 
+    /**
+     * Sets the name used in the task statistics.
+     * String is not copied and must stay valid.
+     * 
+     * @param name is the name of the task.
+     */
+    void setTaskName(const char* name) {name_ = name;}
+
+    /**
+     * @returns name of the task.
+     */
+    const char* getThreadName() {return name_;}
+
+    /**
+     * Gets the execution time, jitter and missed deadline statistics of this task.
+     * 
+     * @param statistics Struct to be written into.
+     * @returns false if task is not attached.
+     */
+    bool getTaskStatistics(TaskStatistics* statistics) {return getGlobalScheduler().getTaskStatistics(this, statistics);}
+
     /**
      * Calling this will pause the thread until the given time was reached.
      * e.g. waitUntil(micros() + 1000) will delay the program for 1000 microseconds.
@@ -103,26 +237,102 @@ public:
      * @param timeInMicrosecond Time in microseconds at which the thread should continue
      */
     /*void suspendUntil(uint32_t timeInMicrosecond) {
-        g_scheduler.suspendUntil(timeInMicrosecond);
+        getGlobalScheduler().suspendUntil(timeInMicrosecond);
     }*/
 
     /**
      * Static function to give internal scheduler time to run tasks.
      * This needs to be ran as often and fast as possible to give all tasks time.
      */
-    static void schedulerTick() {g_scheduler.tick();}
+    static void schedulerTick() {getGlobalScheduler().tick();}
 
     /**
      * Static function that talls scheduler to initialize all attached tasks.
      */
-    static void schedulerInitTasks() {g_scheduler.initializeTasks();}
+    static void schedulerInitTasks() {getGlobalScheduler().initializeTasks();}
 
     /**
      * Used to get how often per second tick() from the scheduler is called. Can be used to see how the systems performance is.
      * 
      * @returns tick rate.
      */
-    static uint32_t getSchedulerTickRate() {return g_scheduler.getTickRate();}
+    static uint32_t getSchedulerTickRate() {return getGlobalScheduler().getTickRate();}
+
+    /**
+     * Used to get how much of the CPU time all tasks of a priority used in the last second.
+     * 
+     * @param priority Priority to get load from.
+     * @returns load from 0 to 1.
+     */
+    static float getSchedulerPriorityLoad(const eTaskPriority_t &priority) {return getGlobalScheduler().getPriorityLoad(priority);}
+
+    /**
+     * If enabled then schedulerTick() will sleep until the next task is due.
+     * 
+     * @param enable true to sleep when nothing is to be done.
+     */
+    static void setSchedulerIdleSleep(const bool &enable) {getGlobalScheduler().setIdleSleep(enable);}
+
+    /**
+     * Used to get how much of the last second the internal scheduler was sleeping.
+     * 
+     * @returns idle time from 0 to 1.
+     */
+    static float getSchedulerIdleRatio() {return getGlobalScheduler().getIdleRatio();}
+
+    /**
+     * Sets how the internal scheduler decides which task to run.
+     * 
+     * @param policy is the policy to use.
+     */
+    static void setSchedulerPolicy(const eSchedulePolicy_t &policy) {getGlobalScheduler().setSchedulePolicy(policy);}
+
+    /**
+     * If enabled then the internal scheduler spreads tasks over their interval when they are attached. Default is disabled.
+     * Costly with many tasks, so only meant for setup. See Scheduler::setAutoPhase().
+     * 
+     * @param enable true to choose phases automatically.
+     */
+    static void setSchedulerAutoPhase(const bool &enable) {getGlobalScheduler().setAutoPhase(enable);}
+
+    /**
+     * Sets which tasks the cyclic executive of the internal scheduler runs from frames. See Scheduler::setCyclicPriority().
+     * 
+     * @param priority is the lowest priority to place into frames.
+     */
+    static void setSchedulerCyclicPriority(const eTaskPriority_t &priority) {getGlobalScheduler().setCyclicPriority(priority);}
+
+    /**
+     * @returns how often a frame of the cyclic executive of the internal scheduler took too long.
+     */
+    static uint32_t getSchedulerFrameOverruns() {return getGlobalScheduler().getFrameOverruns();}
+
+    /**
+     * Returns true while the internal scheduler is overloaded and tasks are shed.
+     * Tasks can check this to skip work that is not needed.
+     * 
+     * @returns true if overloaded.
+     */
+    static bool isSchedulerOverloaded() {return getGlobalScheduler().isOverloaded();}
+
+    /**
+     * Sets when the internal scheduler counts as overloaded and how much tasks are shed.
+     * 
+     * @param policy is the policy to use.
+     */
+    static void setSchedulerOverloadPolicy(const OverloadPolicy &policy) {getGlobalScheduler().setOverloadPolicy(policy);}
+
+#if defined(SIMPLE_SCHEDULE_TRACE) && defined(ARDUINO)
+    /**
+     * Writes the trace of the internal scheduler, e.g. to Serial. See task_trace.h.
+     * 
+     * @param output is where to write to.
+     */
+    static void dumpSchedulerTrace(Print &output) {
+        getGlobalScheduler().updateTraceNames();
+        taskTrace.dump(output);
+    }
+#endif
 
     /**
      * Defined now but can be overridden. This way is does not need to be defined by user.
@@ -140,6 +350,21 @@ private:
     uint32_t rate_ = 0;
     eTaskPriority_t priority_ = eTaskPriority_t::eTaskPriority_None;
     bool attached_ = false;
+    const char* name_ = "";
+
+    uint32_t eventTimeout_us_ = 0;
+    volatile int32_t taskHandle_ = -1;
+
+    eTaskShedding_t shedding_ = eTaskShedding_t::eTaskShedding_Never;
+
+    //Phase set by user. -1 if chosen by scheduler.
+    int32_t phase_us_ = -1;
+
+    eRateCatchUp_t catchUp_ = eRateCatchUp_t::eRateCatchUp_Skip;
+    uint32_t burstLimit_ = 4;
+
+    //Worst case execution time set by user. 0 if unknown.
+    uint32_t budget_us_ = 0;
 
 };
 
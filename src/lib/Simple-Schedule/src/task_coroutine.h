@@ -0,0 +1,100 @@
+#ifndef TASK_COROUTINE_H
+#define TASK_COROUTINE_H
+
+
+/**
+ * Stackless coroutines for Task_Abstract tasks, similar to protothreads.
+ * A function using these macros returns at every wait and continues after it on the next call,
+ * so long sequences like device startups can be written top to bottom without blocking other tasks.
+ * No stack is needed, only the TaskCoroutine struct which stores where to continue.
+ *
+ * Rules:
+ * - The function must return void and be a member of a class inheriting from Task_Abstract.
+ * - Local variables are lost at every wait. Use member variables instead.
+ * - Only one wait per line and no switch statements between TASK_CO_BEGIN and TASK_CO_END.
+ *
+ * e.g:
+ *
+ * void Driver::init() {
+ *      TASK_CO_BEGIN(initCoroutine_);
+ *      digitalWrite(resetPin_, LOW);
+ *      TASK_CO_DELAY_US(initCoroutine_, 2000);
+ *      digitalWrite(resetPin_, HIGH);
+ *      TASK_CO_WAIT_UNTIL(initCoroutine_, !digitalRead(busyPin_));
+ *      TASK_CO_END(initCoroutine_);
+ * }
+*/
+
+
+
+#include "stdint.h"
+
+
+
+//Value of TaskCoroutine::line once finished.
+#define TASK_COROUTINE_FINISHED 0xFFFF
+
+
+
+/**
+ * Stores where a coroutine continues.
+ */
+struct TaskCoroutine {
+
+    //Line of the wait the coroutine stopped at. 0 if not started.
+    uint16_t line = 0;
+
+    //Start of current delay.
+    uint32_t waitStart_us = 0;
+
+    /**
+     * Makes the coroutine start from the beginning on its next call.
+     */
+    void reset() {line = 0;}
+
+    /**
+     * @returns true if the coroutine was started and has not finished.
+     */
+    bool isRunning() const {return line != 0 && line != TASK_COROUTINE_FINISHED;}
+
+    /**
+     * @returns true if TASK_CO_END was reached.
+     */
+    bool isFinished() const {return line == TASK_COROUTINE_FINISHED;}
+
+};
+
+
+
+/**
+ * Must be at the start of the coroutine. Returns immediately if the coroutine has finished.
+ */
+#define TASK_CO_BEGIN(co) if ((co).isFinished()) return; switch ((co).line) { case 0:
+
+/**
+ * Must be at the end of the coroutine. Marks it as finished.
+ */
+#define TASK_CO_END(co) } (co).line = TASK_COROUTINE_FINISHED; return
+
+/**
+ * Returns and continues after this on the next scheduler tick.
+ */
+#define TASK_CO_YIELD(co) do { (co).line = __LINE__; setTaskNextRun(micros()); return; case __LINE__:; } while (0)
+
+/**
+ * Returns and continues once the given time in microseconds has passed.
+ * The scheduler runs the task at that time, so nothing is polled in between.
+ */
+#define TASK_CO_DELAY_US(co, time_us) do { (co).waitStart_us = micros(); (co).line = __LINE__; setTaskNextRun((co).waitStart_us + (uint32_t)(time_us)); return; \
+    case __LINE__: if (micros() - (co).waitStart_us < (uint32_t)(time_us)) {setTaskNextRun((co).waitStart_us + (uint32_t)(time_us)); return;} } while (0)
+
+/**
+ * Returns and continues once the condition is true. The condition is checked every time the
+ * task runs, so either the task rate or notifications (e.g. from a pin interrupt or a
+ * finished bus transaction) decide how fast the wait reacts.
+ */
+#define TASK_CO_WAIT_UNTIL(co, condition) do { (co).line = __LINE__; case __LINE__: if (!(condition)) return; } while (0)
+
+
+
+#endif
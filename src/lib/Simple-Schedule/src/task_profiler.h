@@ -0,0 +1,279 @@
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+
+/**
+ * Classes used by the scheduler to record how long tasks take to run and how late
+ * they are started. All memory is fixed size, nothing is allocated at runtime.
+*/
+
+
+
+#include "stdint.h"
+
+
+
+//Number of buckets per histogram. 48 buckets cover 0 to 8.2ms with 4 buckets per power of 2. Larger values are placed into the last one.
+#define TIME_HISTOGRAM_BUCKETS 48
+
+
+
+/**
+ * Histogram for time measurements in microseconds.
+ * Values below 8us get their own bucket. Above that every power of 2 is split
+ * into 4 buckets, so the error of a percentile is below 25%.
+ * Values that are too large are placed into the last bucket.
+ */
+class TimeHistogram {
+public:
+
+    TimeHistogram() {
+        clear();
+    }
+
+    /**
+     * Adds a measurement to the histogram.
+     * If a bucket would overflow, all buckets are halved. This keeps the distribution
+     * and lets older measurements slowly fade out.
+     *
+     * @param value_us measurement in microseconds.
+     */
+    void addValue(const uint32_t &value_us) {
+
+        uint32_t bucket = getBucket(value_us);
+
+        if (buckets_[bucket] == UINT16_MAX) {
+            for (uint32_t i = 0; i < TIME_HISTOGRAM_BUCKETS; i++) buckets_[i] /= 2;
+            numValues_ = 0;
+            for (uint32_t i = 0; i < TIME_HISTOGRAM_BUCKETS; i++) numValues_ += buckets_[i];
+        }
+
+        buckets_[bucket]++;
+        numValues_++;
+
+    }
+
+    /**
+     * Returns the upper limit of the bucket containing the given percentile.
+     *
+     * @param percent between 0 and 100.
+     * @returns value in microseconds. 0 if histogram is empty.
+     */
+    uint32_t getPercentile(const float &percent) const {
+
+        if (numValues_ == 0) return 0;
+
+        uint32_t target = (float)numValues_*percent/100.0f;
+        if (target >= numValues_) target = numValues_ - 1;
+
+        uint32_t counter = 0;
+        for (uint32_t i = 0; i < TIME_HISTOGRAM_BUCKETS; i++) {
+            counter += buckets_[i];
+            if (counter > target) return getBucketLimit(i);
+        }
+
+        return getBucketLimit(TIME_HISTOGRAM_BUCKETS - 1);
+
+    }
+
+    /**
+     * @returns number of measurements in histogram.
+     */
+    uint32_t getNumberValues() const {return numValues_;}
+
+    /**
+     * @returns number of measurements in given bucket.
+     */
+    uint16_t getBucketCount(const uint32_t &bucket) const {return bucket < TIME_HISTOGRAM_BUCKETS ? buckets_[bucket] : 0;}
+
+    /**
+     * Removes all measurements.
+     */
+    void clear() {
+        for (uint32_t i = 0; i < TIME_HISTOGRAM_BUCKETS; i++) buckets_[i] = 0;
+        numValues_ = 0;
+    }
+
+    /**
+     * @returns the bucket index a value would be placed into.
+     */
+    static uint32_t getBucket(const uint32_t &value_us) {
+
+        if (value_us < 8) return value_us;
+
+        uint32_t msb = 31 - __builtin_clz(value_us);
+        uint32_t bucket = 8 + (msb - 3)*4 + ((value_us >> (msb - 2)) & 3);
+
+        return bucket < TIME_HISTOGRAM_BUCKETS ? bucket : TIME_HISTOGRAM_BUCKETS - 1;
+
+    }
+
+    /**
+     * @returns the largest value that is placed into the given bucket.
+     */
+    static uint32_t getBucketLimit(const uint32_t &bucket) {
+
+        if (bucket < 8) return bucket;
+        if (bucket >= TIME_HISTOGRAM_BUCKETS - 1) return UINT32_MAX;
+
+        uint32_t msb = (bucket - 8)/4 + 3;
+        uint32_t sub = (bucket - 8)%4;
+
+        return ((5 + sub) << (msb - 2)) - 1;
+
+    }
+
+
+private:
+
+    uint16_t buckets_[TIME_HISTOGRAM_BUCKETS];
+
+    uint32_t numValues_ = 0;
+
+};
+
+
+
+/**
+ * Statistics of a single task. Filled by the scheduler on request.
+ */
+struct TaskStatistics {
+
+    //Name given to the task. Empty if none.
+    char name[16];
+
+    //Priority as eTaskPriority_t value.
+    uint8_t priority = 0;
+    //Rate the task was attached with in Hz.
+    uint32_t rate_Hz = 0;
+
+    //Number of thread() calls that were measured.
+    uint32_t runs = 0;
+
+    //Time thread() takes to run in microseconds.
+    uint32_t executionTimeMin_us = 0;
+    uint32_t executionTimeMean_us = 0;
+    uint32_t executionTimeMax_us = 0;
+    uint32_t executionTimeP99_us = 0;
+
+    //How late thread() was started compared to when it was due in microseconds.
+    uint32_t startJitterMean_us = 0;
+    uint32_t startJitterMax_us = 0;
+    uint32_t startJitterP99_us = 0;
+
+    //Number of runs that finished after the next run was already due.
+    uint32_t deadlinesMissed = 0;
+
+    //Part of the CPU time this task used in the last second. From 0 to 1.
+    float cpuShare = 0;
+
+};
+
+
+
+/**
+ * Measurements the scheduler keeps for every task.
+ */
+class TaskProfiler {
+public:
+
+    /**
+     * Adds the measurement of one thread() call.
+     *
+     * @param startJitter_us how late the run was started.
+     * @param executionTime_us how long the run took.
+     * @param interval_us interval of the task. Run misses its deadline if it finishes later than this after being due.
+     */
+    void addRun(const uint32_t &startJitter_us, const uint32_t &executionTime_us, const uint32_t &interval_us) {
+
+        if (runs_ == 0 || executionTime_us < executionTimeMin_us_) executionTimeMin_us_ = executionTime_us;
+        if (executionTime_us > executionTimeMax_us_) executionTimeMax_us_ = executionTime_us;
+        if (startJitter_us > startJitterMax_us_) startJitterMax_us_ = startJitter_us;
+
+        executionTimeSum_us_ += executionTime_us;
+        startJitterSum_us_ += startJitter_us;
+        busyTime_us_ += executionTime_us;
+        runs_++;
+
+        if (interval_us > 0 && startJitter_us + executionTime_us > interval_us) deadlinesMissed_++;
+
+        executionTimeHistogram_.addValue(executionTime_us);
+        startJitterHistogram_.addValue(startJitter_us);
+
+    }
+
+    /**
+     * Calculates the cpu share from the time used since the last call.
+     * Called by the scheduler once per second.
+     *
+     * @param window_us time since last call.
+     */
+    void updateCPUShare(const uint32_t &window_us) {
+        if (window_us > 0) cpuShare_ = (float)busyTime_us_/window_us;
+        busyTime_us_ = 0;
+    }
+
+    /**
+     * Fills the measured parts of the statistics struct.
+     */
+    void getStatistics(TaskStatistics* statistics) const {
+
+        statistics->runs = runs_;
+        statistics->executionTimeMin_us = executionTimeMin_us_;
+        statistics->executionTimeMax_us = executionTimeMax_us_;
+        statistics->executionTimeMean_us = runs_ == 0 ? 0 : executionTimeSum_us_/runs_;
+        statistics->startJitterMax_us = startJitterMax_us_;
+        statistics->startJitterMean_us = runs_ == 0 ? 0 : startJitterSum_us_/runs_;
+
+        //Histogram only gives the bucket limit, which can be above the largest measured value.
+        uint32_t executionTimeP99 = executionTimeHistogram_.getPercentile(99);
+        uint32_t startJitterP99 = startJitterHistogram_.getPercentile(99);
+        statistics->executionTimeP99_us = executionTimeP99 < executionTimeMax_us_ ? executionTimeP99 : executionTimeMax_us_;
+        statistics->startJitterP99_us = startJitterP99 < startJitterMax_us_ ? startJitterP99 : startJitterMax_us_;
+        statistics->deadlinesMissed = deadlinesMissed_;
+        statistics->cpuShare = cpuShare_;
+
+    }
+
+    /**
+     * @returns histogram of thread() execution times.
+     */
+    const TimeHistogram& getExecutionTimeHistogram() const {return executionTimeHistogram_;}
+
+    /**
+     * @returns histogram of start jitter.
+     */
+    const TimeHistogram& getStartJitterHistogram() const {return startJitterHistogram_;}
+
+    /**
+     * Removes all measurements.
+     */
+    void clear() {
+        *this = TaskProfiler();
+    }
+
+
+private:
+
+    TimeHistogram executionTimeHistogram_;
+    TimeHistogram startJitterHistogram_;
+
+    uint32_t runs_ = 0;
+
+    uint32_t executionTimeMin_us_ = 0;
+    uint32_t executionTimeMax_us_ = 0;
+    uint64_t executionTimeSum_us_ = 0;
+
+    uint32_t startJitterMax_us_ = 0;
+    uint64_t startJitterSum_us_ = 0;
+
+    uint32_t deadlinesMissed_ = 0;
+
+    uint32_t busyTime_us_ = 0;
+    float cpuShare_ = 0;
+
+};
+
+
+
+#endif
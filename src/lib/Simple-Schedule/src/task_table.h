@@ -0,0 +1,147 @@
+#ifndef TASK_TABLE_H
+#define TASK_TABLE_H
+
+
+/**
+ * This class implements a fixed size table of items placed one after another in a single array.
+ * Items never move once added, so pointers to them stay valid until they are removed.
+ * Removed slots are reused by the next added item. No memory is allocated at runtime.
+ *
+ * Iterate with:
+ * for (uint32_t i = 0; i < table.getEndIndex(); i++) if (table.isUsed(i)) table[i]...
+*/
+
+
+
+#include "stdint.h"
+
+
+
+template<typename T, uint32_t capacity_>
+class TaskTable {
+public:
+
+    TaskTable() {
+        for (uint32_t i = 0; i < capacity_; i++) used_[i] = false;
+    }
+
+    /**
+     * @returns number of items in table.
+     */
+    uint32_t length() const {return numItems_;}
+
+    /**
+     * @returns maximum number of items.
+     */
+    uint32_t capacity() const {return capacity_;}
+
+    /**
+     * @returns true if no more items can be added.
+     */
+    bool isFull() const {return numItems_ == capacity_;}
+
+    /**
+     * All used slots are below this index.
+     *
+     * @returns index after the last used slot.
+     */
+    uint32_t getEndIndex() const {return endIndex_;}
+
+    /**
+     * @returns true if the slot at index contains an item.
+     */
+    bool isUsed(const uint32_t &index) const {return index < endIndex_ && used_[index];}
+
+    /**
+     * Does not check if the slot is used.
+     *
+     * @returns reference to the item at index.
+     */
+    T& operator[](const uint32_t &index) {return items_[index];}
+
+    /**
+     * Returns the slot index of an item in the table.
+     *
+     * @param item Pointer to an item in the table.
+     * @returns index or -1 if the item is not part of the table.
+     */
+    int32_t getIndex(const T* item) const {
+
+        if (item < items_ || item >= items_ + endIndex_) return -1;
+
+        uint32_t index = item - items_;
+
+        return used_[index] ? index : -1;
+
+    }
+
+    /**
+     * Copies an item into the first free slot.
+     *
+     * @param item Item to copy into the table.
+     * @returns pointer to the placed item. nullptr if full.
+     */
+    T* addItem(const T &item) {
+
+        if (numItems_ == capacity_) return nullptr;
+
+        uint32_t index = 0;
+        while (used_[index]) index++;
+
+        items_[index] = item;
+        used_[index] = true;
+        numItems_++;
+
+        if (index >= endIndex_) endIndex_ = index + 1;
+
+        return &items_[index];
+
+    }
+
+    /**
+     * Frees the slot of the given item.
+     *
+     * @param item Pointer to an item in the table.
+     * @returns false if item is not part of the table.
+     */
+    bool removeItem(const T* item) {
+
+        int32_t index = getIndex(item);
+        if (index < 0) return false;
+
+        used_[index] = false;
+        numItems_--;
+
+        //Keep iteration short if the last items were removed.
+        while (endIndex_ > 0 && !used_[endIndex_ - 1]) endIndex_--;
+
+        return true;
+
+    }
+
+    /**
+     * Removes all items.
+     */
+    void clear() {
+        for (uint32_t i = 0; i < capacity_; i++) used_[i] = false;
+        numItems_ = 0;
+        endIndex_ = 0;
+    }
+
+
+private:
+
+    T items_[capacity_];
+
+    bool used_[capacity_];
+
+    uint32_t numItems_ = 0;
+
+    uint32_t endIndex_ = 0;
+
+
+};
+
+
+
+#endif
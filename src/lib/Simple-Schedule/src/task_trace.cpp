@@ -0,0 +1,123 @@
+#include "task_trace.h"
+
+#include "string.h"
+
+
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+TaskTrace taskTrace;
+#endif
+
+
+
+uint8_t TaskTrace::registerName(const char* name) {
+
+    uint8_t id = __atomic_fetch_add(&numberNames_, 1, __ATOMIC_RELAXED);
+
+    if (id >= SIMPLE_SCHEDULE_TRACE_MAX_NAMES) {
+        numberNames_ = SIMPLE_SCHEDULE_TRACE_MAX_NAMES;
+        return 0xFF;
+    }
+
+    names_[id] = name;
+
+    return id;
+
+}
+
+
+uint32_t TaskTrace::beginRead() {
+
+    paused_ = true;
+
+    readHead_ = head_;
+    readEvents_ = readHead_ < SIMPLE_SCHEDULE_TRACE_LENGTH ? readHead_ : SIMPLE_SCHEDULE_TRACE_LENGTH;
+    readPosition_ = 0;
+
+    readTaskNames_ = 0;
+    for (uint32_t i = 0; i < SIMPLE_SCHEDULE_MAX_TASKS; i++) if (taskNames_[i] != nullptr) readNameIds_[readTaskNames_++] = i;
+    readNames_ = readTaskNames_;
+    for (uint32_t i = 0; i < numberNames_ && i < SIMPLE_SCHEDULE_TRACE_MAX_NAMES; i++) readNameIds_[readNames_++] = i;
+
+    readSize_ = TASK_TRACE_HEADER_SIZE + readEvents_*sizeof(TraceEvent) + readNames_*TASK_TRACE_NAME_ENTRY_SIZE;
+
+    uint32_t header[] = {TASK_TRACE_TICKS_PER_SECOND(), readEvents_, readNames_, readHead_ - readEvents_};
+    memcpy(readHeader_, "SSTR", 4);
+    readHeader_[4] = TASK_TRACE_VERSION;
+    readHeader_[5] = 0;
+    readHeader_[6] = sizeof(TraceEvent);
+    readHeader_[7] = 0;
+    memcpy(readHeader_ + 8, header, sizeof(header));
+
+    return readSize_;
+
+}
+
+
+uint32_t TaskTrace::read(uint8_t* buffer, const uint32_t &length) {
+
+    uint32_t number = 0;
+    while (number < length && readPosition_ < readSize_) buffer[number++] = getByte(readPosition_++);
+
+    return number;
+
+}
+
+
+void TaskTrace::endRead() {
+
+    head_ = 0;
+    paused_ = false;
+
+}
+
+
+#if defined(ARDUINO)
+void TaskTrace::dump(Print &output) {
+
+    beginRead();
+
+    uint8_t buffer[64];
+    uint32_t length;
+    while ((length = read(buffer, sizeof(buffer))) > 0) output.write(buffer, length);
+
+    endRead();
+
+}
+#endif
+
+
+uint8_t TaskTrace::getByte(const uint32_t &position) {
+
+    if (position < TASK_TRACE_HEADER_SIZE) return readHeader_[position];
+
+    uint32_t eventBytes = readEvents_*sizeof(TraceEvent);
+    uint32_t offset = position - TASK_TRACE_HEADER_SIZE;
+
+    if (offset < eventBytes) {
+        //Oldest event is the one after the newest.
+        uint32_t index = (readHead_ - readEvents_ + offset/sizeof(TraceEvent)) & (SIMPLE_SCHEDULE_TRACE_LENGTH - 1);
+        return ((uint8_t*)&events_[index])[offset%sizeof(TraceEvent)];
+    }
+
+    offset -= eventBytes;
+    uint32_t entry = offset/TASK_TRACE_NAME_ENTRY_SIZE;
+    offset %= TASK_TRACE_NAME_ENTRY_SIZE;
+
+    bool isTask = entry < readTaskNames_;
+    uint8_t id = readNameIds_[entry];
+
+    if (offset == 0) return isTask ? eTraceName_t::eTraceName_Task : eTraceName_t::eTraceName_Registered;
+    if (offset == 1) return 0;
+    if (offset == 2) return id;
+    if (offset == 3) return 0;
+
+    //Name is padded with zeros and always ends with one.
+    const char* name = isTask ? taskNames_[id] : names_[id];
+    uint32_t character = offset - 4;
+    if (offset == TASK_TRACE_NAME_ENTRY_SIZE - 1 || name == nullptr) return 0;
+    for (uint32_t i = 0; i < character; i++) if (name[i] == '\0') return 0;
+
+    return name[character];
+
+}
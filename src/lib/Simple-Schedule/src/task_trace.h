@@ -0,0 +1,252 @@
+#ifndef TASK_TRACE_H
+#define TASK_TRACE_H
+
+
+/**
+ * Records what the CPU did into a ring buffer in RAM: task runs, interrupts, idle time and markers.
+ * Every event takes a few cycles to record and is safe from interrupts, so the recording barely changes
+ * the timing it shows. Once full the oldest events are overwritten, so it always holds the latest events.
+ *
+ * Only compiled in if SIMPLE_SCHEDULE_TRACE is defined (e.g. with a build flag). The scheduler then records
+ * task runs, notifications and idle time on its own. Interrupts and markers are added with the TASK_TRACE_ macros.
+ * The trace is read with Task_Abstract::dumpSchedulerTrace() and converted with tools/trace_to_chrome.cpp.
+ *
+ * e.g:
+ *
+ * static uint8_t traceId = TASK_TRACE_REGISTER("Pin interrupt");
+ *
+ * void interrupt() {
+ *      TASK_TRACE_ISR_BEGIN(traceId);
+ *      ...
+ *      TASK_TRACE_ISR_END(traceId);
+ * }
+ *
+ * Binary format, all little endian:
+ * - Header of TASK_TRACE_HEADER_SIZE bytes: "SSTR", version, event size, ticks per second, number events, number names, dropped events.
+ * - Events of sizeof(TraceEvent) bytes, oldest first.
+ * - Names of TASK_TRACE_NAME_ENTRY_SIZE bytes: kind (eTraceName_t), reserved, id, name padded with zeros.
+*/
+
+
+
+#include "Arduino.h"
+
+
+
+//Number of events kept. Must be a power of 2. Every event uses 8 bytes. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_TRACE_LENGTH
+#define SIMPLE_SCHEDULE_TRACE_LENGTH 2048
+#endif
+
+//Number of names that can be registered for interrupts and markers. Can be overridden with a build flag.
+#ifndef SIMPLE_SCHEDULE_TRACE_MAX_NAMES
+#define SIMPLE_SCHEDULE_TRACE_MAX_NAMES 16
+#endif
+
+//Number of task slots names are kept for. Same as SIMPLE_SCHEDULE_MAX_TASKS.
+#ifndef SIMPLE_SCHEDULE_MAX_TASKS
+#define SIMPLE_SCHEDULE_MAX_TASKS 64
+#endif
+
+#define TASK_TRACE_VERSION 1
+#define TASK_TRACE_HEADER_SIZE 24
+#define TASK_TRACE_NAME_ENTRY_SIZE 32
+
+//Cycle counter on the Teensy 4, microseconds elsewhere.
+#if defined(__IMXRT1062__)
+#define TASK_TRACE_TIMESTAMP() ARM_DWT_CYCCNT
+#define TASK_TRACE_TICKS_PER_SECOND() F_CPU_ACTUAL
+#else
+#define TASK_TRACE_TIMESTAMP() micros()
+#define TASK_TRACE_TICKS_PER_SECOND() 1000000
+#endif
+
+
+
+enum eTraceEvent_t {
+    //Task with id as table slot started running.
+    eTraceEvent_TaskBegin,
+    eTraceEvent_TaskEnd,
+    //Interrupt with registered id started.
+    eTraceEvent_IsrBegin,
+    eTraceEvent_IsrEnd,
+    //Task with id as table slot was notified. Mostly from interrupts.
+    eTraceEvent_Notify,
+    //Something with registered id happened. Value is free to use.
+    eTraceEvent_Marker,
+    //Scheduler started and stopped sleeping.
+    eTraceEvent_IdleBegin,
+    eTraceEvent_IdleEnd
+};
+
+
+enum eTraceName_t {
+    //Id is a task table slot.
+    eTraceName_Task,
+    //Id was returned by registerName().
+    eTraceName_Registered
+};
+
+
+struct TraceEvent {
+
+    //Timestamp in ticks. Wraps.
+    uint32_t timestamp;
+    //eTraceEvent_t value.
+    uint8_t type;
+    uint8_t id;
+    uint16_t value;
+
+};
+
+
+
+class TaskTrace {
+public:
+
+    /**
+     * Constant so the trace is ready before any constructor of a global object runs, e.g. one that registers a name.
+     */
+    constexpr TaskTrace() {}
+
+    /**
+     * Adds an event. Safe to call from interrupts. Does nothing while disabled or read.
+     *
+     * @param type is of type eTraceEvent_t.
+     * @param id is the task slot or registered id.
+     * @param value is extra information for markers.
+     */
+    inline void record(const uint8_t &type, const uint8_t &id, const uint16_t &value = 0) {
+
+        if (paused_) return;
+
+        uint32_t timestamp = TASK_TRACE_TIMESTAMP();
+        uint32_t index = __atomic_fetch_add(&head_, 1, __ATOMIC_RELAXED) & (SIMPLE_SCHEDULE_TRACE_LENGTH - 1);
+
+        TraceEvent& event = events_[index];
+        event.timestamp = timestamp;
+        event.type = type;
+        event.id = id;
+        event.value = value;
+
+    }
+
+    /**
+     * Registers a name for interrupts and markers.
+     *
+     * @param name String that must stay valid.
+     * @returns id to record with. 0xFF if no more names can be registered.
+     */
+    uint8_t registerName(const char* name);
+
+    /**
+     * Sets the name of a task slot. Called by the scheduler.
+     *
+     * @param slot is the task table slot.
+     * @param name String that must stay valid.
+     */
+    void setTaskName(const uint32_t &slot, const char* name) {if (slot < SIMPLE_SCHEDULE_MAX_TASKS) taskNames_[slot] = name;}
+
+    /**
+     * Starts or stops recording. Default is enabled.
+     */
+    void setEnabled(const bool &enable) {paused_ = !enable;}
+
+    /**
+     * @returns true if recording.
+     */
+    bool isEnabled() {return !paused_;}
+
+    /**
+     * Removes all events.
+     */
+    void clear() {head_ = 0;}
+
+    /**
+     * Stops recording and prepares the events for read(). Call endRead() to continue recording.
+     *
+     * @returns size of the trace in bytes.
+     */
+    uint32_t beginRead();
+
+    /**
+     * Copies the next part of the trace. Can be used to send it in packets.
+     *
+     * @param buffer is written into.
+     * @param length is the size of the buffer.
+     * @returns number of bytes copied. 0 once everything was read.
+     */
+    uint32_t read(uint8_t* buffer, const uint32_t &length);
+
+    /**
+     * Removes the read events and continues recording.
+     */
+    void endRead();
+
+#if defined(ARDUINO)
+    /**
+     * Writes the whole trace, e.g. to Serial. Events that happen while writing are not recorded.
+     *
+     * @param output is where to write to.
+     */
+    void dump(Print &output);
+#endif
+
+
+private:
+
+    /**
+     * @returns the byte of the trace at the given position.
+     */
+    uint8_t getByte(const uint32_t &position);
+
+    TraceEvent events_[SIMPLE_SCHEDULE_TRACE_LENGTH] = {};
+    //Number of events recorded since cleared. The index of the next event is this modulo the length.
+    volatile uint32_t head_ = 0;
+    //Inverted so the whole trace is zero at start and takes no space in flash.
+    volatile bool paused_ = false;
+
+    const char* taskNames_[SIMPLE_SCHEDULE_MAX_TASKS] = {nullptr};
+    const char* names_[SIMPLE_SCHEDULE_TRACE_MAX_NAMES] = {nullptr};
+    volatile uint8_t numberNames_ = 0;
+
+    //Snapshot taken by beginRead().
+    uint8_t readHeader_[TASK_TRACE_HEADER_SIZE] = {0};
+    uint32_t readHead_ = 0;
+    uint32_t readEvents_ = 0;
+    uint32_t readNames_ = 0;
+    uint32_t readSize_ = 0;
+    uint32_t readPosition_ = 0;
+    //Table slots and registered ids of the names to read. Tasks come first.
+    uint8_t readNameIds_[SIMPLE_SCHEDULE_MAX_TASKS + SIMPLE_SCHEDULE_TRACE_MAX_NAMES] = {0};
+    uint32_t readTaskNames_ = 0;
+
+};
+
+
+
+#ifdef SIMPLE_SCHEDULE_TRACE
+
+//Trace all schedulers and interrupts record into.
+extern TaskTrace taskTrace;
+
+//Events store the table slot of a task in one byte.
+static_assert(SIMPLE_SCHEDULE_MAX_TASKS <= 256, "Trace needs SIMPLE_SCHEDULE_MAX_TASKS of at most 256");
+
+#define TASK_TRACE_REGISTER(name) taskTrace.registerName(name)
+#define TASK_TRACE_ISR_BEGIN(id) taskTrace.record(eTraceEvent_t::eTraceEvent_IsrBegin, id)
+#define TASK_TRACE_ISR_END(id) taskTrace.record(eTraceEvent_t::eTraceEvent_IsrEnd, id)
+#define TASK_TRACE_MARKER(id, value) taskTrace.record(eTraceEvent_t::eTraceEvent_Marker, id, value)
+
+#else
+
+#define TASK_TRACE_REGISTER(name) 0
+#define TASK_TRACE_ISR_BEGIN(id) do {} while (0)
+#define TASK_TRACE_ISR_END(id) do {} while (0)
+#define TASK_TRACE_MARKER(id, value) do {} while (0)
+
+#endif
+
+
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+
+/**
+ * This class implements a fixed size queue that sorts items by a deadline timestamp.
+ * It is a binary min-heap, so the item with the closest deadline can always be read in O(1)
+ * and adding or removing items is O(log n).
+ * No memory is allocated at runtime.
+ * Deadlines are compared with overflow in mind, so all deadlines in the queue
+ * must be within 2^31 of each other. (About 35 minutes if using microseconds)
+*/
+
+
+
+#include "stdint.h"
+
+
+
+template<typename T, uint32_t size_>
+class TimerQueue {
+public:
+
+    TimerQueue() {}
+
+    /**
+     * @returns number of items in queue.
+     */
+    uint32_t length() const {return numItems_;}
+
+    /**
+     * @returns true if there are no items in queue.
+     */
+    bool isEmpty() const {return numItems_ == 0;}
+
+    /**
+     * @returns true if no more items can be added.
+     */
+    bool isFull() const {return numItems_ == size_;}
+
+    /**
+     * Only valid if queue is not empty.
+     *
+     * @returns the closest deadline in queue.
+     */
+    uint32_t getNextDeadline() const {return entries_[0].deadline;}
+
+    /**
+     * @returns pointer to the item with the closest deadline. nullptr if empty.
+     */
+    T* getNextItem() const {return numItems_ == 0 ? nullptr : entries_[0].item;}
+
+    /**
+     * Adds an item to the queue.
+     *
+     * @param item Pointer to item to add.
+     * @param deadline Timestamp at which the item is due.
+     * @returns false if queue is full.
+     */
+    bool addItem(T* item, const uint32_t &deadline) {
+
+        if (numItems_ == size_) return false;
+
+        entries_[numItems_].item = item;
+        entries_[numItems_].deadline = deadline;
+        numItems_++;
+
+        _siftUp(numItems_ - 1);
+
+        return true;
+
+    }
+
+    /**
+     * Removes the item with the closest deadline.
+     *
+     * @returns pointer to the removed item. nullptr if empty.
+     */
+    T* removeNextItem() {
+
+        if (numItems_ == 0) return nullptr;
+
+        T* item = entries_[0].item;
+        _removeIndex(0);
+
+        return item;
+
+    }
+
+    /**
+     * Searches for the item and removes it. This is O(n) as the heap is not sorted.
+     *
+     * @param item Pointer to item to remove.
+     * @returns false if item wasnt found.
+     */
+    bool removeItem(const T* item) {
+
+        for (uint32_t i = 0; i < numItems_; i++) {
+
+            if (entries_[i].item == item) {
+                _removeIndex(i);
+                return true;
+            }
+
+        }
+
+        return false;
+
+    }
+
+    /**
+     * Removes all items. Not computationaly intensive.
+     */
+    void clear() {numItems_ = 0;}
+
+
+private:
+
+    struct Entry {
+
+        uint32_t deadline;
+        T* item;
+
+    };
+
+    //Returns true if timestamp a comes before b. Works over overflow.
+    static bool _isBefore(const uint32_t &a, const uint32_t &b) {return (int32_t)(a - b) < 0;}
+
+    void _swap(const uint32_t &a, const uint32_t &b) {
+        Entry buf = entries_[a];
+        entries_[a] = entries_[b];
+        entries_[b] = buf;
+    }
+
+    void _siftUp(uint32_t index) {
+
+        while (index > 0) {
+
+            uint32_t parent = (index - 1)/2;
+            if (!_isBefore(entries_[index].deadline, entries_[parent].deadline)) break;
+
+            _swap(index, parent);
+            index = parent;
+
+        }
+
+    }
+
+    void _siftDown(uint32_t index) {
+
+        while (true) {
+
+            uint32_t left = 2*index + 1;
+            uint32_t right = left + 1;
+            uint32_t smallest = index;
+
+            if (left < numItems_ && _isBefore(entries_[left].deadline, entries_[smallest].deadline)) smallest = left;
+            if (right < numItems_ && _isBefore(entries_[right].deadline, entries_[smallest].deadline)) smallest = right;
+
+            if (smallest == index) break;
+
+            _swap(index, smallest);
+            index = smallest;
+
+        }
+
+    }
+
+    void _removeIndex(const uint32_t &index) {
+
+        numItems_--;
+        if (index == numItems_) return; //Was last item, nothing to fix.
+
+        entries_[index] = entries_[numItems_];
+
+        //The moved entry can be too early or too late for its new place.
+        if (index > 0 && _isBefore(entries_[index].deadline, entries_[(index - 1)/2].deadline)) _siftUp(index);
+        else _siftDown(index);
+
+    }
+
+
+    Entry entries_[size_];
+
+    uint32_t numItems_ = 0;
+
+
+};
+
+
+
+#endif
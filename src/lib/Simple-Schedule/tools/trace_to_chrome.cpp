@@ -0,0 +1,202 @@
+/**
+ * Converts a trace written by TaskTrace (see src/task_trace.h) into the Chrome trace JSON format,
+ * which can be opened with https://ui.perfetto.dev or chrome://tracing.
+ * Task runs, interrupts and idle time are placed on one CPU track, so interrupts show inside the
+ * task they interrupted. Notifications and markers are instant events.
+ *
+ * Built and run on the host with:
+ * g++ -std=gnu++14 -O2 -o trace_to_chrome trace_to_chrome.cpp
+ * ./trace_to_chrome trace.bin trace.json
+*/
+
+
+
+#include "stdio.h"
+#include "stdint.h"
+#include "string.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+
+//Must match task_trace.h.
+#define TASK_TRACE_VERSION 1
+#define TASK_TRACE_HEADER_SIZE 24
+#define TASK_TRACE_NAME_ENTRY_SIZE 32
+
+enum eTraceEvent_t {
+    eTraceEvent_TaskBegin,
+    eTraceEvent_TaskEnd,
+    eTraceEvent_IsrBegin,
+    eTraceEvent_IsrEnd,
+    eTraceEvent_Notify,
+    eTraceEvent_Marker,
+    eTraceEvent_IdleBegin,
+    eTraceEvent_IdleEnd
+};
+
+enum eTraceName_t {
+    eTraceName_Task,
+    eTraceName_Registered
+};
+
+
+struct Event {
+    //Timestamp in ticks without wraps.
+    int64_t time;
+    uint8_t type;
+    uint8_t id;
+    uint16_t value;
+};
+
+
+
+static uint32_t readUint32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+
+/**
+ * @returns the name as a JSON string without quotes.
+ */
+static std::string escape(const std::string &text) {
+
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if ((unsigned char)c >= 0x20) escaped += c;
+    }
+
+    return escaped;
+
+}
+
+
+static std::string getName(const std::string* names, const uint8_t &id, const char* fallback) {
+    if (!names[id].empty()) return names[id];
+    return std::string(fallback) + " " + std::to_string(id);
+}
+
+
+
+int main(int argc, char** argv) {
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s trace.bin trace.json\n", argv[0]);
+        return 1;
+    }
+
+    FILE* input = fopen(argv[1], "rb");
+    if (input == nullptr) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), input)) > 0) data.insert(data.end(), buffer, buffer + length);
+    fclose(input);
+
+    if (data.size() < TASK_TRACE_HEADER_SIZE || memcmp(data.data(), "SSTR", 4) != 0 || data[4] != TASK_TRACE_VERSION) {
+        fprintf(stderr, "%s is not a trace of version %d\n", argv[1], TASK_TRACE_VERSION);
+        return 1;
+    }
+
+    uint32_t eventSize = data[6];
+    uint32_t ticksPerSecond = readUint32(&data[8]);
+    uint32_t numberEvents = readUint32(&data[12]);
+    uint32_t numberNames = readUint32(&data[16]);
+    uint32_t droppedEvents = readUint32(&data[20]);
+
+    if (eventSize < 8 || ticksPerSecond == 0 || data.size() < TASK_TRACE_HEADER_SIZE + (uint64_t)numberEvents*eventSize + (uint64_t)numberNames*TASK_TRACE_NAME_ENTRY_SIZE) {
+        fprintf(stderr, "%s is incomplete\n", argv[1]);
+        return 1;
+    }
+
+    std::string taskNames[256];
+    std::string registeredNames[256];
+    const uint8_t* nameData = &data[TASK_TRACE_HEADER_SIZE + numberEvents*eventSize];
+    for (uint32_t i = 0; i < numberNames; i++) {
+        const uint8_t* entry = nameData + i*TASK_TRACE_NAME_ENTRY_SIZE;
+        std::string name((const char*)entry + 4, strnlen((const char*)entry + 4, TASK_TRACE_NAME_ENTRY_SIZE - 4));
+        if (entry[0] == eTraceName_t::eTraceName_Task) taskNames[entry[2]] = name;
+        else registeredNames[entry[2]] = name;
+    }
+
+    //Timestamps wrap, so they are extended with the difference to the one before. Interrupts can store
+    //events slightly out of order, which gives a small negative difference that is fixed by sorting.
+    std::vector<Event> events;
+    uint32_t lastTimestamp = 0;
+    int64_t time = 0;
+    for (uint32_t i = 0; i < numberEvents; i++) {
+        const uint8_t* entry = &data[TASK_TRACE_HEADER_SIZE + i*eventSize];
+        uint32_t timestamp = readUint32(entry);
+        if (i > 0) time += (int32_t)(timestamp - lastTimestamp);
+        lastTimestamp = timestamp;
+        events.push_back({time, entry[4], entry[5], (uint16_t)(entry[6] | (entry[7] << 8))});
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) {return a.time < b.time;});
+
+    FILE* output = fopen(argv[2], "w");
+    if (output == nullptr) {
+        fprintf(stderr, "Cannot open %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(output, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"Events\"}}");
+
+    //Begin and end must pair up on a track. The oldest events can be ends whose begin was overwritten.
+    std::vector<std::string> open;
+    int64_t start = events.empty() ? 0 : events.front().time;
+
+    for (const Event &event : events) {
+
+        double ts = (double)(event.time - start)*1000000.0/ticksPerSecond;
+        std::string name;
+
+        switch (event.type) {
+        case eTraceEvent_t::eTraceEvent_TaskBegin:
+        case eTraceEvent_t::eTraceEvent_IsrBegin:
+        case eTraceEvent_t::eTraceEvent_IdleBegin:
+            if (event.type == eTraceEvent_t::eTraceEvent_TaskBegin) name = getName(taskNames, event.id, "Task");
+            else if (event.type == eTraceEvent_t::eTraceEvent_IsrBegin) name = getName(registeredNames, event.id, "Interrupt");
+            else name = "Idle";
+            open.push_back(name);
+            fprintf(output, ",\n{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":1}", escape(name).c_str(), ts);
+            break;
+        case eTraceEvent_t::eTraceEvent_TaskEnd:
+        case eTraceEvent_t::eTraceEvent_IsrEnd:
+        case eTraceEvent_t::eTraceEvent_IdleEnd:
+            if (open.empty()) break;
+            open.pop_back();
+            fprintf(output, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":1}", ts);
+            break;
+        case eTraceEvent_t::eTraceEvent_Notify:
+            name = "Notify " + getName(taskNames, event.id, "Task");
+            fprintf(output, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":2}", escape(name).c_str(), ts);
+            break;
+        case eTraceEvent_t::eTraceEvent_Marker:
+            name = getName(registeredNames, event.id, "Marker");
+            fprintf(output, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":2,\"args\":{\"value\":%u}}", escape(name).c_str(), ts, event.value);
+            break;
+        }
+
+    }
+
+    //Close what was still running when the trace was read.
+    double end = events.empty() ? 0 : (double)(events.back().time - start)*1000000.0/ticksPerSecond;
+    for (size_t i = 0; i < open.size(); i++) fprintf(output, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":1}", end);
+
+    fprintf(output, "\n]}\n");
+    fclose(output);
+
+    printf("Converted %u events over %.3fms. %u older events were overwritten.\n", numberEvents, end/1000.0, droppedEvents);
+
+    return 0;
+
+}
@@ -157,8 +157,9 @@ void HoverController::thread() {
     controlOutput_.force = navigationData_->attitude.copy().conjugate().rotateVector(controlOutput_.force); //Rotate to local coordinate system
 
     //Update control output timestamp
-    controlOutput_.timestamp = micros();
+    controlOutput_.timestamp = NOW();
 
+    releaseDependentTasks();
 
 
 }
@@ -25,6 +25,7 @@ public:
      * @param priority is the priority the module will have.
      */
     HoverController(Guidance_Interface* guidanceModule, Navigation_Interface* navigationModule) : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_High, true) {
+        setTaskName("HoverController");
         controlSetpoint_ = guidanceModule->getControlSetpointPointer();
         navigationData_ = navigationModule->getNavigationDataPointer();
     }
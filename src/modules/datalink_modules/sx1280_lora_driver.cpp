@@ -2,18 +2,34 @@
 
 
 
+SX1280Driver* SX1280Driver::driverInstance_ = nullptr;
+uint8_t SX1280Driver::traceInterruptId_ = TASK_TRACE_REGISTER("SX1280 DIO1");
+uint8_t SX1280Driver::traceIrqStatusId_ = TASK_TRACE_REGISTER("SX1280 IRQ status");
+
+
+
+void SX1280Driver::dio1Interrupt() {
+    TASK_TRACE_ISR_BEGIN(traceInterruptId_);
+    if (driverInstance_ != nullptr) driverInstance_->notifyFromISR();
+    TASK_TRACE_ISR_END(traceInterruptId_);
+}
+
+
+
 void SX1280Driver::thread() {
 
     if (block_) return;
 
     loopCounter_++;
 
-
     if (moduleStatus_ == eModuleStatus_t::eModuleStatus_Running) {
 
+        //Library transfers byte by byte, so the bus is held until it is done. Sensors get it in between, see yieldLock().
+        bus_->lock(spiDevice_);
         internalLoop();
+        bus_->unlock();
 
-    } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_NotStarted || moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) {
+    } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_NotStarted || moduleStatus_ == eModuleStatus_t::eModuleStatus_Starting || moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) {
 
         init();
 
@@ -55,6 +71,7 @@ void SX1280Driver::internalLoop() {
         
 
         uint16_t irqStatus = radio_.readIrqStatus();
+        TASK_TRACE_MARKER(traceIrqStatusId_, irqStatus);
 
 
         if (irqStatus & (IRQ_RX_DONE + IRQ_HEADER_VALID)) { // If interrupt says data good then get data
@@ -124,6 +141,9 @@ void SX1280Driver::internalLoop() {
 
         }
 
+        //Packet was read, waiting sensor reads go before the next commands.
+        bus_->yieldLock();
+
         radio_.clearIrqStatus(IRQ_RADIO_ALL); 
 
         //radio_.receive(receivedData_, SX1280_DATA_BUFFER_SIZE, 0, NO_WAIT);
@@ -133,10 +153,18 @@ void SX1280Driver::internalLoop() {
 
 
     
-    if (toSendDataSize_ > 0 && !isBusySending_ && !digitalRead(busyPin_)) { 
+    if (toSendDataSize_ > 0 && !isBusySending_) { 
+
+        //Radio still busy from last command. Try again next tick.
+        if (digitalRead(busyPin_)) {
+            notifyFromISR();
+            return;
+        }
 
         isBusySending_ = true;
 
+        bus_->yieldLock();
+
         radio_.transmit(toSendData_, toSendDataSize_, 0, SX1280_POWER_dB, NO_WAIT);
         /*radio_.startWriteSXBuffer(0);
         radio_.writeBuffer(toSendData_, toSendDataSize_);
@@ -156,19 +184,44 @@ void SX1280Driver::internalLoop() {
 
 void SX1280Driver::init() {
 
+    //Library transfers byte by byte, so the bus is held for every step. Also the first call comes from the scheduler and not thread().
+    bus_->lock(spiDevice_);
+    startup();
+    bus_->unlock();
+
+}
+
+
+void SX1280Driver::startup() {
+
+    //Last start attempt is done, begin a new one.
+    if (initCoroutine_.isFinished()) initCoroutine_.reset();
+
+    //Radio commands wait for the busy pin. Returning in between lets other tasks run during startup.
+    TASK_CO_BEGIN(initCoroutine_);
+
     SPI.begin();
     //SPI.setFrequency(10000000);
 
     if (radio_.begin(nssPin_, resetPin_, busyPin_, dio1Pin_, rxenPin_, txenPin_, DEVICE_SX1280)) {
 
-        moduleStatus_ = eModuleStatus_t::eModuleStatus_Running;
+        moduleStatus_ = eModuleStatus_t::eModuleStatus_Starting;
+        TASK_CO_YIELD(initCoroutine_);
 
         radio_.setupLoRa(SX1280_FREQUENCY, 0, SX1280_SPREADFACTOR, SX1280_BANDWIDTH, SX1280_CODINGRATE);
+        TASK_CO_YIELD(initCoroutine_);
+
         radio_.setDioIrqParams(IRQ_RADIO_ALL, IRQ_RADIO_ALL, 0, 0);
+        bus_->yieldLock();
         radio_.setHighSensitivity();
+        TASK_CO_YIELD(initCoroutine_);
 
         radio_.receive(receivedData_, SX1280_DATA_BUFFER_SIZE, 0, NO_WAIT);
 
+        moduleStatus_ = eModuleStatus_t::eModuleStatus_Running;
+
+        attachInterrupt(dio1Pin_, dio1Interrupt, RISING);
+
         Serial.println("SX1280 start success!");
 
         startAttempts_ = 0;
@@ -185,6 +238,8 @@ void SX1280Driver::init() {
 
     if (startAttempts_ >= 5 && moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) moduleStatus_ = eModuleStatus_t::eModuleStatus_Failure;
 
+    TASK_CO_END(initCoroutine_);
+
 }
 
 
@@ -200,6 +255,8 @@ uint8_t SX1280Driver::sendBuffer(uint8_t* buffer, uint8_t size) {
     toSendDataSize_ = size;
 
     for (uint16_t i = 0; i < size; i++) toSendData_[i] = buffer[i];
+
+    notifyFromISR(); //Send on next tick instead of waiting for the timeout.
     
     return size;
 
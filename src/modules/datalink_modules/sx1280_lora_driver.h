@@ -13,6 +13,8 @@
 
 #include "modules/module_abstract.h"
 
+#include "utils/spi_bus.h"
+
 
 
 //Lora radio settings.
@@ -27,6 +29,9 @@
 //This id the size of the buffer used to store data that was recieved and to be sent.
 #define SX1280_DATA_BUFFER_SIZE 255
 
+//If DIO1 did not trigger for this long, the thread is run anyways. In microseconds.
+#define SX1280_EVENT_TIMEOUT_US 10000
+
 //Uncomment this to enable serial data output
 //#define SX1280_DEBUG  
 
@@ -37,7 +42,8 @@
 class SX1280Driver: public KraftLink_Interface, public Module_Abstract, public Task_Abstract {
 public:
 
-    SX1280Driver(int busyPin, int txenPin, int rxenPin, int dio1Pin, int nResetPin, int nssPin/*, SPIClass* spiBus*/) : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_Middle, true) {
+    SX1280Driver(int busyPin, int txenPin, int rxenPin, int dio1Pin, int nResetPin, int nssPin/*, SPIClass* spiBus*/) : Task_Abstract(0, eTaskPriority_t::eTaskPriority_Middle) {
+        setTaskName("SX1280Driver");
         nssPin_ = nssPin;
         busyPin_ = busyPin;
         txenPin_ = txenPin;
@@ -45,6 +51,12 @@ public:
         dio1Pin_ = dio1Pin;
         resetPin_ = nResetPin;
         //spiBus_ = spiBus;
+        //Radio buffers are long and can wait, so the sensors go first.
+        spiDevice_ = bus_->addDevice(nssPin, LTspeedMaximum, LTdataMode, eSPIPriority_t::eSPIPriority_Low);
+        driverInstance_ = this;
+        //Runs when DIO1 triggers or data is to be sent. Timeout keeps start attempts and rate calculation going.
+        setTaskEventTimeout(SX1280_EVENT_TIMEOUT_US);
+        startTaskThreading();
     }
     
     /**
@@ -128,6 +140,21 @@ private:
 
     void internalLoop();
 
+    /**
+     * Steps of the startup sequence. Continues where it stopped on every call. The bus must be locked.
+     */
+    void startup();
+
+    //Called on rising edge of DIO1.
+    static void dio1Interrupt();
+
+    //Used by the interrupt to notify the task.
+    static SX1280Driver* driverInstance_;
+
+    //Ids of the interrupt and the radio IRQ status in the scheduler trace.
+    static uint8_t traceInterruptId_;
+    static uint8_t traceIrqStatusId_;
+
     //Buffer for data that was received by radio
     uint8_t receivedData_[SX1280_DATA_BUFFER_SIZE];
     uint8_t receivedDataSize_ = 0;
@@ -140,7 +167,7 @@ private:
     //Should be true whileits waiting for send to complete
     bool isBusySending_ = false;
 
-    IntervalControl rateCalcInterval_ = IntervalControl(1); 
+    RateControl rateCalcInterval_ = RateControl(1); 
 
     int nssPin_;
     int busyPin_;
@@ -149,8 +176,14 @@ private:
     int rxenPin_;
     int dio1Pin_;
     //SPIClass* spiBus_;
+    //Library uses SPI directly. Shared with the other devices on it.
+    SPIBus* bus_ = SPIBus::getBus(&SPI);
+    SPIDevice* spiDevice_ = nullptr;
     SX128XLT radio_;      
 
+    //Position in the startup sequence.
+    TaskCoroutine initCoroutine_;
+
     uint8_t startAttempts_ = 0;
 
     uint32_t loopRate_ = 0;
@@ -6,8 +6,9 @@ void GuidanceFlyByWire::thread() {
 
     if (!initialised) init();
 
-    float dT = ((float) micros() - _lastRunTimestamp)/1000000.0f; //Get time delta in seconds
-    _lastRunTimestamp = micros(); //Save current run timestamp for next run.
+    int64_t now = NOW();
+    float dT = (float)(now - _lastRunTimestamp)/SECONDS; //Get time delta in seconds
+    _lastRunTimestamp = now; //Save current run timestamp for next run.
 
     //Integrate speed, position and attitude
     vehicleControlSettings_.velocity += vehicleControlSettings_.linearAcceleration*dT;
@@ -15,6 +16,8 @@ void GuidanceFlyByWire::thread() {
 
     vehicleControlSettings_.attitude = vehicleControlSettings_.attitude*Quaternion(vehicleControlSettings_.angularRate.copy().normalize(), vehicleControlSettings_.angularRate.magnitude()*dT);
 
+    releaseDependentTasks();
+
 }   
 
 
@@ -27,7 +27,9 @@ public:
      * @param rate is the rate at which it will be ran at.
      * @param priority is the priority the module will have.
      */
-    GuidanceFlyByWire() : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_High, true) {}
+    GuidanceFlyByWire() : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_High, true) {
+        setTaskName("GuidanceFlyByWire");
+    }
 
     /**
      * Tells the guidance to rotate vehicle at set rate.
@@ -162,7 +164,7 @@ private:
 
     ControlData vehicleControlSettings_;
 
-    uint32_t _lastRunTimestamp = 0;
+    int64_t _lastRunTimestamp = 0;
 
     bool initialised = false;
 
@@ -29,7 +29,9 @@ public:
      * @param rate is the rate at which it will be ran at.
      * @param priority is the priority the module will have.
      */
-    GuidancePath() : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_High, true) {}
+    GuidancePath() : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_High, true) {
+        setTaskName("GuidancePath");
+    }
 
     /**
      * Tells guidance to go to a certain point, speed, attitude etc.
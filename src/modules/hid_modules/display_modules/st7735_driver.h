@@ -21,6 +21,8 @@ class ST7735Driver: public Display_Interface, public Module_Abstract, public Tas
 public:
 
     ST7735Driver(int backlightPin) : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_Low, true) {
+        setTaskName("ST7735Driver");
+        setTaskShedding(eTaskShedding_t::eTaskShedding_Skip);
         backlightPin_ = backlightPin;
     }
     
@@ -103,7 +105,7 @@ public:
 
 private:
 
-    IntervalControl _rateCalcInterval = IntervalControl(1); 
+    RateControl _rateCalcInterval = RateControl(1); 
 
     TFT_eSPI display_;
     int backlightPin_;
@@ -11,8 +11,9 @@ void NavigationComplementaryFilter::thread() {
     }
 
     //Calculate time delta from last run
-    float dTime = (float)(micros() - _lastLoopTimestamp)/1000000.0f;
-    _lastLoopTimestamp = micros();
+    int64_t now = NOW();
+    float dTime = (float)(now - _lastLoopTimestamp)/SECONDS;
+    _lastLoopTimestamp = now;
     	
     //Predict current state
     //NavigationData prediction = navigationData_;
@@ -26,12 +27,17 @@ void NavigationComplementaryFilter::thread() {
 
 
     //Correct with sensor values
-    while (gyro_->gyroAvailable() > 0) {
+    SampleView<RawVector> gyroSamples;
+    gyro_->peekGyroSamples(&gyroSamples);
+
+    //Raw samples are turned into values a batch at a time.
+    CalibratedSamples<NAVIGATION_CALIBRATION_BATCH> gyroValues(gyroSamples, gyro_->gyroCalibration());
+
+    while (gyroValues.next()) for (uint32_t i = 0; i < gyroValues.length; i++) {
         
         //Get IMU data
-        Vector rotationVector;
-        uint32_t timestamp;
-        gyro_->getGyro(&rotationVector, &timestamp);
+        Vector rotationVector = gyroValues.values[i];
+        int64_t timestamp = gyroValues.timestamps[i];
 
         if (rotationVector.magnitude() < 0.1) {
             gyroLPF_.update(rotationVector);
@@ -39,7 +45,7 @@ void NavigationComplementaryFilter::thread() {
         rotationVector = rotationVector - gyroLPF_.getValue();
 
         //Calulate time delta
-        float dt = float(timestamp - _lastGyroTimestamp)/1000000.0f;
+        float dt = (float)(timestamp - _lastGyroTimestamp)/SECONDS;
         _lastGyroTimestamp = timestamp;
 
         //Calulate derivitive of gyro for angular acceleration
@@ -74,17 +80,22 @@ void NavigationComplementaryFilter::thread() {
 
     }
 
+    gyro_->commitGyroSamples(gyroSamples.length());
+
+
+    SampleView<RawVector> accelSamples;
+    accel_->peekAccelSamples(&accelSamples);
+
+    //Accel bias and scale are applied in the same step as the calibration of the sensor.
+    CalibratedSamples<NAVIGATION_CALIBRATION_BATCH> accelValues(accelSamples, accel_->accelCalibration().corrected(_accelBias, _accelScale));
 
-    while (accel_->accelAvailable() > 0) {
+    while (accelValues.next()) for (uint32_t i = 0; i < accelValues.length; i++) {
 
         //static Vector lastValue = 0;
 
         //Get IMU data
-        Vector accelVector;
-        uint32_t timestamp;
-        accel_->getAccel(&accelVector, &timestamp);
-
-        accelVector = (accelVector - _accelBias).compWiseMulti(_accelScale);
+        Vector accelVector = accelValues.values[i];
+        int64_t timestamp = accelValues.timestamps[i];
 
         accelVector = accelLPF_.update(accelVector);
 
@@ -96,7 +107,7 @@ void NavigationComplementaryFilter::thread() {
         if (_accelInitialized) {
             
             //Correct state prediction
-            float dt = float(timestamp - _lastAccelTimestamp)/1000000.0f;
+            float dt = (float)(timestamp - _lastAccelTimestamp)/SECONDS;
             _lastAccelTimestamp = timestamp;
 
             float beta = 0.1f;
@@ -151,10 +162,17 @@ void NavigationComplementaryFilter::thread() {
 
     }
 
+    accel_->commitAccelSamples(accelSamples.length());
+
 
     if (mag_ != nullptr) {
 
-        while (mag_->magAvailable() > 0) {
+        SampleView<RawVector> magSamples;
+        mag_->peekMagSamples(&magSamples);
+
+        CalibratedSamples<NAVIGATION_CALIBRATION_BATCH> magValues(magSamples, mag_->magCalibration());
+
+        while (magValues.next()) for (uint32_t i = 0; i < magValues.length; i++) {
 
             /*static Vector max = -1000;
             static Vector min = 1000;
@@ -162,9 +180,8 @@ void NavigationComplementaryFilter::thread() {
             static Vector scale = 1;*/
 
             //Get IMU data
-            Vector magVector;
-            uint32_t timestamp;
-            mag_->getMag(&magVector, &timestamp);
+            Vector magVector = magValues.values[i];
+            int64_t timestamp = magValues.timestamps[i];
 
             if (_magInitialized) {
 
@@ -204,7 +221,7 @@ void NavigationComplementaryFilter::thread() {
                 magVector = (magVector - _magOffset).compWiseMulti(_magScale);
 
                 //Correct state prediction
-                float dt = float(timestamp - _lastMagTimestamp)/1000000.0f;
+                float dt = (float)(timestamp - _lastMagTimestamp)/SECONDS;
                 _lastMagTimestamp = timestamp;
 
                 float gamma = 0.1f;
@@ -250,30 +267,34 @@ void NavigationComplementaryFilter::thread() {
 
         }
 
+        mag_->commitMagSamples(magSamples.length());
+
     }
 
 
     //Make sure baro module is valid before using.
     if (baro_ != nullptr) {
 
-        while (baro_->pressureAvailable() > 0) {
+        SampleView<float> pressureSamples;
+        baro_->peekPressureSamples(&pressureSamples);
+
+        for (const SampleSegment<float> &segment : pressureSamples.segments) for (uint32_t i = 0; i < segment.length; i++) {
 
             //Get IMU data
-            float pressure;
-            uint32_t timestamp;
-            baro_->getPressure(&pressure, &timestamp);
+            float pressure = segment.values[i];
+            int64_t timestamp = segment.timestamps[i];
 
             //Check if accelerometer initialised
             if (_baroInitialized) {
                 
                 //Correct state prediction
-                float dt = float(timestamp - _lastBaroTimestamp)/1000000.0f;
+                float dt = (float)(timestamp - _lastBaroTimestamp)/SECONDS;
                 _lastBaroTimestamp = timestamp;
 
                 float beta = 0.01f;
 
                 //calculate height from new pressure value
-                float heightAbsolute = _getHeightFromPressure(pressure, 100e3f);
+                float heightAbsolute = baroHeightMedian_.update(_getHeightFromPressure(pressure, 100e3f));
                 //float heightRelative = heightAbsolute - navigationData_.absolutePosition.height;
                 //calculate z velocity from new height value
                 float zVelocity = (heightAbsolute - _lastHeightValue)/dt;
@@ -297,7 +318,7 @@ void NavigationComplementaryFilter::thread() {
                 
                 //Barometer filter initialisation
                 _lastBaroTimestamp = timestamp;
-                _lastHeightValue = _getHeightFromPressure(pressure, 100e3f);
+                _lastHeightValue = baroHeightMedian_.update(_getHeightFromPressure(pressure, 100e3f));
 
                 //Set current calculated height as start value.
                 navigationData_.absolutePosition.height = _lastHeightValue;
@@ -306,43 +327,58 @@ void NavigationComplementaryFilter::thread() {
 
         }
 
+        baro_->commitPressureSamples(pressureSamples.length());
+
     }
 
     
     
     if (gnss_ != nullptr) {
 
-        while (gnss_->positionAvailable() > 0) {
+        SampleView<WorldPosition> positionSamples;
+        gnss_->peekPositionSamples(&positionSamples);
 
-            WorldPosition positionAbsolute; uint32_t time;
-            if (gnss_->getPosition(&positionAbsolute, &time)) {
+        for (const SampleSegment<WorldPosition> &segment : positionSamples.segments) for (uint32_t i = 0; i < segment.length; i++) {
 
-                float beta = 0.1;
+            //Copied, as its methods are not const.
+            WorldPosition positionAbsolute = segment.values[i];
 
-                navigationData_.absolutePosition.latitude = positionAbsolute.latitude;
-                navigationData_.absolutePosition.longitude = positionAbsolute.longitude;
+            float beta = 0.1;
 
-                Vector positionBuf = positionAbsolute.getPositionVectorFrom(navigationData_.homePosition);
+            navigationData_.absolutePosition.latitude = positionAbsolute.latitude;
+            navigationData_.absolutePosition.longitude = positionAbsolute.longitude;
 
-                navigationData_.position.x += (positionBuf.x - navigationData_.position.x)*beta;
-                navigationData_.position.y += (positionBuf.y - navigationData_.position.y)*beta;
+            Vector positionBuf = positionAbsolute.getPositionVectorFrom(navigationData_.homePosition);
+            positionBuf.x = gnssPositionXMedian_.update(positionBuf.x);
+            positionBuf.y = gnssPositionYMedian_.update(positionBuf.y);
 
-            }
+            navigationData_.position.x += (positionBuf.x - navigationData_.position.x)*beta;
+            navigationData_.position.y += (positionBuf.y - navigationData_.position.y)*beta;
 
-            Vector velocityBuf;
-            if (gnss_->getVelocity(&velocityBuf, &time)) {
+        }
 
-                float beta = 0.1;
+        gnss_->commitPositionSamples(positionSamples.length());
 
-                navigationData_.velocity += (velocityBuf - navigationData_.velocity)*beta;
+        SampleView<Vector> velocitySamples;
+        gnss_->peekVelocitySamples(&velocitySamples);
 
-            }
+        for (const SampleSegment<Vector> &segment : velocitySamples.segments) for (uint32_t i = 0; i < segment.length; i++) {
+
+            float beta = 0.1;
+
+            Vector velocity = segment.values[i];
+
+            navigationData_.velocity += (velocity - navigationData_.velocity)*beta;
 
         }
 
+        gnss_->commitVelocitySamples(velocitySamples.length());
+
     }
 
 
-    navigationData_.timestamp = micros();
+    navigationData_.timestamp = NOW();
+
+    releaseDependentTasks();
 
 }
@@ -29,11 +29,18 @@
 
 #include "utils/high_pass_filter.h"
 #include "utils/low_pass_filter.h"
+#include "utils/median_filter.h"
+#include "utils/sensor_calibration.h"
 
 #include "data_containers/kinematic_data.h"
 
 
 
+//Number of raw sensor samples turned into values at a time.
+#define NAVIGATION_CALIBRATION_BATCH 16
+
+
+
 class NavigationComplementaryFilter: public Navigation_Interface, public Task_Abstract {
 public:
 
@@ -47,6 +54,7 @@ public:
      * @param gnss module to use.
      */
     NavigationComplementaryFilter(Gyroscope_Interface* gyro, Accelerometer_Interface* accel, Magnetometer_Interface* mag = nullptr, Barometer_Interface* baro = nullptr, GNSS_Interface* gnss = nullptr) : Task_Abstract(8000, eTaskPriority_t::eTaskPriority_VeryHigh, true) {
+        setTaskName("NavigationComplementaryFilter");
         gyro_ = gyro;
         accel_ = accel;
         mag_ = mag;
@@ -94,6 +102,10 @@ public:
         navigationData_.homePosition = homePosition;
         navigationData_.position = Vector(0);
 
+        //Old positions are relative to the old home.
+        gnssPositionXMedian_.clear();
+        gnssPositionYMedian_.clear();
+
     }
 
 
@@ -138,13 +150,18 @@ private:
 
     LowPassFilter<Vector> accelLPF_ = LowPassFilter<Vector>(3000);
 
-    uint32_t _lastGyroTimestamp = 0;
-    uint32_t _lastAccelTimestamp = 0;
-    uint32_t _lastMagTimestamp = 0;
+    //Spike rejection of barometer height and GNSS position. Delays them by half the window.
+    MedianFilter<float, 5> baroHeightMedian_;
+    MedianFilter<float, 5> gnssPositionXMedian_;
+    MedianFilter<float, 5> gnssPositionYMedian_;
+
+    int64_t _lastGyroTimestamp = 0;
+    int64_t _lastAccelTimestamp = 0;
+    int64_t _lastMagTimestamp = 0;
 
-    uint32_t _lastBaroTimestamp = 0;
+    int64_t _lastBaroTimestamp = 0;
 
-    uint32_t _lastLoopTimestamp = 0;
+    int64_t _lastLoopTimestamp = 0;
 
     Vector _lastGyroValue = 0;
 
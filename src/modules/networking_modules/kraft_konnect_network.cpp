@@ -23,6 +23,22 @@ void KraftKonnectNetwork::thread() {
 
         }
 
+        //Statistics are not needed to fly, so they are left out while the scheduler is overloaded.
+        if (sendTaskStatistics_ && !isSchedulerOverloaded() && !commsPort_->networkBusy() && taskStatisticsInterval_.isTimeToRun()) {
+
+            uint32_t numberTasks = getGlobalScheduler().getNumberTasks();
+            if (taskStatisticsIndex_ >= numberTasks) taskStatisticsIndex_ = 0;
+
+            TaskStatistics statistics;
+            if (getGlobalScheduler().getTaskStatistics(taskStatisticsIndex_, &statistics)) {
+                KraftMessageTaskStatistics message(statistics, taskStatisticsIndex_, numberTasks);
+                commsPort_->sendMessage(&message, eKraftPacketNodeID_t::eKraftPacketNodeID_broadcast);
+            }
+
+            taskStatisticsIndex_++;
+
+        }
+
         if (commsPort_->messageAvailable()) {
 
             MessageData messageData = commsPort_->getMessageInformation();
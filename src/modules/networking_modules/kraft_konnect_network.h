@@ -23,6 +23,8 @@ class KraftKonnectNetwork: public Module_Abstract, public Task_Abstract {
 public:
 
     KraftKonnectNetwork(KraftKommunication* communicationPort) : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_Middle, true) {
+        setTaskName("KraftKonnectNetwork");
+        setTaskShedding(eTaskShedding_t::eTaskShedding_ReduceRate);
         commsPort_ = communicationPort;
     }
     
@@ -51,6 +53,19 @@ public:
      */
     void setEventHandler(void (*eventHandler)(void), uint8_t eventMessageType) {eventHandlers_[constrain(eventMessageType, 0, 255)] = eventHandler;}
 
+    /**
+     * Periodically broadcasts the statistics of the scheduler tasks.
+     * Each message contains one task, the tasks are sent one after another.
+     * 
+     * @param rate_Hz Number of messages per second.
+     * @returns false if rate_Hz is 0. Sending is then stopped.
+     */
+    bool setTaskStatisticsRate(const uint32_t &rate_Hz) {
+        sendTaskStatistics_ = rate_Hz > 0;
+        if (sendTaskStatistics_) taskStatisticsInterval_.setRate(rate_Hz);
+        return sendTaskStatistics_;
+    }
+
 
 private:
 
@@ -59,8 +74,12 @@ private:
 
     KraftKommunication* commsPort_ = nullptr;
 
-    IntervalControl rateCalcInterval_ = IntervalControl(1);   
-    IntervalControl heartbeatInterval_ = IntervalControl(5);
+    RateControl rateCalcInterval_ = RateControl(1);   
+    RateControl heartbeatInterval_ = RateControl(5);
+    RateControl taskStatisticsInterval_ = RateControl(10);
+
+    bool sendTaskStatistics_ = false;
+    uint32_t taskStatisticsIndex_ = 0;
 
     uint8_t startAttempts_ = 0;
 
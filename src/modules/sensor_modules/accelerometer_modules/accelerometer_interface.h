@@ -5,6 +5,10 @@
 
 #include "lib/Math-Helper/src/3d_math.h"
 
+#include "utils/system_time.h"
+#include "utils/sensor_timestamp.h"
+#include "utils/sensor_calibration.h"
+
 
 
 class Accelerometer_Interface {
@@ -39,20 +43,45 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    virtual bool getAccel(Vector* accelData, uint32_t* accelTimestamp) = 0;
+    virtual bool getAccel(Vector* accelData, int64_t* accelTimestamp) = 0;
 
     /**
      * Returns true if accel data valid.
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    virtual bool peekAccel(Vector* accelData, uint32_t* accelTimestamp) = 0;
+    virtual bool peekAccel(Vector* accelData, int64_t* accelTimestamp) = 0;
+
+    /**
+     * Returns how to turn raw accel samples into values.
+     *
+     * @param values none.
+     * @return SensorCalibration.
+     */
+    virtual const SensorCalibration& accelCalibration() = 0;
+
+    /**
+     * Gives all pending accel samples without copying them, oldest first, as raw counts.
+     * Values are calculated with accelCalibration(), e.g. by CalibratedSamples.
+     * They stay in the queue and valid until removed with commitAccelSamples().
+     *
+     * @param view is overwritten with the samples. They can be split into two segments.
+     * @returns number of samples in the view.
+     */
+    virtual uint32_t peekAccelSamples(SampleView<RawVector>* view) = 0;
+
+    /**
+     * Removes the oldest samples from queue, e.g. the ones of the last peekAccelSamples().
+     *
+     * @param number of samples to remove.
+     */
+    virtual void commitAccelSamples(const uint32_t &number) = 0;
 
     /**
      * Removes all elements from queue.
@@ -5,6 +5,8 @@
 
 #include "stdint.h"
 
+#include "utils/system_time.h"
+
 
 
 class ADC_Interface {
@@ -39,11 +41,11 @@ public:
      * This will remove sensor data from queue, peek will not.
      *
      * @param voltageData float where the data will be written into
-     * @param voltageTimestamp timestamp in microseconds of when measurement was taken
+     * @param voltageTimestamp timestamp in nanoseconds of when measurement was taken
      * @param channel Which adc channel to get the voltage from
      * @return bool.
      */
-    virtual bool getVoltage(float* voltageData, uint32_t* voltageTimestamp, uint8_t channel = 0) = 0;
+    virtual bool getVoltage(float* voltageData, int64_t* voltageTimestamp, uint8_t channel = 0) = 0;
 
     /**
      * Returns true if pressure data valid.
@@ -51,11 +53,11 @@ public:
      * This will remove sensor data from queue, peek will not.
      *
      * @param voltageData float where the data will be written into
-     * @param voltageTimestamp timestamp in microseconds of when measurement was taken
+     * @param voltageTimestamp timestamp in nanoseconds of when measurement was taken
      * @param channel Which adc channel to get the voltage from
      * @return bool.
      */
-    virtual bool peekVoltage(float* voltageData, uint32_t* voltageTimestamp, uint8_t channel) = 0;
+    virtual bool peekVoltage(float* voltageData, int64_t* voltageTimestamp, uint8_t channel) = 0;
 
     /**
      * Removes all values from buffer
@@ -2,6 +2,16 @@
 
 
 
+ADS1115Driver* ADS1115Driver::driverInstance_ = nullptr;
+
+
+
+void ADS1115Driver::_alertInterrupt() {
+    if (driverInstance_ != nullptr) driverInstance_->notifyFromISR();
+}
+
+
+
 void ADS1115Driver::_getData() {
 
     if (adc_.isBusy()) return;
@@ -10,7 +20,7 @@ void ADS1115Driver::_getData() {
 
     //adc_.readADC(currentPin_);
 
-    voltageTimestampFifo_[currentPin_].placeFront(micros(), true);
+    voltageTimestampFifo_[currentPin_].placeFront(NOW(), true);
     voltageFifo_[currentPin_].placeFront(adc_.toVoltage(adc_.getValue()), true);
 
     currentPin_++;
@@ -73,6 +83,17 @@ void ADS1115Driver::init() {
         adc_.setMode(1);
         adc_.setGain(1);
         adc_.setDataRate(7);
+
+        if (alertPin_ >= 0) {
+            //Threshold MSBs set this way turn ALERT/RDY into a conversion ready signal.
+            adc_.setComparatorThresholdHigh((int16_t)0x8000);
+            adc_.setComparatorThresholdLow(0x0000);
+            adc_.setComparatorQueConvert(0);
+            //Polarity is not set, so both edges are used. The thread ignores the edge of a starting conversion as the adc is still busy.
+            pinMode(alertPin_, INPUT_PULLUP);
+            attachInterrupt(alertPin_, _alertInterrupt, CHANGE);
+        }
+
         adc_.requestADC(0);
 
         lastMeasurement_ = micros();
@@ -17,11 +17,25 @@
 
 
 
+//If the alert pin did not trigger for this long, the thread is run anyways. In microseconds.
+#define ADS1115_EVENT_TIMEOUT_US 10000
+
+
+
 class ADS1115Driver: public ADC_Interface, public Module_Abstract, public Task_Abstract {
 public:
 
-    ADS1115Driver(TwoWire* i2cBus) : Task_Abstract(1000, eTaskPriority_t::eTaskPriority_Realtime, true), adc_(0x48) {
+    /**
+     * @param i2cBus is the bus the adc is connected to.
+     * @param alertPin is the pin connected to ALERT/RDY. If given, then the adc is read once a conversion is ready instead of polling at 1kHz. -1 if not connected.
+     */
+    ADS1115Driver(TwoWire* i2cBus, int alertPin = -1) : Task_Abstract(alertPin >= 0 ? 0 : 1000, eTaskPriority_t::eTaskPriority_Realtime), adc_(0x48) {
+        setTaskName("ADS1115Driver");
         i2cBus_ = i2cBus;
+        alertPin_ = alertPin;
+        driverInstance_ = this;
+        setTaskEventTimeout(ADS1115_EVENT_TIMEOUT_US);
+        startTaskThreading();
     }
     
     /**
@@ -69,11 +83,11 @@ public:
      * This will remove sensor data from queue, peek will not.
      *
      * @param voltageData float where the data will be written into
-     * @param voltageTimestamp timestamp in microseconds of when measurement was taken
+     * @param voltageTimestamp timestamp in nanoseconds of when measurement was taken
      * @param channel Which adc channel to get the voltage from
      * @return bool.
      */
-    virtual bool getVoltage(float* voltageData, uint32_t* voltageTimestamp, uint8_t channel = 0) {
+    virtual bool getVoltage(float* voltageData, int64_t* voltageTimestamp, uint8_t channel = 0) {
 
         channel = min(channel, (uint8_t)4); 
 
@@ -92,10 +106,10 @@ public:
      * This will remove sensor data from queue, peek will not.
      *
      * @param voltageData float where the data will be written into
-     * @param voltageTimestamp timestamp in microseconds of when measurement was taken
+     * @param voltageTimestamp timestamp in nanoseconds of when measurement was taken
      * @return bool.
      */
-    virtual bool peekVoltage(float* voltageData, uint32_t* voltageTimestamp, uint8_t channel) {
+    virtual bool peekVoltage(float* voltageData, int64_t* voltageTimestamp, uint8_t channel) {
 
         channel = min(channel, (uint8_t)4); 
 
@@ -124,13 +138,20 @@ private:
 
     void _getData();
 
+    //Called when ALERT/RDY changes.
+    static void _alertInterrupt();
+
+    //Used by the interrupt to notify the task.
+    static ADS1115Driver* driverInstance_;
+
 
     Buffer <float, 10> voltageFifo_[4];
-    Buffer <uint32_t, 10> voltageTimestampFifo_[4];
+    Buffer <int64_t, 10> voltageTimestampFifo_[4];
 
-    IntervalControl _rateCalcInterval = IntervalControl(1); 
+    RateControl _rateCalcInterval = RateControl(1); 
 
     int chipSelectPin_ = 0;
+    int alertPin_ = -1;
     TwoWire* i2cBus_;
     ADS1115 adc_;
 
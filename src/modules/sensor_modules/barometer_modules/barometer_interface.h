@@ -5,6 +5,9 @@
 
 #include "stdint.h"
 
+#include "utils/system_time.h"
+#include "utils/sensor_timestamp.h"
+
 
 
 class Barometer_Interface {
@@ -37,10 +40,10 @@ public:
      * This will remove sensor data from queue, peek will not.
      *
      * @param pressureData float where the data will be writen into
-     * @param pressureTimestamp timestamp of when the measurement was taken
+     * @param pressureTimestamp timestamp in nanoseconds of when the measurement was taken
      * @return bool.
      */
-    virtual bool getPressure(float* pressureData, uint32_t* pressureTimestamp) = 0;
+    virtual bool getPressure(float* pressureData, int64_t* pressureTimestamp) = 0;
 
     /**
      * Returns true if pressure data valid.
@@ -50,10 +53,26 @@ public:
      * @see getPressure(...)
      *
      * @param pressureData float where the data will be writen into
-     * @param pressureTimestamp timestamp of when the measurement was taken
+     * @param pressureTimestamp timestamp in nanoseconds of when the measurement was taken
      * @return bool.
      */
-    virtual bool peekPressure(float* pressureData, uint32_t* pressureTimestamp) = 0;
+    virtual bool peekPressure(float* pressureData, int64_t* pressureTimestamp) = 0;
+
+    /**
+     * Gives all pending pressure samples without copying them, oldest first.
+     * They stay in the queue and valid until removed with commitPressureSamples().
+     *
+     * @param view is overwritten with the samples. They can be split into two segments.
+     * @returns number of samples in the view.
+     */
+    virtual uint32_t peekPressureSamples(SampleView<float>* view) = 0;
+
+    /**
+     * Removes the oldest samples from queue, e.g. the ones of the last peekPressureSamples().
+     *
+     * @param number of samples to remove.
+     */
+    virtual void commitPressureSamples(const uint32_t &number) = 0;
 
     /**
      * Removes all elements from queue.
@@ -6,29 +6,55 @@ void BME280Driver::_getData() {
 
     BME280_SensorMeasurements measurements;
 
-    uint32_t _newDataTimestamp = micros();
-    _bme.readAllMeasurements(&measurements);
+    if (!useSPI_) {
+        int64_t timestamp = NOW();
+        _bme.readAllMeasurements(&measurements);
+        _placeMeasurements(measurements, timestamp);
+        return;
+    }
+
+    if (dataReadBusy_ && (dataRead_.status == eSPITransactionStatus_t::eSPITransactionStatus_Done || dataRead_.status == eSPITransactionStatus_t::eSPITransactionStatus_Failed)) {
+
+        if (dataRead_.status == eSPITransactionStatus_t::eSPITransactionStatus_Done) {
+            //Temperature must be first, pressure and humidity are compensated with it.
+            measurements.temperature = _bme.readTempFromBurst(&dataRx_[1]);
+            _bme.readFloatPressureFromBurst(&dataRx_[1], &measurements);
+            _bme.readFloatHumidityFromBurst(&dataRx_[1], &measurements);
+            _placeMeasurements(measurements, dataRead_.startTimestamp);
+        }
+
+        dataReadBusy_ = false;
+
+    }
+
+    if (!dataReadBusy_) {
+        //Should be done before the next run.
+        dataRead_.deadline = NOW() + 1000000000LL/getTaskRate();
+        dataReadBusy_ = bus_->submit(&dataRead_);
+    }
+
+}
+
+
+void BME280Driver::_placeMeasurements(const BME280_SensorMeasurements &measurements, const int64_t &timestamp) {
 
     float bufMeasurement = measurements.pressure;
     if (bufMeasurement > 100) {
-        _pressureFifo.placeFront(bufMeasurement, true);
-        _pressureTimestampFifo.placeFront(_newDataTimestamp, true);
+        _pressureFifo.push(bufMeasurement, timestamp);
         _lastPressure = bufMeasurement;
         _pressureCounter++;
     }
 
     bufMeasurement = measurements.temperature;
     if (true) {
-        _temperatureFifo.placeFront(bufMeasurement, true);
-        _temperatureTimestampFifo.placeFront(_newDataTimestamp, true);
+        _temperatureFifo.push(bufMeasurement, timestamp);
         _lastTemperature = bufMeasurement;
         _temperatureCounter++;
     }
 
     bufMeasurement = measurements.humidity;
     if (true) {
-        _humidityFifo.placeFront(bufMeasurement, true);
-        _humidityTimestampFifo.placeFront(_newDataTimestamp, true);
+        _humidityFifo.push(bufMeasurement, timestamp);
         _lastHumidity = bufMeasurement;
         _humidityCounter++;
     }
@@ -36,13 +62,26 @@ void BME280Driver::_getData() {
 }
 
 
+void BME280Driver::_setupDataRead() {
+
+    dataTx_[0] = BME280_MEASUREMENTS_REG | 0x80; //Read bit
+
+    dataRead_.device = spiDevice_;
+    dataRead_.txBuffer = dataTx_;
+    dataRead_.rxBuffer = dataRx_;
+    dataRead_.length = sizeof(dataTx_);
+
+    dataReadBusy_ = false;
+
+}
+
+
 void BME280Driver::thread() {
 
     if (_block) return;
 
     _loopCounter++;
 
-
     if (moduleStatus_ == eModuleStatus_t::eModuleStatus_Running) {
 
         if (/*!_bme.isMeasuring()*/true) {
@@ -51,7 +90,7 @@ void BME280Driver::thread() {
 
         }
 
-    } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_NotStarted || moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) {
+    } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_NotStarted || moduleStatus_ == eModuleStatus_t::eModuleStatus_Starting || moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) {
         
         init();
 
@@ -89,7 +128,24 @@ void BME280Driver::thread() {
 
 void BME280Driver::init() {
 
-    int startCode;
+    //Library transfers byte by byte, so the bus is held for every step. Also the first call comes from the scheduler and not thread().
+    if (bus_ != nullptr) bus_->lock(spiDevice_);
+    _startup();
+    if (bus_ != nullptr) bus_->unlock();
+
+}
+
+
+void BME280Driver::_startup() {
+
+    int startCode = 0;
+
+    //Last start attempt is done, begin a new one.
+    if (_initCoroutine.isFinished()) _initCoroutine.reset();
+
+    TASK_CO_BEGIN(_initCoroutine);
+
+    moduleStatus_ = eModuleStatus_t::eModuleStatus_Starting;
 
     if (useSPI_) startCode = _bme.beginSPI(chipSelectPin_);
     else {
@@ -103,6 +159,9 @@ void BME280Driver::init() {
         _bme.setPressureOverSample(4);
         _bme.setTempOverSample(1);
 
+        //Each setting is a read and write over the bus, let other tasks run in between.
+        TASK_CO_YIELD(_initCoroutine);
+
         _bme.setFilter(3);
 
         _bme.setStandbyTime(6);
@@ -110,6 +169,8 @@ void BME280Driver::init() {
         _bme.setMode(MODE_FORCED);
 
         _lastMeasurement = micros();
+
+        if (useSPI_) _setupDataRead();
         
 
         //imuStatus = DeviceStatus::DEVICE_CALIBRATING;
@@ -124,4 +185,6 @@ void BME280Driver::init() {
 
     if (_startAttempts >= 5 && moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) moduleStatus_ = eModuleStatus_t::eModuleStatus_Failure;
 
+    TASK_CO_END(_initCoroutine);
+
 }
@@ -13,7 +13,14 @@
 
 #include "lib/SparkFun_BME280/src/SparkFunBME280.h"
 
-#include "utils/buffer.h"
+#include "utils/sample_ring.h"
+#include "utils/sensor_timestamp.h"
+#include "utils/spi_bus.h"
+
+
+
+//Number of measurements kept for every value. Must be a power of 2.
+#define BME280_FIFO_SIZE 128
 
 
 
@@ -21,12 +28,16 @@ class BME280Driver: public Barometer_Interface, public Module_Abstract, public T
 public:
 
     BME280Driver(int chipSelectPin, SPIClass* spiBus) : Task_Abstract(20, eTaskPriority_t::eTaskPriority_Realtime, true) {
+        setTaskName("BME280Driver");
         chipSelectPin_ = chipSelectPin;
         spiBus_ = spiBus;
+        bus_ = SPIBus::getBus(spiBus);
+        spiDevice_ = bus_->addDevice(chipSelectPin, BME280_SPI_CLOCK, BME280_SPI_MODE, eSPIPriority_t::eSPIPriority_Middle);
         useSPI_ = true;
     }
 
     BME280Driver(TwoWire* i2cBus, int address) : Task_Abstract(200, eTaskPriority_t::eTaskPriority_Realtime, true) {
+        setTaskName("BME280Driver");
         i2cBus_ = i2cBus;
         i2cAddress_ = address;
         useSPI_ = false;
@@ -77,17 +88,12 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values float and uint32_t.
+     * @param values float and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool getPressure(float* pressureData, uint32_t* pressureTimestamp) {
-
-        if (_pressureFifo.available() == 0) return false;
-
-        _pressureFifo.takeBack(pressureData);
-        _pressureTimestampFifo.takeBack(pressureTimestamp);
+    bool getPressure(float* pressureData, int64_t* pressureTimestamp) {
 
-        return true;
+        return _pressureFifo.pop(pressureData, pressureTimestamp);
 
     };
 
@@ -96,19 +102,30 @@ public:
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values float and uint32_t.
+     * @param values float and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool peekPressure(float* pressureData, uint32_t* pressureTimestamp) {
+    bool peekPressure(float* pressureData, int64_t* pressureTimestamp) {
 
-        if (_pressureFifo.available() == 0) return false;
+        return _pressureFifo.peek(pressureData, pressureTimestamp);
 
-        _pressureFifo.peekBack(pressureData);
-        _pressureTimestampFifo.peekBack(pressureTimestamp);
+    }
 
-        return true;
+    /**
+     * Gives all pending pressure samples without copying them, oldest first.
+     * They stay in the queue and valid until removed with commitPressureSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekPressureSamples(SampleView<float>* view) {return _pressureFifo.peek(view);}
 
-    }
+    /**
+     * Removes the oldest samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitPressureSamples(const uint32_t &number) {_pressureFifo.remove(number);}
 
     /**
      * Removes all elements from queue.
@@ -118,7 +135,6 @@ public:
      */
     void flushPressure() {
         _pressureFifo.clear();
-        _pressureTimestampFifo.clear();
     }
 
     /**
@@ -142,17 +158,12 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values float and uint32_t.
+     * @param values float and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool getTemperature(float* temperatureData, uint32_t* temperatureTimestamp) {
+    bool getTemperature(float* temperatureData, int64_t* temperatureTimestamp) {
 
-        if (_temperatureFifo.available() == 0) return false;
-
-        _temperatureFifo.takeBack(temperatureData);
-        _temperatureTimestampFifo.takeBack(temperatureTimestamp);
-
-        return true;
+        return _temperatureFifo.pop(temperatureData, temperatureTimestamp);
 
     };
 
@@ -161,17 +172,12 @@ public:
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values float and uint32_t.
+     * @param values float and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool peekTemperature(float* temperatureData, uint32_t* temperatureTimestamp) {
-
-        if (_temperatureFifo.available() == 0) return false;
-
-        _temperatureFifo.peekBack(temperatureData);
-        _temperatureTimestampFifo.peekBack(temperatureTimestamp);
+    bool peekTemperature(float* temperatureData, int64_t* temperatureTimestamp) {
 
-        return true;
+        return _temperatureFifo.peek(temperatureData, temperatureTimestamp);
 
     };
 
@@ -183,7 +189,6 @@ public:
      */
     void flushTemperature() {
         _temperatureFifo.clear();
-        _temperatureTimestampFifo.clear();
     }
 
     /**
@@ -207,17 +212,12 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values float and uint32_t.
+     * @param values float and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool getHumidity(float* humidityData, uint32_t* humidityTimestamp) {
+    bool getHumidity(float* humidityData, int64_t* humidityTimestamp) {
 
-        if (_humidityFifo.available() == 0) return false;
-
-        _humidityFifo.takeBack(humidityData);
-        _humidityTimestampFifo.takeBack(humidityTimestamp);
-
-        return true;
+        return _humidityFifo.pop(humidityData, humidityTimestamp);
 
     };
 
@@ -226,17 +226,12 @@ public:
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values float and uint32_t.
+     * @param values float and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool peekHumidity(float* humidityData, uint32_t* humidityTimestamp) {
-
-        if (_humidityFifo.available() == 0) return false;
+    bool peekHumidity(float* humidityData, int64_t* humidityTimestamp) {
 
-        _humidityFifo.peekBack(humidityData);
-        _humidityTimestampFifo.peekBack(humidityTimestamp);
-
-        return true;
+        return _humidityFifo.peek(humidityData, humidityTimestamp);
 
     };
 
@@ -247,8 +242,7 @@ public:
      * @return none.
      */
     void flushHumidity() {
-        _temperatureFifo.clear();
-        _temperatureTimestampFifo.clear();
+        _humidityFifo.clear();
     }
 
 
@@ -256,30 +250,59 @@ private:
 
     void _getData();
 
+    /**
+     * Steps of the startup sequence. Continues where it stopped on every call. The bus must be locked.
+     */
+    void _startup();
 
-    Buffer <float, 100> _pressureFifo;
-    Buffer <float, 100> _humidityFifo;
-    Buffer <float, 100> _temperatureFifo;
-    Buffer <uint32_t, 100> _pressureTimestampFifo;
-    Buffer <uint32_t, 100> _humidityTimestampFifo;
-    Buffer <uint32_t, 100> _temperatureTimestampFifo;
+    /**
+     * Places new measurements into the FIFOs.
+     *
+     * @param measurements to place.
+     * @param timestamp of the measurements in nanoseconds.
+     */
+    void _placeMeasurements(const BME280_SensorMeasurements &measurements, const int64_t &timestamp);
+
+    /**
+     * Sets up the transaction for reading the measurements over the bus.
+     */
+    void _setupDataRead();
+
+
+    //Filled by this task and emptied by navigation. Full drops new measurements, so views given to navigation stay valid.
+    SampleRing<float, BME280_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Separate> _pressureFifo;
+    //Nothing has to empty these, so full overwrites the oldest and peeking always gives one of the last BME280_FIFO_SIZE measurements.
+    SampleRing<float, BME280_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Interleaved, eRingOverflow_t::eRingOverflow_OverwriteOldest> _humidityFifo;
+    SampleRing<float, BME280_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Interleaved, eRingOverflow_t::eRingOverflow_OverwriteOldest> _temperatureFifo;
 
     float _lastPressure;
     float _lastHumidity;
     float _lastTemperature;
 
-    IntervalControl _rateCalcInterval = IntervalControl(1); 
+    RateControl _rateCalcInterval = RateControl(1); 
 
 
     int chipSelectPin_ = 0;
     SPIClass* spiBus_;
+    //Shared with the other devices on the bus. nullptr with I2C.
+    SPIBus* bus_ = nullptr;
+    SPIDevice* spiDevice_ = nullptr;
     bool useSPI_ = false;
 
+    //Burst read of all measurement registers. Submitted by one run and placed by the next, the bus is only locked for setup.
+    SPITransaction dataRead_;
+    uint8_t dataTx_[9] = {0};
+    alignas(32) uint8_t dataRx_[9];
+    bool dataReadBusy_ = false;
+
     TwoWire* i2cBus_;
     int i2cAddress_;
 
     BME280 _bme;
 
+    //Position in the startup sequence.
+    TaskCoroutine _initCoroutine;
+
     uint8_t _startAttempts = 0;
 
     uint32_t _loopRate = 0;
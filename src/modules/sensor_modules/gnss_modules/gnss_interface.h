@@ -7,6 +7,9 @@
 
 #include "data_containers/navigation_data.h"
 
+#include "utils/system_time.h"
+#include "utils/sensor_timestamp.h"
+
 
 
 class GNSS_Interface {
@@ -40,7 +43,7 @@ public:
      * @param position Struct to be overritten with position data.
      * @returns true if position data valid.
      */
-    virtual bool getPosition(WorldPosition* position, uint32_t* positionTimestamp) = 0;
+    virtual bool getPosition(WorldPosition* position, int64_t* positionTimestamp) = 0;
 
     /**
      * Variables given as parameters will be overridden.
@@ -49,7 +52,7 @@ public:
      * @param position Struct to be overritten with position data.
      * @returns true if position data valid.
      */
-    virtual bool peekPosition(WorldPosition* position, uint32_t* positionTimestamp) = 0;
+    virtual bool peekPosition(WorldPosition* position, int64_t* positionTimestamp) = 0;
 
     /**
      * @returns the Position accuracy. If unsupported or altitude not available will return -1;
@@ -61,6 +64,22 @@ public:
      */
     virtual float getAltitudeAccuracy() {return -1;}
 
+    /**
+     * Gives all pending position samples without copying them, oldest first.
+     * They stay in the queue and valid until removed with commitPositionSamples().
+     *
+     * @param view is overwritten with the samples. They can be split into two segments.
+     * @returns number of samples in the view.
+     */
+    virtual uint32_t peekPositionSamples(SampleView<WorldPosition>* view) = 0;
+
+    /**
+     * Removes the oldest samples from queue, e.g. the ones of the last peekPositionSamples().
+     *
+     * @param number of samples to remove.
+     */
+    virtual void commitPositionSamples(const uint32_t &number) = 0;
+
     /**
      * Removes all elements from queue.
      */
@@ -87,7 +106,7 @@ public:
      * @param velocity is the velocity.
      * @returns true if position data valid.
      */
-    virtual bool getVelocity(Vector* velocity, uint32_t* velocityTimestamp) = 0;
+    virtual bool getVelocity(Vector* velocity, int64_t* velocityTimestamp) = 0;
 
     /**
      * Variables given as parameters will be overridden.
@@ -96,7 +115,23 @@ public:
      * @param velocity is the velocity.
      * @returns true if position data valid.
      */
-    virtual bool peekVelocity(Vector* velocity, uint32_t* velocityTimestamp) = 0;
+    virtual bool peekVelocity(Vector* velocity, int64_t* velocityTimestamp) = 0;
+
+    /**
+     * Gives all pending velocity samples without copying them, oldest first.
+     * They stay in the queue and valid until removed with commitVelocitySamples().
+     *
+     * @param view is overwritten with the samples. They can be split into two segments.
+     * @returns number of samples in the view.
+     */
+    virtual uint32_t peekVelocitySamples(SampleView<Vector>* view) = 0;
+
+    /**
+     * Removes the oldest samples from queue, e.g. the ones of the last peekVelocitySamples().
+     *
+     * @param number of samples to remove.
+     */
+    virtual void commitVelocitySamples(const uint32_t &number) = 0;
 
     /**
      * Removes all elements from queue.
@@ -4,7 +4,7 @@
 
 void UbloxSerialGNSS::_getData() {
 
-    uint32_t time = micros();
+    int64_t time = NOW();
 
     numSats_ = gnss_.getSIV();
 
@@ -22,8 +22,7 @@ void UbloxSerialGNSS::_getData() {
     position.longitude = (double)gnss_.getLongitude()*10e7;
     position.longitude = (float)gnss_.getAltitudeMSL()/1000;
 
-    positionFifo_.placeFront(position, true);
-    positionTimestampFifo_.placeFront(time, true);
+    positionFifo_.push(position, time);
 
 
     Vector velocity;
@@ -31,8 +30,7 @@ void UbloxSerialGNSS::_getData() {
     velocity.y = -(float)gnss_.getNedEastVel()/1000;
     velocity.z = -(float)gnss_.getNedDownVel()/1000;
 
-    velocityFifo_.placeFront(velocity, true);
-    velocityTimestampFifo_.placeFront(time, true);
+    velocityFifo_.push(velocity, time);
 
     //positionDeviation_ = gnss_.getHorizontalAccuracy(0);
     //altitudeDeviation_ = gnss_.getVerticalAccuracy(0);
@@ -88,7 +86,7 @@ void UbloxSerialGNSS::thread() {
 
     } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_Starting) {
         
-
+        init(); //Continue startup.
 
     } else { //This section is for device failure or a wierd mode that should not be set, therefore assume failure
 
@@ -120,12 +118,19 @@ void UbloxSerialGNSS::init() {
         return;
     }
 
+    //Last start attempt is done, begin a new one.
+    if (initCoroutine_.isFinished()) initCoroutine_.reset();
+
+    //Every configuration below waits for an acknowledge from the receiver. 
+    //Returning in between lets other tasks run instead of blocking them for the whole startup.
+    TASK_CO_BEGIN(initCoroutine_);
+
     if (moduleStatus_ == eModuleStatus_t::eModuleStatus_NotStarted) serialPort_->begin(115200);
     else serialPort_->begin(9600*max(serialBaudMulti_,uint32_t(1)));
 
     if (gnss_.begin(*serialPort_)) {
 
-        moduleStatus_ = eModuleStatus_t::eModuleStatus_Running;
+        moduleStatus_ = eModuleStatus_t::eModuleStatus_Starting;
 
         //gnss_.factoryDefault();
 
@@ -133,17 +138,25 @@ void UbloxSerialGNSS::init() {
 
         gnss_.setSerialRate(115200);
         serialPort_->begin(115200);
+        TASK_CO_YIELD(initCoroutine_);
 
         //gnss_.setUART1Output(COM_TYPE_UBX & COM_TYPE_NMEA & COM_TYPE_RTCM3);
         gnss_.setNavigationFrequency(10);
+        TASK_CO_YIELD(initCoroutine_);
+
         //gnss_.setMeasurementRate(10);
         //gnss_.setNavigationRate(10);
         gnss_.setAutoPVT(true);
         gnss_.assumeAutoPVT(true, true);
+        TASK_CO_YIELD(initCoroutine_);
+
         gnss_.setDynamicModel(DYN_MODEL_AIRBORNE4g);
+        TASK_CO_YIELD(initCoroutine_);
 
         gnss_.saveConfiguration();
 
+        moduleStatus_ = eModuleStatus_t::eModuleStatus_Running;
+
     } else {
 
         if (moduleStatus_ != eModuleStatus_t::eModuleStatus_NotStarted) {
@@ -156,5 +169,7 @@ void UbloxSerialGNSS::init() {
 
     }
 
+    TASK_CO_END(initCoroutine_);
+
 }
 
@@ -13,7 +13,7 @@
 #include "modules/module_abstract.h"
 
 #include "lib/SparkFun_u-blox_GNSS/src/SparkFun_u-blox_GNSS_Arduino_Library.h"
-#include "utils/buffer.h"
+#include "utils/sample_ring.h"
 
 
 
@@ -25,6 +25,7 @@ public:
      * @param usbPassthrough If true then gps wont be setup and serial data will be passed to USB serial.
      */
     UbloxSerialGNSS(HardwareSerial* serialPort, bool usbPassthrough = false) : Task_Abstract(100, eTaskPriority_t::eTaskPriority_Realtime, true) {
+        setTaskName("UbloxSerialGNSS");
         serialPort_ = serialPort;
         usbPassthrough_ = usbPassthrough;
     }
@@ -73,14 +74,9 @@ public:
      * @param position Struct to be overritten with position data.
      * @returns true if position data valid.
      */
-    bool getPosition(WorldPosition* position, uint32_t* positionTimestamp) {
+    bool getPosition(WorldPosition* position, int64_t* positionTimestamp) {
 
-        if (positionFifo_.available() == 0) return false;
-
-        positionFifo_.takeBack(position);
-        positionTimestampFifo_.takeBack(positionTimestamp);
-
-        return true;
+        return positionFifo_.pop(position, positionTimestamp);
 
     };
 
@@ -91,16 +87,27 @@ public:
      * @param position Struct to be overritten with position data.
      * @returns true if position data valid.
      */
-    bool peekPosition(WorldPosition* position, uint32_t* positionTimestamp) {
+    bool peekPosition(WorldPosition* position, int64_t* positionTimestamp) {
 
-        if (positionFifo_.available() == 0) return false;
+        return positionFifo_.peek(position, positionTimestamp);
 
-        positionFifo_.peekBack(position);
-        positionTimestampFifo_.peekBack(positionTimestamp);
+    }
 
-        return true;
+    /**
+     * Gives all pending position samples without copying them, oldest first.
+     * They stay in the queue and valid until removed with commitPositionSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekPositionSamples(SampleView<WorldPosition>* view) {return positionFifo_.peek(view);}
 
-    }
+    /**
+     * Removes the oldest samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitPositionSamples(const uint32_t &number) {positionFifo_.remove(number);}
 
     /**
      * @returns the Position accuracy. If unsupported or altitude not available will return -1;
@@ -117,7 +124,6 @@ public:
      */
     void flushPosition() {
         positionFifo_.clear();
-        positionTimestampFifo_.clear();
     }
 
     /**
@@ -141,14 +147,9 @@ public:
      * @param velocity is the velocity.
      * @returns true if position data valid.
      */
-    bool getVelocity(Vector* velocity, uint32_t* velocityTimestamp) {
-
-        if (velocityFifo_.available() == 0) return false;
+    bool getVelocity(Vector* velocity, int64_t* velocityTimestamp) {
 
-        velocityFifo_.takeBack(velocity);
-        velocityTimestampFifo_.takeBack(velocityTimestamp);
-
-        return true;
+        return velocityFifo_.pop(velocity, velocityTimestamp);
 
     };
 
@@ -159,23 +160,33 @@ public:
      * @param velocity is the velocity.
      * @returns true if position data valid.
      */
-    bool peekVelocity(Vector* velocity, uint32_t* velocityTimestamp) {
+    bool peekVelocity(Vector* velocity, int64_t* velocityTimestamp) {
 
-        if (velocityFifo_.available() == 0) return false;
+        return velocityFifo_.peek(velocity, velocityTimestamp);
 
-        velocityFifo_.peekBack(velocity);
-        velocityTimestampFifo_.peekBack(velocityTimestamp);
+    }
 
-        return true;
+    /**
+     * Gives all pending velocity samples without copying them, oldest first.
+     * They stay in the queue and valid until removed with commitVelocitySamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekVelocitySamples(SampleView<Vector>* view) {return velocityFifo_.peek(view);}
 
-    }
+    /**
+     * Removes the oldest samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitVelocitySamples(const uint32_t &number) {velocityFifo_.remove(number);}
 
     /**
      * Removes all elements from queue.
      */
     void flushVelocity() {
         velocityFifo_.clear();
-        velocityTimestampFifo_.clear();
     }
 
     /**
@@ -196,10 +207,9 @@ private:
     void _getData();
 
 
-    Buffer <WorldPosition, 10> positionFifo_;
-    Buffer <Vector, 10> velocityFifo_;
-    Buffer <uint32_t, 10> positionTimestampFifo_;
-    Buffer <uint32_t, 10> velocityTimestampFifo_;
+    //Filled by this task and emptied by navigation. Full drops new solutions, so views given to navigation stay valid.
+    SampleRing<WorldPosition, 16, eSampleLayout_t::eSampleLayout_Separate> positionFifo_;
+    SampleRing<Vector, 16, eSampleLayout_t::eSampleLayout_Separate> velocityFifo_;
 
     float positionDeviation_ = -1;
     float altitudeDeviation_ = -1;
@@ -213,7 +223,7 @@ private:
 
     bool lockValid_ = false;
 
-    IntervalControl rateCalcInterval_ = IntervalControl(1); 
+    RateControl rateCalcInterval_ = RateControl(1); 
     uint32_t lastMeasurement_ = 0;
 
     HardwareSerial* serialPort_;
@@ -222,6 +232,9 @@ private:
 
     SFE_UBLOX_GNSS gnss_;
 
+    //Position in the startup sequence.
+    TaskCoroutine initCoroutine_;
+
     uint8_t _startAttempts = 0;
 
     uint32_t loopRate_ = 0;
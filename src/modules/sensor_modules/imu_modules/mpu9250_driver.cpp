@@ -2,45 +2,320 @@
 
 
 
-uint32_t MPU9250Driver::_newDataTimestamp = 0;
-bool MPU9250Driver::_newDataInterrupt = false;
+SPSCRing<int64_t, 8, eRingOverflow_t::eRingOverflow_OverwriteOldest> MPU9250Driver::_dataReadyTimestamps;
+MPU9250Driver* MPU9250Driver::_driverInstance = nullptr;
+uint8_t MPU9250Driver::_traceInterruptId = TASK_TRACE_REGISTER("MPU9250 data ready");
 
 
 
-void MPU9250Driver::_getData() {
+void MPU9250Driver::_getData(const int64_t &timestamp) {
 
+    _bus->lock(_spiDevice);
     _imu.Read();
-
-    Vector bufVec(-_imu.gyro_x_radps(), _imu.gyro_y_radps(), -_imu.gyro_z_radps());
-    if (_lastGyro != bufVec) {
-        //Serial.println(String("Gyro: x:") + bufVec.x + ", y:" + bufVec.y + ", z:" + bufVec.z + ", Rate:" + _gyroRate);
-        _gyroFifo.placeFront(bufVec, true);
-        _gyroTimestampFifo.placeFront(_newDataTimestamp, true);
-        _lastGyro = bufVec;
+    _bus->unlock();
+
+    //Counts are placed as read, users convert them with the calibrations.
+    const int16_t* counts = _imu.gyro_counts();
+    RawVector sample(counts[0], counts[1], counts[2]);
+    if (_lastGyro != sample) {
+        _gyroFifo.push(sample, timestamp);
+        _lastGyro = sample;
         _gyroCounter++;
+        releaseDependentTasks();
     }
 
-    bufVec = Vector(-_imu.accel_x_mps2(), _imu.accel_y_mps2(), -_imu.accel_z_mps2());
-    if (_lastAccel != bufVec) {
-        _accelFifo.placeFront(bufVec, true);
-        _accelTimestampFifo.placeFront(_newDataTimestamp, true);
-        _lastAccel = bufVec;
+    counts = _imu.accel_counts();
+    sample = RawVector(counts[0], counts[1], counts[2]);
+    if (_lastAccel != sample) {
+        _accelFifo.push(sample, timestamp);
+        _lastAccel = sample;
         _accelCounter++;
     }
 
     if (_imu.MagnetometerFailed()) return; //Do not get mag data if mag failed to start.
 
-    bufVec = Vector(-_imu.mag_x_ut(), _imu.mag_y_ut(), -_imu.mag_z_ut());
-    if (_lastMag != bufVec) {
-        _magFifo.placeFront(bufVec, true);
-        _magTimestampFifo.placeFront(_newDataTimestamp, true);
-        _lastMag = bufVec;
+    counts = _imu.mag_counts();
+    sample = RawVector(counts[0], counts[1], counts[2]);
+    if (_lastMag != sample) {
+        _magFifo.push(sample, timestamp);
+        _lastMag = sample;
         _magCounter++;
     }
 
 }
 
 
+void MPU9250Driver::_getFifoData() {
+
+    if (_fifoReadDone) {
+
+        _fifoReadDone = false;
+
+        int16_t frames = _imu.ParseFifo(&_fifoDataRx[1], _fifoCount);
+
+        //A full FIFO can hold part of a frame, it is started again aligned.
+        if (_imu.fifo_overflowed()) {
+            _bus->lock(_spiDevice);
+            _imu.ResetFifo();
+            _bus->unlock();
+        }
+
+        _placeFifoSamples(frames, _fifoCountRead.doneTimestamp);
+
+        if (_magRead.status == eSPITransactionStatus_t::eSPITransactionStatus_Done) {
+
+            _imu.ParseMag(&_magRx[1]);
+
+            const int16_t* counts = _imu.mag_counts();
+            RawVector sample(counts[0], counts[1], counts[2]);
+            if (_lastMag != sample) {
+                _magFifo.push(sample, _magRead.doneTimestamp);
+                _lastMag = sample;
+                _magCounter++;
+            }
+
+        }
+
+        _fifoReadBusy = false;
+
+    }
+
+    if (!_fifoReadBusy && _fifoReadInterval.isTimeToRun()) {
+        _fifoReadBusy = true;
+        //Samples should be read before the next read is due. Mag has no deadline and goes after them.
+        int64_t deadline = NOW() + 1000000000LL/MPU9250_FIFO_READ_RATE;
+        _fifoCountRead.deadline = deadline;
+        _fifoDataRead.deadline = deadline;
+        _bus->submit(&_fifoCountRead);
+        if (!_imu.MagnetometerFailed()) _bus->submit(&_magRead); //Do not get mag data if mag failed to start.
+    }
+
+}
+
+
+void MPU9250Driver::_placeFifoSamples(const int16_t &frames, const int64_t &readTime) {
+
+    bool overflowed = _imu.fifo_overflowed();
+    if (overflowed) _fifoOverflows++;
+
+    if (frames > 0) {
+
+        //Newest sample was taken on average half an interval before the read, older ones are one interval apart.
+        int64_t firstEstimate = readTime - _fifoSampleInterval/2 - (frames - 1)*_fifoSampleInterval;
+        int64_t error = firstEstimate - _fifoNextTimestamp;
+        int64_t resyncLimit = MPU9250_FIFO_TIMESTAMP_RESYNC*_fifoSampleInterval;
+
+        //A full FIFO lost its newest samples, the oldest still follow the last read and keep their timestamps.
+        if (_fifoResync || !overflowed) {
+            if (_fifoResync || error > resyncLimit || error < -resyncLimit) _fifoNextTimestamp = firstEstimate;
+            //Follow the clock of the IMU and only slowly correct drift, so jitter of the read does not reach the timestamps.
+            else _fifoNextTimestamp += error/MPU9250_FIFO_TIMESTAMP_GAIN;
+        }
+
+        //Samples before a resync do not follow the new ones, filters and the accel phase start again.
+        if (_fifoResync) {
+            _gyroDecimator.reset();
+            _accelDecimator.reset();
+            _accelFramesLeft = 0;
+            _accelPhaseFrames = 0;
+            _accelPhaseKnown = _accelSampleRatio <= 1;
+        }
+
+        bool highRate = _readMode == eMPU9250ReadMode_t::eMPU9250ReadMode_FifoHighRate;
+        bool newGyro = false;
+
+        for (int16_t i = 0; i < frames; i++) {
+
+            int16_t counts[3];
+
+            _imu.fifo_gyro_counts(i, counts);
+            RawVector gyro(counts[0], counts[1], counts[2]);
+
+            _imu.fifo_accel_counts(i, counts);
+            RawVector accel(counts[0], counts[1], counts[2]);
+
+            //Accel can be sampled slower than gyro and is then repeated in the frames in between, so only every
+            //_accelSampleRatio frame has a new one. Which one is found from the first change after a resync.
+            //Values are not compared after that, as real samples can repeat, e.g. when still or saturated.
+            if (!_accelPhaseKnown) {
+                if (_accelPhaseFrames > 0 && accel != _lastAccel) {
+                    _accelPhaseKnown = true;
+                    _accelFramesLeft = 0;
+                } else if (++_accelPhaseFrames > _accelSampleRatio) _accelPhaseKnown = true; //No change, the phase stays a guess.
+            }
+            bool newAccel = _accelFramesLeft == 0;
+            if (newAccel) _accelFramesLeft = _accelSampleRatio;
+            _accelFramesLeft--;
+
+            if (highRate) {
+
+                _fullRateGyroFifo.push(gyro, _fifoNextTimestamp);
+                if (newAccel) _fullRateAccelFifo.push(accel, _fifoNextTimestamp);
+                _lastAccel = accel;
+
+                //Repeated accel values are what the sensor held, so both are filtered at the gyro rate.
+                //Filtering is done in counts and rounded back to whole counts, so the calibration and FIFOs stay the same.
+                //That is 0.06dps and 0.24mg at the configured ranges, well below the noise left after filtering.
+                Vector filtered;
+                int64_t filteredTimestamp;
+                if (_gyroDecimator.update(gyro.toVector(), _fifoNextTimestamp, &filtered, &filteredTimestamp)) {
+                    _lastGyro = RawVector::fromVector(filtered);
+                    _gyroFifo.push(_lastGyro, filteredTimestamp);
+                    _gyroCounter++;
+                    newGyro = true;
+                }
+                if (_accelDecimator.update(accel.toVector(), _fifoNextTimestamp, &filtered, &filteredTimestamp)) {
+                    _accelFifo.push(RawVector::fromVector(filtered), filteredTimestamp);
+                    _accelCounter++;
+                }
+
+            } else {
+
+                _gyroFifo.push(gyro, _fifoNextTimestamp);
+                _lastGyro = gyro;
+                _gyroCounter++;
+                newGyro = true;
+
+                if (newAccel) {
+                    _accelFifo.push(accel, _fifoNextTimestamp);
+                    _accelCounter++;
+                }
+                _lastAccel = accel;
+
+            }
+
+            _fifoNextTimestamp += _fifoSampleInterval;
+
+        }
+
+        if (newGyro) releaseDependentTasks();
+
+    }
+
+    //FIFO was reset after overflowing, next samples start fresh.
+    _fifoResync = overflowed;
+
+}
+
+
+
+
+void MPU9250Driver::_setupFifoReads() {
+
+    _fifoCountTx[0] = _imu.fifo_count_read_cmd();
+    _fifoDataTx[0] = _imu.fifo_read_cmd();
+    _magTx[0] = _imu.mag_read_cmd();
+
+    SPITransaction* reads[] = {&_fifoCountRead, &_fifoDataRead, &_magRead};
+    for (SPITransaction* read : reads) {
+        read->device = _spiDevice;
+        read->context = this;
+    }
+
+    _fifoCountRead.txBuffer = _fifoCountTx;
+    _fifoCountRead.rxBuffer = _fifoCountRx;
+    _fifoCountRead.length = sizeof(_fifoCountTx);
+    _fifoCountRead.callback = _fifoCountReadDone;
+
+    //Length is set once the count is known.
+    _fifoDataRead.txBuffer = _fifoDataTx;
+    _fifoDataRead.rxBuffer = _fifoDataRx;
+    _fifoDataRead.callback = _fifoDataReadDone;
+
+    _magRead.txBuffer = _magTx;
+    _magRead.rxBuffer = _magRx;
+    _magRead.length = sizeof(_magTx);
+
+    _fifoReadBusy = false;
+    _fifoReadDone = false;
+
+}
+
+
+void MPU9250Driver::_fifoCountReadDone(SPITransaction* transaction) {
+
+    MPU9250Driver* driver = (MPU9250Driver*)transaction->context;
+
+    uint16_t count = 0;
+    if (transaction->status == eSPITransactionStatus_t::eSPITransactionStatus_Done) count = driver->_imu.ParseFifoCount(&driver->_fifoCountRx[1]);
+
+    //Only whole frames are read, the rest is read next time.
+    uint8_t frameSize = driver->_imu.fifo_frame_size();
+    uint16_t bytes = frameSize == 0 ? 0 : count/frameSize*frameSize;
+
+    driver->_fifoCount = count;
+
+    if (bytes > 0) {
+        driver->_fifoDataRead.length = bytes + 1;
+        if (driver->_bus->submit(&driver->_fifoDataRead)) return;
+        driver->_fifoCount = 0;
+    }
+
+    driver->_fifoReadDone = true;
+    driver->notifyFromISR();
+
+}
+
+
+void MPU9250Driver::_fifoDataReadDone(SPITransaction* transaction) {
+
+    MPU9250Driver* driver = (MPU9250Driver*)transaction->context;
+
+    if (transaction->status != eSPITransactionStatus_t::eSPITransactionStatus_Done) driver->_fifoCount = 0;
+
+    driver->_fifoReadDone = true;
+    driver->notifyFromISR();
+
+}
+
+
+void MPU9250Driver::_setupCalibration() {
+
+    //Library turns the IMU axes into x = counts[1], y = counts[0], z = -counts[2]. x and z are flipped on top for the board.
+    float gyroScale = _imu.gyro_scale_radps();
+    _gyroCalibration = SensorCalibration(1, 0, 2, Vector(-gyroScale, gyroScale, gyroScale));
+
+    float accelScale = _imu.accel_scale_mps2();
+    _accelCalibration = SensorCalibration(1, 0, 2, Vector(-accelScale, accelScale, accelScale));
+
+    //Mag axes are used as the library gives them, with x and z flipped for the board.
+    _magCalibration = SensorCalibration(0, 1, 2, Vector(-_imu.mag_scale_ut(0), _imu.mag_scale_ut(1), -_imu.mag_scale_ut(2)));
+
+}
+
+
+uint8_t MPU9250Driver::_getAccelSampleRatio() {
+
+    //Accel runs at 4kHz without its DLPF and at 1kHz with it. Other DLPF settings use the sample rate divider for both.
+    switch (_imu.dlpf()) {
+    case Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_DISABLE_32kHz:
+    case Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_250HZ_4kHz:
+        return 8;
+    case Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_3600HZ_8kHz:
+        return 2;
+    default:
+        return 1;
+    }
+
+}
+
+
+int64_t MPU9250Driver::_getSampleInterval() {
+
+    //Gyro runs at 32kHz without DLPF and 8kHz with the 250Hz or 3600Hz one. Only the other DLPF settings use the sample rate divider.
+    switch (_imu.dlpf()) {
+    case Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_DISABLE_32kHz:
+        return SECONDS/32000;
+    case Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_250HZ_4kHz:
+    case Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_3600HZ_8kHz:
+        return SECONDS/8000;
+    default:
+        return MILLISECONDS*(1 + _imu.srd());
+    }
+
+}
+
+
 void MPU9250Driver::thread() {
 
     if (_block) return;
@@ -48,15 +323,18 @@ void MPU9250Driver::thread() {
     _loopCounter++;
 
 
-    if (moduleStatus_ == eModuleStatus_t::eModuleStatus_Running) {
+    if (moduleStatus_ == eModuleStatus_t::eModuleStatus_Running && _readMode != eMPU9250ReadMode_t::eMPU9250ReadMode_DataReady) {
 
-        if (_newDataInterrupt) { //If true then data is ready in the imu FIFO
-            _newDataInterrupt = false;
+        _getFifoData();
 
-            _getData();
-            
+    } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_Running) {
 
-        }
+        //Only the newest interrupt matters, the IMU already replaced the data of older ones.
+        int64_t timestamp;
+        bool newData = false;
+        while (_dataReadyTimestamps.pop(&timestamp)) newData = true;
+
+        if (newData) _getData(timestamp);
 
     } else if (moduleStatus_ == eModuleStatus_t::eModuleStatus_NotStarted || moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) {
         
@@ -103,14 +381,18 @@ void MPU9250Driver::thread() {
 
 
 void MPU9250Driver::_interruptRoutine() {
-    _newDataInterrupt = true;
-    _newDataTimestamp = micros();
+    TASK_TRACE_ISR_BEGIN(_traceInterruptId);
+    _dataReadyTimestamps.push(NOW());
+    if (_driverInstance != nullptr) _driverInstance->notifyFromISR();
+    TASK_TRACE_ISR_END(_traceInterruptId);
 }
 
 
 
 void MPU9250Driver::init() {
 
+    _bus->lock(_spiDevice);
+
     //Serial.println("Test1");
     int startCode = _imu.Begin();
     //Serial.println("Test2");
@@ -122,13 +404,26 @@ void MPU9250Driver::init() {
 
         _imu.ConfigAccelRange(Mpu9250::AccelRange::ACCEL_RANGE_8G);
         _imu.ConfigGyroRange(Mpu9250::GyroRange::GYRO_RANGE_2000DPS);
-        _imu.EnableDrdyInt();
+        _setupCalibration();
+        if (_readMode == eMPU9250ReadMode_t::eMPU9250ReadMode_DataReady) _imu.EnableDrdyInt();
 
         _imu.ConfigSrd(0);
-        _imu.ConfigDlpf(Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_250HZ_4kHz);
-
-
-        attachInterrupt(imuINTPin_, _interruptRoutine, RISING);
+        //High rate mode filters on the MCU instead.
+        if (_readMode == eMPU9250ReadMode_t::eMPU9250ReadMode_FifoHighRate) _imu.ConfigDlpf(Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_3600HZ_8kHz);
+        else _imu.ConfigDlpf(Mpu9250::DlpfBandwidth::DLPF_BANDWIDTH_250HZ_4kHz);
+
+
+        if (_readMode != eMPU9250ReadMode_t::eMPU9250ReadMode_DataReady) {
+            _imu.EnableFifo(true, true);
+            _gyroDecimator.configure(MPU9250_DECIMATION_FACTOR, MPU9250_DECIMATION_TAPS);
+            _accelDecimator.configure(MPU9250_DECIMATION_FACTOR, MPU9250_DECIMATION_TAPS);
+            _fifoSampleInterval = _getSampleInterval();
+            _accelSampleRatio = _getAccelSampleRatio();
+            _fifoResync = true;
+            _setupFifoReads();
+        } else {
+            attachInterrupt(imuINTPin_, _interruptRoutine, RISING);
+        }
 
         _lastMeasurement = micros();
         
@@ -141,6 +436,8 @@ void MPU9250Driver::init() {
         Serial.println("NEW! IMU Start Fail. Code: " + String(startCode));
     }
 
+    _bus->unlock();
+
     _startAttempts++;
 
     if (_startAttempts >= 5 && moduleStatus_ == eModuleStatus_t::eModuleStatus_RestartAttempt) moduleStatus_ = eModuleStatus_t::eModuleStatus_Failure;
@@ -15,15 +15,84 @@
 
 #include "lib/MPU9250_Lib/src/mpu9250.h"
 
-#include "utils/buffer.h"
+#include "utils/spsc_ring.h"
+#include "utils/sample_ring.h"
+#include "utils/sensor_timestamp.h"
+#include "utils/system_time.h"
+#include "utils/spi_bus.h"
+#include "utils/fir_decimator.h"
+#include "utils/sensor_calibration.h"
+
+
+
+//Number of samples kept for every sensor. Must be a power of 2.
+#define MPU9250_FIFO_SIZE 128
+
+//If no data ready interrupt came for this long, the thread is run anyways. In microseconds.
+#define MPU9250_EVENT_TIMEOUT_US 10000
+
+//Rate in Hz the FIFO of the IMU is read at with the FIFO read modes. Its 512 bytes hold 42 samples, 5ms at 8kHz.
+#define MPU9250_FIFO_READ_RATE 1000
+
+//SPI clock in Hz for reading samples. Settings are written at 1MHz by the library.
+#define MPU9250_SPI_READ_CLOCK 20000000
+
+//Number of full rate samples kept for every sensor with eMPU9250ReadMode_FifoHighRate. Must be a power of 2.
+#define MPU9250_FULL_RATE_FIFO_SIZE 256
+
+//With eMPU9250ReadMode_FifoHighRate: full rate samples per filtered one. 4 gives gyro and accel at 2kHz.
+#define MPU9250_DECIMATION_FACTOR 4
+
+//Length of the low pass filter before decimating. Longer filters keep more aliasing out but delay samples more.
+#define MPU9250_DECIMATION_TAPS 33
+
+//Timestamps of FIFO samples are moved this fraction of their error towards the read time every read.
+#define MPU9250_FIFO_TIMESTAMP_GAIN 16
+
+//If the timestamps of FIFO samples are off by more samples than this, they are started again from the read time.
+#define MPU9250_FIFO_TIMESTAMP_RESYNC 4
+
+
+
+/**
+ * How the driver gets samples from the IMU.
+ */
+enum eMPU9250ReadMode_t {
+    //Reads all registers on every data ready interrupt. Samples are lost if the task runs late.
+    eMPU9250ReadMode_DataReady,
+    //Gyro and accel are placed into the FIFO of the IMU, which is read in bursts at MPU9250_FIFO_READ_RATE.
+    //Every sample of the output data rate is kept and timestamped. Mag is read with every burst.
+    //Reads are done by DMA over the SPIBus, the task only sorts the samples once they arrived.
+    eMPU9250ReadMode_Fifo,
+    //Like eMPU9250ReadMode_Fifo, but gyro at 8kHz and accel at 4kHz without the DLPF of the IMU.
+    //Full rate samples are low pass filtered and decimated by MPU9250_DECIMATION_FACTOR for the sensor interfaces.
+    //They are also kept unfiltered, e.g. for vibration analysis. See peekFullRateGyroSamples().
+    eMPU9250ReadMode_FifoHighRate
+};
 
 
 
 class MPU9250Driver: public Gyroscope_Interface, public Accelerometer_Interface, public Magnetometer_Interface, public Module_Abstract, public Task_Abstract {
 public:
 
-    MPU9250Driver(int interruptPin, int chipSelect, SPIClass* spiBus) : Task_Abstract(35000, eTaskPriority_t::eTaskPriority_Realtime, true), _imu(spiBus, chipSelect) {
+    /**
+     * @param interruptPin is the pin the data ready interrupt is connected to. Only used with eMPU9250ReadMode_DataReady.
+     * @param chipSelect is the chip select pin of the IMU.
+     * @param spiBus is the bus the IMU is on.
+     * @param readMode is of type eMPU9250ReadMode_t.
+     */
+    MPU9250Driver(int interruptPin, int chipSelect, SPIClass* spiBus, const eMPU9250ReadMode_t &readMode = eMPU9250ReadMode_t::eMPU9250ReadMode_DataReady) : Task_Abstract(0, eTaskPriority_t::eTaskPriority_Realtime), _imu(spiBus, chipSelect) {
+        setTaskName("MPU9250Driver");
         imuINTPin_ = interruptPin;
+        _readMode = readMode;
+        _bus = SPIBus::getBus(spiBus);
+        //IMU samples are lost if the FIFO is not read in time, so it goes ahead of the other devices.
+        _spiDevice = _bus->addDevice(chipSelect, MPU9250_SPI_READ_CLOCK, SPI_MODE3, eSPIPriority_t::eSPIPriority_High);
+        _driverInstance = this;
+        //Runs when the data ready interrupt fires or a FIFO read arrived. Timeout keeps start attempts, FIFO reads and rate calculation going.
+        if (_readMode != eMPU9250ReadMode_t::eMPU9250ReadMode_DataReady) setTaskEventTimeout(1000000/MPU9250_FIFO_READ_RATE);
+        else setTaskEventTimeout(MPU9250_EVENT_TIMEOUT_US);
+        startTaskThreading();
     }
     
     /**
@@ -50,6 +119,15 @@ public:
      */
     uint32_t loopRate() {return _loopRate;};
 
+    /**
+     * Returns how often the FIFO of the IMU was full when read and samples were lost.
+     * Only counts with the FIFO read modes.
+     *
+     * @param values none.
+     * @return uint32_t.
+     */
+    uint32_t fifoOverflows() {return _fifoOverflows;};
+
     /**
      * Returns true if gyro data available
      *
@@ -71,15 +149,15 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool getGyro(Vector* gyroData, uint32_t* gyroTimestamp) {
+    bool getGyro(Vector* gyroData, int64_t* gyroTimestamp) {
 
-        if (_gyroFifo.available() == 0) return false;
+        RawVector sample;
+        if (!_gyroFifo.pop(&sample, gyroTimestamp)) return false;
 
-        _gyroFifo.takeBack(gyroData);
-        _gyroTimestampFifo.takeBack(gyroTimestamp);
+        *gyroData = _gyroCalibration.apply(sample);
 
         return true;
 
@@ -90,20 +168,45 @@ public:
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool peekGyro(Vector* gyroData, uint32_t* gyroTimestamp) {
+    bool peekGyro(Vector* gyroData, int64_t* gyroTimestamp) {
 
-        if (_gyroFifo.available() == 0) return false;
+        RawVector sample;
+        if (!_gyroFifo.peek(&sample, gyroTimestamp)) return false;
 
-        _gyroFifo.peekBack(gyroData);
-        _gyroTimestampFifo.peekBack(gyroTimestamp);
+        *gyroData = _gyroCalibration.apply(sample);
 
         return true;
 
     }
 
+    /**
+     * Returns how to turn raw gyro samples into values in the board axes.
+     *
+     * @param values none.
+     * @return SensorCalibration.
+     */
+    const SensorCalibration& gyroCalibration() {return _gyroCalibration;}
+
+    /**
+     * Gives all pending gyro samples without copying them, oldest first, as raw counts.
+     * Values are calculated with gyroCalibration().
+     * They stay in the queue and valid until removed with commitGyroSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekGyroSamples(SampleView<RawVector>* view) {return _gyroFifo.peek(view);}
+
+    /**
+     * Removes the oldest samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitGyroSamples(const uint32_t &number) {_gyroFifo.remove(number);}
+
     /**
      * Removes all elements from queue.
      *
@@ -112,7 +215,6 @@ public:
      */
     void flushGyro() {
         _gyroFifo.clear();
-        _gyroTimestampFifo.clear();
     }
 
     /**
@@ -136,15 +238,15 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool getAccel(Vector* accelData, uint32_t* accelTimestamp) {
+    bool getAccel(Vector* accelData, int64_t* accelTimestamp) {
 
-        if (_accelFifo.available() == 0) return false;
+        RawVector sample;
+        if (!_accelFifo.pop(&sample, accelTimestamp)) return false;
 
-        _accelFifo.takeBack(accelData);
-        _accelTimestampFifo.takeBack(accelTimestamp);
+        *accelData = _accelCalibration.apply(sample);
 
         return true;
 
@@ -155,20 +257,45 @@ public:
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool peekAccel(Vector* accelData, uint32_t* accelTimestamp) {
+    bool peekAccel(Vector* accelData, int64_t* accelTimestamp) {
 
-        if (_accelFifo.available() == 0) return false;
+        RawVector sample;
+        if (!_accelFifo.peek(&sample, accelTimestamp)) return false;
 
-        _accelFifo.peekBack(accelData);
-        _accelTimestampFifo.peekBack(accelTimestamp);
+        *accelData = _accelCalibration.apply(sample);
 
         return true;
 
     };
 
+    /**
+     * Returns how to turn raw accel samples into values in the board axes.
+     *
+     * @param values none.
+     * @return SensorCalibration.
+     */
+    const SensorCalibration& accelCalibration() {return _accelCalibration;}
+
+    /**
+     * Gives all pending accel samples without copying them, oldest first, as raw counts.
+     * Values are calculated with accelCalibration().
+     * They stay in the queue and valid until removed with commitAccelSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekAccelSamples(SampleView<RawVector>* view) {return _accelFifo.peek(view);}
+
+    /**
+     * Removes the oldest samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitAccelSamples(const uint32_t &number) {_accelFifo.remove(number);}
+
     /**
      * Removes all elements from queue.
      *
@@ -177,7 +304,6 @@ public:
      */
     void flushAccel() {
         _accelFifo.clear();
-        _accelTimestampFifo.clear();
     }
 
     /**
@@ -201,15 +327,15 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool getMag(Vector* magData, uint32_t* magTimestamp) {
+    bool getMag(Vector* magData, int64_t* magTimestamp) {
 
-        if (_magFifo.available() == 0) return false;
+        RawVector sample;
+        if (!_magFifo.pop(&sample, magTimestamp)) return false;
 
-        _magFifo.takeBack(magData);
-        _magTimestampFifo.takeBack(magTimestamp);
+        *magData = _magCalibration.apply(sample);
 
         return true;
 
@@ -220,20 +346,45 @@ public:
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    bool peekMag(Vector* magData, uint32_t* magTimestamp) {
+    bool peekMag(Vector* magData, int64_t* magTimestamp) {
 
-        if (_magFifo.available() == 0) return false;
+        RawVector sample;
+        if (!_magFifo.peek(&sample, magTimestamp)) return false;
 
-        _magFifo.peekBack(magData);
-        _magTimestampFifo.peekBack(magTimestamp);
+        *magData = _magCalibration.apply(sample);
 
         return true;
 
     };
 
+    /**
+     * Returns how to turn raw mag samples into values in the board axes.
+     *
+     * @param values none.
+     * @return SensorCalibration.
+     */
+    const SensorCalibration& magCalibration() {return _magCalibration;}
+
+    /**
+     * Gives all pending mag samples without copying them, oldest first, as raw counts.
+     * Values are calculated with magCalibration().
+     * They stay in the queue and valid until removed with commitMagSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekMagSamples(SampleView<RawVector>* view) {return _magFifo.peek(view);}
+
+    /**
+     * Removes the oldest samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitMagSamples(const uint32_t &number) {_magFifo.remove(number);}
+
     /**
      * Removes all elements from queue.
      *
@@ -241,33 +392,171 @@ public:
      * @return none.
      */
     void flushMag() {
-        _accelFifo.clear();
-        _accelTimestampFifo.clear();
+        _magFifo.clear();
     }
 
+    /**
+     * Returns number of unfiltered full rate gyro samples available.
+     * Only filled with eMPU9250ReadMode_FifoHighRate.
+     *
+     * @param values none.
+     * @return uint32_t.
+     */
+    uint32_t fullRateGyroAvailable() {return _fullRateGyroFifo.available();};
+
+    /**
+     * Gives all pending unfiltered full rate gyro samples without copying them, oldest first, as raw counts.
+     * Values are calculated with gyroCalibration().
+     * They stay in the queue and valid until removed with commitFullRateGyroSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekFullRateGyroSamples(SampleView<RawVector>* view) {return _fullRateGyroFifo.peek(view);}
+
+    /**
+     * Removes the oldest unfiltered gyro samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitFullRateGyroSamples(const uint32_t &number) {_fullRateGyroFifo.remove(number);}
+
+    /**
+     * Returns number of unfiltered full rate accel samples available.
+     * Only filled with eMPU9250ReadMode_FifoHighRate.
+     *
+     * @param values none.
+     * @return uint32_t.
+     */
+    uint32_t fullRateAccelAvailable() {return _fullRateAccelFifo.available();};
+
+    /**
+     * Gives all pending unfiltered full rate accel samples without copying them, oldest first, as raw counts.
+     * Values are calculated with accelCalibration().
+     * They stay in the queue and valid until removed with commitFullRateAccelSamples().
+     *
+     * @param view is overwritten with the samples.
+     * @returns number of samples in the view.
+     */
+    uint32_t peekFullRateAccelSamples(SampleView<RawVector>* view) {return _fullRateAccelFifo.peek(view);}
+
+    /**
+     * Removes the oldest unfiltered accel samples from queue.
+     *
+     * @param number of samples to remove.
+     */
+    void commitFullRateAccelSamples(const uint32_t &number) {_fullRateAccelFifo.remove(number);}
+
 
 private:
 
     static void _interruptRoutine();
 
-    void _getData();
+    void _getData(const int64_t &timestamp);
 
+    /**
+     * Sorts samples of a finished FIFO read and starts the next read once due.
+     */
+    void _getFifoData();
 
-    Buffer <Vector, 100> _gyroFifo;
-    Buffer <Vector, 100> _accelFifo;
-    Buffer <Vector, 100> _magFifo;
-    Buffer <uint32_t, 100> _gyroTimestampFifo;
-    Buffer <uint32_t, 100> _accelTimestampFifo;
-    Buffer <uint32_t, 100> _magTimestampFifo;
+    /**
+     * Timestamps the samples of a FIFO read and places them into the FIFOs.
+     *
+     * @param frames is the number of samples read.
+     * @param readTime is when the FIFO count was read, in nanoseconds.
+     */
+    void _placeFifoSamples(const int16_t &frames, const int64_t &readTime);
 
-    Vector _lastGyro;
-    Vector _lastAccel;
-    Vector _lastMag;
+    /**
+     * Sets up the transactions for reading the FIFO and mag over the bus.
+     */
+    void _setupFifoReads();
+
+    static void _fifoCountReadDone(SPITransaction* transaction);
 
-    IntervalControl _rateCalcInterval = IntervalControl(1); 
+    static void _fifoDataReadDone(SPITransaction* transaction);
+
+    /**
+     * Sets the calibrations from the ranges and axes of the IMU.
+     */
+    void _setupCalibration();
+
+    /**
+     * @returns time between samples of the IMU in nanoseconds for its current configuration.
+     */
+    int64_t _getSampleInterval();
+
+    /**
+     * @returns number of FIFO frames per new accel sample for the current configuration of the IMU.
+     */
+    uint8_t _getAccelSampleRatio();
+
+
+    //Filled by this task with raw counts and emptied by navigation. Full FIFOs drop new samples, so views given to navigation stay valid.
+    SampleRing<RawVector, MPU9250_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Separate> _gyroFifo;
+    SampleRing<RawVector, MPU9250_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Separate> _accelFifo;
+    SampleRing<RawVector, MPU9250_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Separate> _magFifo;
+
+    //Unfiltered full rate samples with eMPU9250ReadMode_FifoHighRate. Full FIFOs drop new samples, so whoever
+    //uses this mode has to commit every view or the FIFOs stop taking samples after MPU9250_FULL_RATE_FIFO_SIZE.
+    SampleRing<RawVector, MPU9250_FULL_RATE_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Separate> _fullRateGyroFifo;
+    SampleRing<RawVector, MPU9250_FULL_RATE_FIFO_SIZE, eSampleLayout_t::eSampleLayout_Separate> _fullRateAccelFifo;
+
+    //Filter full rate samples down for the sensor FIFOs with eMPU9250ReadMode_FifoHighRate. Output is rounded to whole counts.
+    FIRDecimator<MPU9250_DECIMATION_TAPS> _gyroDecimator;
+    FIRDecimator<MPU9250_DECIMATION_TAPS> _accelDecimator;
+
+    RawVector _lastGyro;
+    RawVector _lastAccel;
+    RawVector _lastMag;
+
+    //Turn the raw counts in the FIFOs into values. Set once the ranges are configured.
+    SensorCalibration _gyroCalibration;
+    SensorCalibration _accelCalibration;
+    SensorCalibration _magCalibration;
+
+    RateControl _rateCalcInterval = RateControl(1); 
 
     int imuINTPin_ = 0;
 
+    eMPU9250ReadMode_t _readMode = eMPU9250ReadMode_t::eMPU9250ReadMode_DataReady;
+
+    //Time between samples in the FIFO and timestamp the next one should get. In nanoseconds.
+    int64_t _fifoSampleInterval = 0;
+    int64_t _fifoNextTimestamp = 0;
+    //Set if the next samples do not follow the last ones, e.g. after starting or a full FIFO.
+    bool _fifoResync = true;
+    //FIFO frames per new accel sample and frames until the next one.
+    uint8_t _accelSampleRatio = 1;
+    uint8_t _accelFramesLeft = 0;
+    //Set once the frame of new accel samples is known. Frames looked at since the resync until then.
+    bool _accelPhaseKnown = true;
+    uint8_t _accelPhaseFrames = 0;
+    uint32_t _fifoOverflows = 0;
+
+    //Shared with the other devices on the bus. Library calls must lock it.
+    SPIBus* _bus = nullptr;
+    SPIDevice* _spiDevice = nullptr;
+
+    //FIFO count is read first, its callback reads all whole frames. Mag is read next to it.
+    SPITransaction _fifoCountRead;
+    SPITransaction _fifoDataRead;
+    SPITransaction _magRead;
+    uint8_t _fifoCountTx[3] = {0};
+    uint8_t _fifoCountRx[3] = {0};
+    uint8_t _magTx[7] = {0};
+    uint8_t _magRx[7] = {0};
+    //One command byte and up to the whole FIFO. Aligned for the cache of the DMA.
+    alignas(32) uint8_t _fifoDataTx[513] = {0};
+    alignas(32) uint8_t _fifoDataRx[513];
+    //Bytes in the FIFO when the count was read.
+    volatile uint16_t _fifoCount = 0;
+    //Set while a read is submitted and its samples not sorted yet.
+    bool _fifoReadBusy = false;
+    //Set by the interrupt once all data of a read arrived.
+    volatile bool _fifoReadDone = false;
+    RateControl _fifoReadInterval = RateControl(MPU9250_FIFO_READ_RATE);
+
     Mpu9250 _imu;
 
     uint8_t _startAttempts = 0;
@@ -288,8 +577,14 @@ private:
 
     bool _block = false;
 
-    static uint32_t _newDataTimestamp;
-    static bool _newDataInterrupt;
+    //Times of data ready interrupts. Filled by the interrupt and emptied by the task. Only the newest is used, so full overwrites the oldest.
+    static SPSCRing<int64_t, 8, eRingOverflow_t::eRingOverflow_OverwriteOldest> _dataReadyTimestamps;
+
+    //Used by the interrupt to notify the task.
+    static MPU9250Driver* _driverInstance;
+
+    //Id of the interrupt in the scheduler trace.
+    static uint8_t _traceInterruptId;
 
 
 
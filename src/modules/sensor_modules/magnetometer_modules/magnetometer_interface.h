@@ -5,6 +5,10 @@
 
 #include "lib/Math-Helper/src/3d_math.h"
 
+#include "utils/system_time.h"
+#include "utils/sensor_timestamp.h"
+#include "utils/sensor_calibration.h"
+
 
 
 class Magnetometer_Interface {
@@ -39,20 +43,45 @@ public:
      * Variables given as parameters will be overridden.
      * This will remove sensor data from queue, peek will not.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    virtual bool getMag(Vector* magData, uint32_t* magTimestamp) = 0;
+    virtual bool getMag(Vector* magData, int64_t* magTimestamp) = 0;
 
     /**
      * Returns true if Magnetometer data valid.
      * Variables given as parameters will be overridden.
      * Will not remove data from queue, get will.
      *
-     * @param values Vector and uint32_t.
+     * @param values Vector and int64_t timestamp in nanoseconds.
      * @return bool.
      */
-    virtual bool peekMag(Vector* magData, uint32_t* magTimestamp) = 0;
+    virtual bool peekMag(Vector* magData, int64_t* magTimestamp) = 0;
+
+    /**
+     * Returns how to turn raw mag samples into values.
+     *
+     * @param values none.
+     * @return SensorCalibration.
+     */
+    virtual const SensorCalibration& magCalibration() = 0;
+
+    /**
+     * Gives all pending mag samples without copying them, oldest first, as raw counts.
+     * Values are calculated with magCalibration(), e.g. by CalibratedSamples.
+     * They stay in the queue and valid until removed with commitMagSamples().
+     *
+     * @param view is overwritten with the samples. They can be split into two segments.
+     * @returns number of samples in the view.
+     */
+    virtual uint32_t peekMagSamples(SampleView<RawVector>* view) = 0;
+
+    /**
+     * Removes the oldest samples from queue, e.g. the ones of the last peekMagSamples().
+     *
+     * @param number of samples to remove.
+     */
+    virtual void commitMagSamples(const uint32_t &number) = 0;
 
     /**
      * Removes all elements from queue.
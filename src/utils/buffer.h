@@ -13,11 +13,134 @@
 #include "math.h"
 
 
+/**
+ * Default statistics policy of Buffer. Keeps nothing, so sum, average and deviation
+ * are calculated from all elements every time they are asked for.
+ */
+template<typename T>
+class BufferStatsNone {
+public:
+
+    static constexpr bool running = false;
+
+    inline void add(const T &/*element*/, const uint32_t &/*numElements*/) {}
+    inline void remove(const T &/*element*/, const uint32_t &/*numElements*/) {}
+    inline void reset() {}
+    template<typename Buffer_>
+    inline void update(const Buffer_ &/*buffer*/) {}
+
+    inline T getMean() const {return T();}
+    inline T getSquaredDiffSum() const {return T();}
+
+};
+
+
+/**
+ * Statistics policy of Buffer that keeps the mean and the sum of squared differences
+ * up to date with every element placed or removed (Welford's algorithm with removal).
+ * Sum, average, deviation and error are then O(1).
+ * Rounding errors add up with every update, so every resumInterval_ updates they are
+ * calculated again from the elements. Meant for float and double.
+ *
+ * e.g:
+ *
+ * Buffer<float, 200, BufferStatsRunning<float>> gyroNoise;
+ * gyroNoise.placeFront(gyro, true);
+ * float noise = gyroNoise.getStandardDeviation();
+ */
+template<typename T, uint32_t resumInterval_ = 1024>
+class BufferStatsRunning {
+public:
+
+    static constexpr bool running = true;
+
+    /**
+     * @param element was placed.
+     * @param numElements in the buffer after placing.
+     */
+    inline void add(const T &element, const uint32_t &numElements) {
+
+        T diff = element - mean_;
+        mean_ = mean_ + diff/numElements;
+        squaredDiffSum_ = squaredDiffSum_ + diff*(element - mean_);
+        updates_++;
+
+    }
+
+    /**
+     * @param element was removed.
+     * @param numElements in the buffer after removing.
+     */
+    inline void remove(const T &element, const uint32_t &numElements) {
+
+        if (numElements == 0) {
+            reset();
+            return;
+        }
+
+        T diff = element - mean_;
+        mean_ = mean_ - diff/numElements;
+        squaredDiffSum_ = squaredDiffSum_ - diff*(element - mean_);
+        //Rounding can make it slightly negative if all elements are the same.
+        if (squaredDiffSum_ < T()) squaredDiffSum_ = T();
+        updates_++;
+
+    }
+
+    inline void reset() {
+        mean_ = squaredDiffSum_ = T();
+        updates_ = 0;
+    }
+
+    /**
+     * Called by the buffer after every add() and remove(). Calculates the statistics
+     * again from all elements every resumInterval_ updates so rounding errors dont add up.
+     *
+     * @param buffer the statistics are kept for.
+     */
+    template<typename Buffer_>
+    inline void update(const Buffer_ &buffer) {
+
+        if (updates_ < resumInterval_) return;
+
+        uint32_t numElements = buffer.available();
+
+        T sum = 0;
+        for (uint32_t i = 0; i < numElements; i++) sum = sum + buffer[i];
+        mean_ = numElements == 0 ? T() : sum/numElements;
+
+        squaredDiffSum_ = 0;
+        for (uint32_t i = 0; i < numElements; i++) {
+            T diff = buffer[i] - mean_;
+            squaredDiffSum_ = squaredDiffSum_ + diff*diff;
+        }
+
+        updates_ = 0;
+
+    }
+
+    inline T getMean() const {return mean_;}
+    inline T getSquaredDiffSum() const {return squaredDiffSum_;}
+
+
+private:
+
+    T mean_ = T();
+    //Sum of (element - mean)^2 over all elements.
+    T squaredDiffSum_ = T();
+    uint32_t updates_ = 0;
+
+};
+
+
+
 /**
  * Buffer class that can be used as queue or stack.
  * Can also be used to sort values and calculate median, average, deviation.
+ * Stats_ is BufferStatsNone or BufferStatsRunning. The second keeps sum, average and
+ * deviation up to date while elements are placed and removed, so getting them is O(1).
  */
-template<typename T, uint32_t size_> 
+template<typename T, uint32_t size_, typename Stats_ = BufferStatsNone<T>>
 class Buffer {
 public:
 
@@ -148,7 +271,8 @@ public:
     inline void sortElements();
 
     /**
-     * Sorts elements and returns median.
+     * Sorts a copy of the elements and returns median. O(n log n) every call,
+     * MedianFilter in utils/median_filter.h is faster for a sliding window.
      * @return median.
      */
     inline T getMedian() const;
@@ -172,6 +296,12 @@ public:
      */
     inline T& operator[] (const uint32_t &index);
 
+    /**
+     * Same as above for const buffers.
+     * @returns copy of element from index.
+     */
+    inline const T& operator[] (const uint32_t &index) const;
+
     /**
      * Needs to be overloaded to also copy the data to instance.
      * Not doing this will cause 2 buffers to share the exact same elements.
@@ -186,6 +316,12 @@ public:
 
 private:
 
+    /**
+     * Updates the statistics after an element was placed or removed.
+     */
+    inline void statsAdd(const T &element);
+    inline void statsRemove(const T &element);
+
     inline void quickSort(const uint32_t &left, const uint32_t &right);
 
     inline uint32_t quickSortPartition(const uint32_t &left, const uint32_t &right);
@@ -201,23 +337,27 @@ private:
     //Points to index of last element
     uint32_t back_ = 0;
 
+    Stats_ stats_;
+
 
 };
 
 
 
-template<typename T, uint32_t size_> 
-inline T Buffer<T, size_>::getStandardError() const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline T Buffer<T, size_, Stats_>::getStandardError() const {
     if (numElements_ < 2) return T();
     return getStandardDeviation()/sqrtf(numElements_);
 }
 
 
-template<typename T, uint32_t size_> 
-inline T Buffer<T, size_>::getStandardDeviation() const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline T Buffer<T, size_, Stats_>::getStandardDeviation() const {
 
     if (numElements_ < 2) return T();
 
+    if (Stats_::running) return sqrtf(stats_.getSquaredDiffSum()/(numElements_-1));
+
     T standardDev = 0;
 
     T avg = getAverage();
@@ -237,8 +377,8 @@ inline T Buffer<T, size_>::getStandardDeviation() const {
 }
 
 
-template<typename T, uint32_t size_> 
-inline T Buffer<T, size_>::getMedian() const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline T Buffer<T, size_, Stats_>::getMedian() const {
 
     if (numElements_ == 0) return T();
 
@@ -246,17 +386,17 @@ inline T Buffer<T, size_>::getMedian() const {
 
     Buffer<T, size_> bufferSorted;
 
-    bufferSorted = *this;
+    for (uint32_t i = 0; i < numElements_; i++) bufferSorted.placeFront((*this)[i]);
 
     bufferSorted.sortElements();
 
     if (numElements_%2 == 0) { //Is even?
 
-        median = ((*this)[numElements_/2] + (*this)[numElements_/2+1])/2;
+        median = (bufferSorted[numElements_/2-1] + bufferSorted[numElements_/2])/2;
 
     } else { //Odd
     
-        median = (*this)[numElements_/2];
+        median = bufferSorted[numElements_/2];
 
     }
 
@@ -265,15 +405,18 @@ inline T Buffer<T, size_>::getMedian() const {
 }
 
 
-template<typename T, uint32_t size_> 
-inline T Buffer<T, size_>::getAverage() const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline T Buffer<T, size_, Stats_>::getAverage() const {
     if (numElements_ == 0) return T();
+    if (Stats_::running) return stats_.getMean();
     return getSum()/numElements_;
 }
 
 
-template<typename T, uint32_t size_> 
-inline T Buffer<T, size_>::getSum() const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline T Buffer<T, size_, Stats_>::getSum() const {
+
+    if (Stats_::running) return stats_.getMean()*numElements_;
 
     T sum_ = 0;
 
@@ -286,8 +429,8 @@ inline T Buffer<T, size_>::getSum() const {
 }
 
 
-template<typename T, uint32_t size_> 
-inline uint32_t Buffer<T, size_>::quickSortPartition(const uint32_t &left, const uint32_t &right) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline uint32_t Buffer<T, size_, Stats_>::quickSortPartition(const uint32_t &left, const uint32_t &right) {
 
     T pivot = (*this)[right];
 
@@ -318,8 +461,8 @@ inline uint32_t Buffer<T, size_>::quickSortPartition(const uint32_t &left, const
 }
 
 
-template<typename T, uint32_t size_> 
-inline void Buffer<T, size_>::quickSort(const uint32_t &left, const uint32_t &right) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::quickSort(const uint32_t &left, const uint32_t &right) {
     
     if (left < right) {
 
@@ -333,8 +476,8 @@ inline void Buffer<T, size_>::quickSort(const uint32_t &left, const uint32_t &ri
 
 
 
-template<typename T, uint32_t size_> 
-inline void Buffer<T, size_>::sortElements() {
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::sortElements() {
 
     //Check if nothing to sort
     if (numElements_ < 2) return;
@@ -345,14 +488,15 @@ inline void Buffer<T, size_>::sortElements() {
 
 
 
-template<typename T, uint32_t size_> 
-inline void Buffer<T, size_>::clear() {
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::clear() {
     front_ = back_ = numElements_ = 0;
+    stats_.reset();
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::removeElementIndex(uint32_t index) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::removeElementIndex(uint32_t index) {
 
     //Make sure buffer isnt empty
     if (numElements_ == 0) return false;
@@ -363,6 +507,8 @@ inline bool Buffer<T, size_>::removeElementIndex(uint32_t index) {
         return true;
     }
 
+    T removed = (*this)[index];
+
     //We have to move all elements ahead the one to be removed, one place down.
     for (uint32_t j = index; j < numElements_-1; j++) {
 
@@ -370,16 +516,20 @@ inline bool Buffer<T, size_>::removeElementIndex(uint32_t index) {
 
     }
 
+    if (front_ == 0) front_ = size_-1;
+    else front_--;
     numElements_--;
 
+    statsRemove(removed);
+
     //If we exited the loop then item was not found.
     return true;
 
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::removeElement(T* pointerToElement) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::removeElement(T* pointerToElement) {
 
     //Make sure buffer isnt empty
     if (numElements_ == 0) return false;
@@ -402,14 +552,20 @@ inline bool Buffer<T, size_>::removeElement(T* pointerToElement) {
 }
 
 
-template<typename T, uint32_t size_> 
-inline T& Buffer<T, size_>::operator[] (const uint32_t &index) {
-    return bufferArray_[(back_ + index)%numElements_];
+template<typename T, uint32_t size_, typename Stats_> 
+inline T& Buffer<T, size_, Stats_>::operator[] (const uint32_t &index) {
+    return bufferArray_[(back_ + index%numElements_)%size_];
 }
 
 
-template<typename T, uint32_t size_> 
-inline Buffer<T, size_> Buffer<T, size_>::operator = (const Buffer &toBeCopied) const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline const T& Buffer<T, size_, Stats_>::operator[] (const uint32_t &index) const {
+    return bufferArray_[(back_ + index%numElements_)%size_];
+}
+
+
+template<typename T, uint32_t size_, typename Stats_> 
+inline Buffer<T, size_, Stats_> Buffer<T, size_, Stats_>::operator = (const Buffer &toBeCopied) const {
 
     uint32_t sizeToBeCopied = toBeCopied.available();
 
@@ -420,8 +576,8 @@ inline Buffer<T, size_> Buffer<T, size_>::operator = (const Buffer &toBeCopied)
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::peekFront(T* element) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::peekFront(T* element) {
 
     if (numElements_ == 0) return false;
 
@@ -432,8 +588,8 @@ inline bool Buffer<T, size_>::peekFront(T* element) {
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::peekBack(T* element) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::peekBack(T* element) {
 
     if (numElements_ == 0) return false;
 
@@ -444,8 +600,8 @@ inline bool Buffer<T, size_>::peekBack(T* element) {
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::takeFront(T* element) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::takeFront(T* element) {
 
     if (numElements_ == 0) return false;
 
@@ -456,13 +612,15 @@ inline bool Buffer<T, size_>::takeFront(T* element) {
 
     numElements_--;
 
+    statsRemove(*element);
+
     return true;
 
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::takeBack(T* element) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::takeBack(T* element) {
 
     if (numElements_ == 0) return false;
 
@@ -472,25 +630,27 @@ inline bool Buffer<T, size_>::takeBack(T* element) {
 
     numElements_--;
 
+    statsRemove(*element);
+
     return true;
 
 }
 
 
-template<typename T, uint32_t size_>
-inline uint32_t Buffer<T, size_>::available() const {
+template<typename T, uint32_t size_, typename Stats_>
+inline uint32_t Buffer<T, size_, Stats_>::available() const {
     return numElements_;
 }
 
 
-template<typename T, uint32_t size_> 
-inline uint32_t Buffer<T, size_>::availableSpace() const {
+template<typename T, uint32_t size_, typename Stats_> 
+inline uint32_t Buffer<T, size_, Stats_>::availableSpace() const {
     return size_ - numElements_;
 }
 
 
-template<typename T, uint32_t size_> 
-inline void Buffer<T, size_>::removeFront() {
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::removeFront() {
 
     if (numElements_ == 0) return;
 
@@ -498,22 +658,28 @@ inline void Buffer<T, size_>::removeFront() {
     else front_--;
     numElements_--;
 
+    statsRemove(bufferArray_[front_]);
+
 }
 
 
-template<typename T, uint32_t size_> 
-inline void Buffer<T, size_>::removeBack() {
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::removeBack() {
 
     if (numElements_ == 0) return;
 
+    uint32_t removed = back_;
+
     back_ = (back_+1)%size_;
     numElements_--;
 
+    statsRemove(bufferArray_[removed]);
+
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::placeFront(const T &element, const bool overwrite) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::placeFront(const T &element, const bool overwrite) {
 
     if (numElements_ == size_) {
 
@@ -527,13 +693,15 @@ inline bool Buffer<T, size_>::placeFront(const T &element, const bool overwrite)
     front_ = (front_+1)%size_;
     numElements_++;
 
+    statsAdd(element);
+
     return true;
 
 }
 
 
-template<typename T, uint32_t size_> 
-inline bool Buffer<T, size_>::placeBack(const T &element, const bool overwrite) {
+template<typename T, uint32_t size_, typename Stats_> 
+inline bool Buffer<T, size_, Stats_>::placeBack(const T &element, const bool overwrite) {
 
     if (numElements_ == size_) {
 
@@ -549,11 +717,35 @@ inline bool Buffer<T, size_>::placeBack(const T &element, const bool overwrite)
 
     numElements_++;
 
+    statsAdd(element);
+
     return true;
 
 }
 
 
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::statsAdd(const T &element) {
+
+    if (!Stats_::running) return;
+
+    stats_.add(element, numElements_);
+    stats_.update(*this);
+
+}
+
+
+template<typename T, uint32_t size_, typename Stats_> 
+inline void Buffer<T, size_, Stats_>::statsRemove(const T &element) {
+
+    if (!Stats_::running) return;
+
+    stats_.remove(element, numElements_);
+    stats_.update(*this);
+
+}
+
+
 
 
 
@@ -0,0 +1,192 @@
+#ifndef FIR_DECIMATOR_H
+#define FIR_DECIMATOR_H
+
+
+/**
+ * Low pass FIR filter that lowers the rate of a Vector stream by a whole factor, e.g. gyro samples
+ * from 8kHz to 2kHz. Only every factor-th output is calculated, which is the work of a polyphase
+ * decimator without splitting the coefficients. Every tap is applied to all three axes with one
+ * coefficient load, and samples are stored twice so the filter window is always contiguous.
+ *
+ * By default the coefficients are a Hamming windowed sinc, with the cutoff given as a fraction of the
+ * output rate. Other designs, e.g. a CIC compensator, can be given directly.
+ * Output timestamps are those of the middle of the window, which removes the delay of the filter.
+ *
+ * e.g:
+ *
+ * FIRDecimator<33> decimator;
+ * decimator.configure(4, 33);
+ *
+ * Vector filtered;
+ * int64_t filteredTimestamp;
+ * if (decimator.update(gyro, timestamp, &filtered, &filteredTimestamp)) ...
+*/
+
+
+
+#include "math.h"
+#include "stdint.h"
+
+#include "lib/Math-Helper/src/objects/vector_math.h"
+
+
+
+template<uint32_t maxTaps_>
+class FIRDecimator {
+public:
+
+    FIRDecimator() {}
+
+    /**
+     * Designs a windowed sinc low pass for the factor and starts again.
+     *
+     * @param factor is the number of input samples per output sample.
+     * @param taps is the filter length, at most maxTaps_. Odd lengths put output timestamps on input samples.
+     * @param cutoff is the -6dB frequency as a fraction of the output rate. Below 0.5 to keep aliasing out.
+     * @returns false if the settings are not possible.
+     */
+    bool configure(const uint32_t &factor, const uint32_t &taps, const float &cutoff = 0.4f) {
+
+        if (factor == 0 || taps == 0 || taps > maxTaps_ || cutoff <= 0.0f || cutoff >= 0.5f) return false;
+
+        //Cutoff in cycles per input sample.
+        float frequency = cutoff/factor;
+        float middle = (taps - 1)/2.0f;
+        float sum = 0;
+
+        for (uint32_t i = 0; i < taps; i++) {
+
+            float n = i - middle;
+            float sinc = n == 0 ? 2*frequency : sinf(2*PI*frequency*n)/(PI*n);
+            float window = taps > 1 ? 0.54f - 0.46f*cosf(2*PI*i/(taps - 1)) : 1.0f;
+
+            coefficients_[i] = sinc*window;
+            sum += coefficients_[i];
+
+        }
+
+        //Unity gain at 0Hz, so biases and slow motion pass unchanged.
+        for (uint32_t i = 0; i < taps; i++) coefficients_[i] /= sum;
+
+        factor_ = factor;
+        taps_ = taps;
+        reset();
+
+        return true;
+
+    }
+
+    /**
+     * Uses the given coefficients and starts again.
+     *
+     * @param factor is the number of input samples per output sample.
+     * @param coefficients of the filter. First one is applied to the newest sample.
+     * @param taps is the number of coefficients, at most maxTaps_.
+     * @returns false if the settings are not possible.
+     */
+    bool configure(const uint32_t &factor, const float* coefficients, const uint32_t &taps) {
+
+        if (factor == 0 || taps == 0 || taps > maxTaps_) return false;
+
+        for (uint32_t i = 0; i < taps; i++) coefficients_[i] = coefficients[i];
+
+        factor_ = factor;
+        taps_ = taps;
+        reset();
+
+        return true;
+
+    }
+
+    /**
+     * Adds a sample. Every factor-th call gives a filtered sample once the window was filled.
+     *
+     * @param input is the new sample.
+     * @param timestamp of the sample in nanoseconds.
+     * @param output is overwritten with the filtered sample if there is one.
+     * @param outputTimestamp is overwritten with the timestamp of the filtered sample.
+     * @returns true if a filtered sample was given.
+     */
+    bool update(const Vector &input, const int64_t &timestamp, Vector* output, int64_t* outputTimestamp) {
+
+        if (taps_ == 0) return false;
+
+        //Window goes from position_ (newest) to position_ + taps_ - 1 (oldest).
+        position_ = position_ == 0 ? taps_ - 1 : position_ - 1;
+
+        float* slot = history_[position_];
+        float* copy = history_[position_ + taps_];
+        slot[0] = copy[0] = input.x;
+        slot[1] = copy[1] = input.y;
+        slot[2] = copy[2] = input.z;
+        timestamps_[position_] = timestamps_[position_ + taps_] = timestamp;
+
+        if (filled_ < taps_) filled_++;
+
+        if (++phase_ < factor_) return false;
+        phase_ = 0;
+
+        if (filled_ < taps_) return false;
+
+        const float (*window)[3] = &history_[position_];
+        float x = 0, y = 0, z = 0;
+
+        for (uint32_t i = 0; i < taps_; i++) {
+            const float coefficient = coefficients_[i];
+            x += coefficient*window[i][0];
+            y += coefficient*window[i][1];
+            z += coefficient*window[i][2];
+        }
+
+        *output = Vector(x, y, z);
+
+        const int64_t* times = &timestamps_[position_];
+        *outputTimestamp = times[(taps_ - 1)/2] + (times[taps_/2] - times[(taps_ - 1)/2])/2;
+
+        return true;
+
+    }
+
+    /**
+     * Forgets all samples, e.g. after a gap in the input.
+     */
+    void reset() {
+        position_ = 0;
+        phase_ = 0;
+        filled_ = 0;
+    }
+
+    /**
+     * @returns number of input samples per output sample.
+     */
+    uint32_t getFactor() const {return factor_;}
+
+    /**
+     * @returns length of the filter.
+     */
+    uint32_t getTaps() const {return taps_;}
+
+
+private:
+
+    float coefficients_[maxTaps_];
+
+    //Every sample is stored at position and position + taps_, so the window never wraps.
+    float history_[2*maxTaps_][3];
+    int64_t timestamps_[2*maxTaps_];
+
+    uint32_t factor_ = 1;
+    uint32_t taps_ = 0;
+
+    //Slot of the newest sample.
+    uint32_t position_ = 0;
+    //Samples since the last output.
+    uint32_t phase_ = 0;
+    //Samples in the window, up to taps_.
+    uint32_t filled_ = 0;
+
+};
+
+
+
+#endif
@@ -5,6 +5,8 @@
 
 #include "Arduino.h"
 
+#include "utils/system_time.h"
+
 
 
 template<typename T>
@@ -61,8 +63,9 @@ public:
     T update(T input) {
         
         if (_sampleRate == -1) {
-            float dt = (micros() - _lastRun)/1000000.0;
-            _lastRun = micros();
+            int64_t now = NOW();
+            float dt = (float)(now - _lastRun)/SECONDS;
+            _lastRun = now;
             _alpha = dt/(_RC+dt);
         }
 
@@ -75,16 +78,16 @@ public:
 
 
     /**
-     * Timestamp of input value (in microseconds) to improve accuracy.
+     * Timestamp of input value (in nanoseconds, see NOW()) to improve accuracy.
      * This overrides the sampling input at constructor.
      *
-     * @param values input value and timestamp in microseconds
+     * @param values input value and timestamp in nanoseconds
      * @return filtered value.
      */
-    T update(const T &input, const uint32_t &timestampUS) {
+    T update(const T &input, const int64_t &timestamp_ns) {
         
-        float dt = (timestampUS - _lastRun)/1000000.0;
-        _lastRun = timestampUS;
+        float dt = (float)(timestamp_ns - _lastRun)/SECONDS;
+        _lastRun = timestamp_ns;
         _alpha = dt/(_RC+dt);
 
         T output = _lastValue + (input - _lastValue)*_alpha;
@@ -127,7 +130,7 @@ private:
     float _alpha;
 
     T _lastValue;
-    uint32_t _lastRun = 0;
+    int64_t _lastRun = 0;
 
 
 };
@@ -0,0 +1,283 @@
+#ifndef MEDIAN_FILTER_H
+#define MEDIAN_FILTER_H
+
+
+/**
+ * Median (or any percentile) over the last size_ values. Single spikes do not move it,
+ * which makes it usefull for rejecting outliers of sensors like barometers and GNSS.
+ *
+ * The window is split into two heaps: a max heap with the values below the percentile
+ * and a min heap with the values above it. A new value replaces the oldest in its heap
+ * and only the two tops are swapped if it belongs to the other heap, so an update is
+ * O(log n) and the percentile is read from the tops in O(1). No memory is allocated.
+ *
+ * e.g:
+ *
+ * MedianFilter<float, 5> heightMedian;
+ * float height = heightMedian.update(heightMeasured);
+*/
+
+
+
+#include "stdint.h"
+
+
+
+template<typename T, uint32_t size_>
+class MedianFilter {
+public:
+
+    static_assert(size_ > 1 && size_ < 0x8000, "MedianFilter size must be between 2 and 32767");
+
+    /**
+     * @param percentile is the percentile to filter for from 0 to 100. Default is the median.
+     */
+    MedianFilter(const float &percentile = 50) {setPercentile(percentile);}
+
+    /**
+     * Places a new value into the window. Once the window is full the oldest value is removed.
+     *
+     * @param input is the new value.
+     * @returns filtered value.
+     */
+    T update(const T &input) {
+
+        if (numValues_ < size_) {
+            insert(next_, input);
+            numValues_++;
+            setRank();
+        } else {
+            replace(next_, input);
+        }
+
+        next_ = (next_ + 1)%size_;
+
+        return getValue();
+
+    }
+
+    /**
+     * Values between two ranks are interpolated, so the median of an even number of values
+     * is the average of the two in the middle.
+     *
+     * @returns the percentile of the values in the window. T() if empty.
+     */
+    T getValue() const {
+
+        if (numValues_ == 0) return T();
+
+        T lower = values_[lowerHeap_[0]];
+        if (fraction_ == 0 || upperCount_ == 0) return lower;
+
+        return lower + (values_[upperHeap_[0]] - lower)*fraction_;
+
+    }
+
+    /**
+     * Sets the percentile to filter for. Costs O(n log n) as the heaps are rebalanced.
+     *
+     * @param percentile from 0 to 100.
+     */
+    void setPercentile(const float &percentile) {
+        percentile_ = percentile < 0 ? 0 : (percentile > 100 ? 100 : percentile);
+        setRank();
+    }
+
+    /**
+     * @returns the percentile filtered for.
+     */
+    float getPercentile() const {return percentile_;}
+
+    /**
+     * @returns number of values in the window.
+     */
+    uint32_t available() const {return numValues_;}
+
+    /**
+     * @returns true once size_ values were placed and the oldest ones are being removed.
+     */
+    bool isFull() const {return numValues_ == size_;}
+
+    /**
+     * Removes all values.
+     */
+    void clear() {
+        numValues_ = lowerCount_ = upperCount_ = next_ = 0;
+        fraction_ = 0;
+    }
+
+
+private:
+
+    //Marks a heap position as being in the upper heap.
+    static constexpr uint16_t upperHeapFlag_ = 0x8000;
+
+    /**
+     * Places the value of a new slot into the heap it belongs to.
+     */
+    void insert(const uint16_t &slot, const T &input) {
+
+        values_[slot] = input;
+
+        if (lowerCount_ == 0 || !(values_[lowerHeap_[0]] < input)) {
+            lowerHeap_[lowerCount_] = slot;
+            heapPosition_[slot] = lowerCount_;
+            siftUp(lowerCount_++);
+        } else {
+            upperHeap_[upperCount_] = slot;
+            heapPosition_[slot] = upperCount_ | upperHeapFlag_;
+            siftUp(upperCount_++ | upperHeapFlag_);
+        }
+
+    }
+
+    /**
+     * Overwrites the value of a slot and restores both heaps. The heap sizes stay the same.
+     */
+    void replace(const uint16_t &slot, const T &input) {
+
+        values_[slot] = input;
+
+        uint16_t position = heapPosition_[slot];
+        siftDown(siftUp(position));
+
+        if (upperCount_ == 0 || lowerCount_ == 0) return;
+
+        //New value can belong to the other heap. It is then at the top of its own one.
+        if (values_[upperHeap_[0]] < values_[lowerHeap_[0]]) {
+            swap(0, upperHeapFlag_);
+            siftDown(0);
+            siftDown(upperHeapFlag_);
+        }
+
+    }
+
+    /**
+     * Moves tops between the heaps until the lower one holds the values up to the rank.
+     */
+    void setRank() {
+
+        if (numValues_ == 0) {
+            fraction_ = 0;
+            return;
+        }
+
+        float rank = percentile_/100*(numValues_ - 1);
+        uint32_t lowerTarget = (uint32_t)rank + 1;
+        fraction_ = rank - (uint32_t)rank;
+
+        while (lowerCount_ > lowerTarget) {
+            uint16_t slot = lowerHeap_[0];
+            removeTop(0);
+            upperHeap_[upperCount_] = slot;
+            heapPosition_[slot] = upperCount_ | upperHeapFlag_;
+            siftUp(upperCount_++ | upperHeapFlag_);
+        }
+
+        while (lowerCount_ < lowerTarget) {
+            uint16_t slot = upperHeap_[0];
+            removeTop(upperHeapFlag_);
+            lowerHeap_[lowerCount_] = slot;
+            heapPosition_[slot] = lowerCount_;
+            siftUp(lowerCount_++);
+        }
+
+    }
+
+    /**
+     * Removes the top of the heap by moving its last slot up.
+     */
+    void removeTop(const uint16_t heap) {
+
+        uint16_t* array = heap & upperHeapFlag_ ? upperHeap_ : lowerHeap_;
+        uint16_t &count = heap & upperHeapFlag_ ? upperCount_ : lowerCount_;
+
+        array[0] = array[--count];
+        heapPosition_[array[0]] = heap & upperHeapFlag_;
+        siftDown(heap & upperHeapFlag_);
+
+    }
+
+    /**
+     * @returns true if the value at position a should be above the one at b in their heap.
+     */
+    bool isAbove(const uint16_t a, const uint16_t b) const {
+        if (a & upperHeapFlag_) return values_[upperHeap_[a & ~upperHeapFlag_]] < values_[upperHeap_[b & ~upperHeapFlag_]];
+        return values_[lowerHeap_[b]] < values_[lowerHeap_[a]];
+    }
+
+    /**
+     * Swaps two heap positions. Can be in different heaps.
+     */
+    void swap(const uint16_t a, const uint16_t b) {
+
+        uint16_t &slotA = a & upperHeapFlag_ ? upperHeap_[a & ~upperHeapFlag_] : lowerHeap_[a];
+        uint16_t &slotB = b & upperHeapFlag_ ? upperHeap_[b & ~upperHeapFlag_] : lowerHeap_[b];
+
+        uint16_t slot = slotA;
+        slotA = slotB;
+        slotB = slot;
+
+        heapPosition_[slotA] = a;
+        heapPosition_[slotB] = b;
+
+    }
+
+    /**
+     * @returns the new position.
+     */
+    uint16_t siftUp(uint16_t position) {
+
+        uint16_t heap = position & upperHeapFlag_;
+
+        while ((position & ~upperHeapFlag_) > 0) {
+            uint16_t parent = (((position & ~upperHeapFlag_) - 1)/2) | heap;
+            if (!isAbove(position, parent)) break;
+            swap(position, parent);
+            position = parent;
+        }
+
+        return position;
+
+    }
+
+    void siftDown(uint16_t position) {
+
+        uint16_t heap = position & upperHeapFlag_;
+        uint16_t count = heap ? upperCount_ : lowerCount_;
+
+        while (true) {
+            uint16_t child = (position & ~upperHeapFlag_)*2 + 1;
+            if (child >= count) break;
+            if (child + 1 < count && isAbove((child + 1) | heap, child | heap)) child++;
+            if (!isAbove(child | heap, position)) break;
+            swap(position, child | heap);
+            position = child | heap;
+        }
+
+    }
+
+
+    //Values in the order they were placed. next_ is the oldest once full.
+    T values_[size_];
+    //Slots of values_ at or below the percentile. Max heap.
+    uint16_t lowerHeap_[size_];
+    //Slots of values_ above the percentile. Min heap.
+    uint16_t upperHeap_[size_];
+    //Position of every slot in its heap. upperHeapFlag_ is set for the upper heap.
+    uint16_t heapPosition_[size_];
+
+    uint16_t lowerCount_ = 0;
+    uint16_t upperCount_ = 0;
+    uint32_t numValues_ = 0;
+    uint32_t next_ = 0;
+
+    float percentile_ = 50;
+    //How far the percentile is from the lower top to the upper top.
+    float fraction_ = 0;
+
+};
+
+
+
+#endif
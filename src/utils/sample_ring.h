@@ -0,0 +1,288 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+
+/**
+ * Lock free queue of timestamped sensor samples for one producer (e.g. a driver interrupt)
+ * and one consumer (e.g. navigation). Value and timestamp are placed and taken with a single
+ * index update, so they cannot get out of sync.
+ *
+ * The layout decides how samples are stored:
+ * - eSampleLayout_Interleaved keeps value and timestamp of a sample next to each other.
+ * - eSampleLayout_Separate keeps all values in one array and all timestamps in another,
+ *   so consumers that only loop over values get them back to back.
+ *
+ * drain() copies all pending samples into contiguous arrays with one index update.
+ * With the separate layout peek() can also give a view of them where they are stored,
+ * which is removed with remove() once processed.
+ *
+ * A full ring drops new samples by default. Rings that may not have a consumer should use
+ * eRingOverflow_OverwriteOldest so they keep the newest samples, but then cannot give views,
+ * as the producer could overwrite samples while they are looked at.
+ *
+ * e.g:
+ *
+ * SampleRing<Vector, 128, eSampleLayout_Separate> gyroSamples;
+ *
+ * void interrupt() {gyroSamples.push(gyro, NOW());}
+ *
+ * void thread() {
+ *      Vector values[16];
+ *      int64_t timestamps[16];
+ *      uint32_t number = gyroSamples.drain(SampleSpan<Vector>(values, timestamps, 16));
+ * }
+*/
+
+
+
+#include "stdint.h"
+
+#include "utils/spsc_ring.h"
+#include "utils/sensor_timestamp.h"
+
+
+
+enum eSampleLayout_t {
+    //Array of SensorTimestamp.
+    eSampleLayout_Interleaved,
+    //One array of values and one of timestamps.
+    eSampleLayout_Separate
+};
+
+
+
+/**
+ * Storage of SampleRing for every layout.
+ */
+template<typename T, uint32_t size_, eSampleLayout_t layout_>
+struct SampleRingStorage;
+
+
+template<typename T, uint32_t size_>
+struct SampleRingStorage<T, size_, eSampleLayout_t::eSampleLayout_Interleaved> {
+
+    inline void set(const uint32_t &index, const T &value, const int64_t &timestamp) {
+        samples[index].sensorData = value;
+        samples[index].sensorTimestamp = timestamp;
+    }
+
+    inline const T& getValue(const uint32_t &index) const {return samples[index].sensorData;}
+    inline const int64_t& getTimestamp(const uint32_t &index) const {return samples[index].sensorTimestamp;}
+
+    alignas(SPSC_RING_CACHE_LINE) SensorTimestamp<T> samples[size_];
+
+};
+
+
+template<typename T, uint32_t size_>
+struct SampleRingStorage<T, size_, eSampleLayout_t::eSampleLayout_Separate> {
+
+    inline void set(const uint32_t &index, const T &value, const int64_t &timestamp) {
+        values[index] = value;
+        timestamps[index] = timestamp;
+    }
+
+    inline const T& getValue(const uint32_t &index) const {return values[index];}
+    inline const int64_t& getTimestamp(const uint32_t &index) const {return timestamps[index];}
+
+    alignas(SPSC_RING_CACHE_LINE) T values[size_];
+    alignas(SPSC_RING_CACHE_LINE) int64_t timestamps[size_];
+
+};
+
+
+
+template<typename T, uint32_t size_, eSampleLayout_t layout_ = eSampleLayout_t::eSampleLayout_Interleaved,
+         eRingOverflow_t overflow_ = eRingOverflow_t::eRingOverflow_DropNewest>
+class SampleRing {
+public:
+
+    SampleRing() {}
+
+    /**
+     * @returns number of samples in the ring.
+     */
+    inline uint32_t available() const {return index_.available();}
+
+    /**
+     * @returns number of samples that can be pushed.
+     */
+    inline uint32_t availableSpace() const {return size_ - available();}
+
+    /**
+     * @returns maximum number of samples.
+     */
+    inline uint32_t capacity() const {return size_;}
+
+    /**
+     * Places a sample at the head. Producer only.
+     * If the ring is full the sample is dropped, or the oldest is removed with eRingOverflow_OverwriteOldest.
+     *
+     * @param value of the sample.
+     * @param timestamp of the sample in nanoseconds.
+     * @returns true if placed into the ring.
+     */
+    inline bool push(const T &value, const int64_t &timestamp) {
+
+        uint32_t head;
+        if (index_.getWritable(1, &head) == 0) {
+            index_.addDropped(1);
+            return false;
+        }
+
+        storage_.set(index_.mask(head), value, timestamp);
+        index_.commitWrite(head + 1);
+
+        return true;
+
+    }
+
+    inline bool push(const SensorTimestamp<T> &sample) {return push(sample.sensorData, sample.sensorTimestamp);}
+
+    /**
+     * Takes the oldest sample. Consumer only.
+     *
+     * @param value is overwritten with the value of the sample.
+     * @param timestamp is overwritten with the timestamp of the sample.
+     * @returns true if a sample was taken.
+     */
+    inline bool pop(T* value, int64_t* timestamp) {
+
+        uint32_t tail;
+        do {
+
+            if (index_.getReadable(1, &tail) == 0) return false;
+
+            *value = storage_.getValue(index_.mask(tail));
+            *timestamp = storage_.getTimestamp(index_.mask(tail));
+
+        } while (!index_.commitRead(tail, 1));
+
+        return true;
+
+    }
+
+    inline bool pop(SensorTimestamp<T>* sample) {return pop(&sample->sensorData, &sample->sensorTimestamp);}
+
+    /**
+     * Copies the oldest sample without removing it. Consumer only.
+     *
+     * @param value is overwritten with the value of the sample.
+     * @param timestamp is overwritten with the timestamp of the sample.
+     * @returns true if a sample was copied.
+     */
+    inline bool peek(T* value, int64_t* timestamp) {
+
+        uint32_t tail;
+        do {
+
+            if (index_.getReadable(1, &tail) == 0) return false;
+
+            *value = storage_.getValue(index_.mask(tail));
+            *timestamp = storage_.getTimestamp(index_.mask(tail));
+
+        } while (!index_.isUnchanged(tail));
+
+        return true;
+
+    }
+
+    inline bool peek(SensorTimestamp<T>* sample) {return peek(&sample->sensorData, &sample->sensorTimestamp);}
+
+    /**
+     * Gives all pending samples without copying them. Consumer only. Only for eSampleLayout_Separate and eRingOverflow_DropNewest.
+     * The producer does not touch them until they are removed with remove(view.length()).
+     *
+     * @param view is overwritten with the samples, oldest first.
+     * @returns number of samples in the view.
+     */
+    inline uint32_t peek(SampleView<T>* view) {
+
+        static_assert(layout_ == eSampleLayout_t::eSampleLayout_Separate, "SampleRing views need eSampleLayout_Separate");
+        static_assert(overflow_ == eRingOverflow_t::eRingOverflow_DropNewest, "SampleRing views need eRingOverflow_DropNewest");
+
+        uint32_t tail;
+        uint32_t number = index_.getReadable(size_, &tail);
+        uint32_t start = index_.mask(tail);
+        uint32_t toEnd = size_ - start;
+
+        view->segments[0].values = &storage_.values[start];
+        view->segments[0].timestamps = &storage_.timestamps[start];
+        view->segments[0].length = number < toEnd ? number : toEnd;
+
+        view->segments[1].values = storage_.values;
+        view->segments[1].timestamps = storage_.timestamps;
+        view->segments[1].length = number - view->segments[0].length;
+
+        return number;
+
+    }
+
+    /**
+     * Takes up to span.length of the oldest samples into the arrays of the span, oldest first.
+     * The tail is moved once after all were copied. Consumer only.
+     *
+     * @param span arrays to copy into. Values or timestamps can be nullptr to skip them.
+     * @returns number of samples taken.
+     */
+    inline uint32_t drain(const SampleSpan<T> &span) {
+
+        uint32_t tail;
+        uint32_t number;
+        do {
+
+            number = index_.getReadable(span.length, &tail);
+
+            if (span.values != nullptr) {
+                for (uint32_t i = 0; i < number; i++) span.values[i] = storage_.getValue(index_.mask(tail + i));
+            }
+            if (span.timestamps != nullptr) {
+                for (uint32_t i = 0; i < number; i++) span.timestamps[i] = storage_.getTimestamp(index_.mask(tail + i));
+            }
+
+        } while (!index_.commitRead(tail, number));
+
+        return number;
+
+    }
+
+    /**
+     * Removes up to the given number of the oldest samples. Consumer only.
+     *
+     * @param number of samples to remove.
+     * @returns number of samples removed.
+     */
+    inline uint32_t remove(const uint32_t &number = 1) {
+
+        uint32_t tail;
+        uint32_t toRemove;
+        do {
+            toRemove = index_.getReadable(number, &tail);
+        } while (!index_.commitRead(tail, toRemove));
+
+        return toRemove;
+
+    }
+
+    /**
+     * Removes all samples. Consumer only. Samples pushed meanwhile may stay.
+     */
+    inline void clear() {index_.clear();}
+
+    /**
+     * @returns number of samples dropped or overwritten because the ring was full.
+     */
+    inline uint32_t getDropped() const {return index_.getDropped();}
+
+
+private:
+
+    SPSCRingIndex<size_, overflow_> index_;
+
+    SampleRingStorage<T, size_, layout_> storage_;
+
+};
+
+
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef SENSOR_CALIBRATION_H
+#define SENSOR_CALIBRATION_H
+
+
+/**
+ * Raw sensor samples and how to turn them into values. Drivers place the counts read from the sensor
+ * into their FIFOs as they are and give a SensorCalibration per stream with the axis order, signs and
+ * unit of the sensor. Consumers turn a batch of samples into values at once with CalibratedSamples.
+ * This keeps float conversion out of the drivers and stores 6 bytes per sample instead of a Vector.
+ *
+ * e.g:
+ *
+ * SampleView<RawVector> view;
+ * gyro->peekGyroSamples(&view);
+ *
+ * CalibratedSamples<16> samples(view, gyro->gyroCalibration());
+ * while (samples.next()) for (uint32_t i = 0; i < samples.length; i++) ... samples.values[i], samples.timestamps[i]
+ *
+ * gyro->commitGyroSamples(view.length());
+*/
+
+
+
+#include "math.h"
+#include "stdint.h"
+
+#include "lib/Math-Helper/src/objects/vector_math.h"
+
+#include "utils/sensor_timestamp.h"
+
+
+
+/**
+ * Counts of a 3 axis sensor in the axis order of the sensor.
+ */
+struct RawVector {
+
+    RawVector() {}
+
+    RawVector(const int16_t &x, const int16_t &y, const int16_t &z) {
+        data[0] = x;
+        data[1] = y;
+        data[2] = z;
+    }
+
+    /**
+     * Rounds values in counts, e.g. the output of a filter. Values out of range are clamped.
+     */
+    static RawVector fromVector(const Vector &counts) {
+        return RawVector(clamp(counts.x), clamp(counts.y), clamp(counts.z));
+    }
+
+    /**
+     * @returns counts as floats, e.g. to filter them.
+     */
+    Vector toVector() const {return Vector(data[0], data[1], data[2]);}
+
+    bool operator == (const RawVector &other) const {
+        return data[0] == other.data[0] && data[1] == other.data[1] && data[2] == other.data[2];
+    }
+
+    bool operator != (const RawVector &other) const {return !(*this == other);}
+
+    int16_t data[3] = {0, 0, 0};
+
+
+private:
+
+    static int16_t clamp(const float &value) {
+        if (value >= INT16_MAX) return INT16_MAX;
+        if (value <= INT16_MIN) return INT16_MIN;
+        return (int16_t)lroundf(value);
+    }
+
+};
+
+
+
+/**
+ * Turns RawVectors into values: value[i] = raw.data[axis[i]]*scale[i] - bias[i].
+ */
+struct SensorCalibration {
+
+    SensorCalibration() {}
+
+    /**
+     * @param axisX is the raw axis that becomes x. Same for y and z.
+     * @param scale per output axis, e.g. unit per count with the sign of the axis.
+     * @param bias subtracted per output axis after scaling.
+     */
+    SensorCalibration(const uint8_t &axisX, const uint8_t &axisY, const uint8_t &axisZ, const Vector &scale, const Vector &bias = Vector(0)) {
+        axis[0] = axisX;
+        axis[1] = axisY;
+        axis[2] = axisZ;
+        this->scale[0] = scale.x;
+        this->scale[1] = scale.y;
+        this->scale[2] = scale.z;
+        this->bias[0] = bias.x;
+        this->bias[1] = bias.y;
+        this->bias[2] = bias.z;
+    }
+
+    /**
+     * @returns value of a single sample.
+     */
+    inline Vector apply(const RawVector &raw) const {
+        return Vector(raw.data[axis[0]]*scale[0] - bias[0], raw.data[axis[1]]*scale[1] - bias[1], raw.data[axis[2]]*scale[2] - bias[2]);
+    }
+
+    /**
+     * Calculates the values of a batch of samples.
+     *
+     * @param raw samples to calibrate.
+     * @param values array the results are placed into.
+     * @param number of samples.
+     */
+    inline void apply(const RawVector* raw, Vector* values, const uint32_t &number) const {
+
+        //Loaded once for the batch, so the loop is only loads, multiply adds and stores.
+        const uint8_t ax = axis[0], ay = axis[1], az = axis[2];
+        const float sx = scale[0], sy = scale[1], sz = scale[2];
+        const float bx = bias[0], by = bias[1], bz = bias[2];
+
+        for (uint32_t i = 0; i < number; i++) {
+            const int16_t* data = raw[i].data;
+            values[i].x = data[ax]*sx - bx;
+            values[i].y = data[ay]*sy - by;
+            values[i].z = data[az]*sz - bz;
+        }
+
+    }
+
+    /**
+     * Adds a correction of (value - correctionBias)*correctionScale after this calibration,
+     * e.g. one found by a consumer, so it is applied in the same step.
+     *
+     * @returns the combined calibration.
+     */
+    SensorCalibration corrected(const Vector &correctionBias, const Vector &correctionScale) const {
+
+        const float correctionBiases[3] = {correctionBias.x, correctionBias.y, correctionBias.z};
+        const float correctionScales[3] = {correctionScale.x, correctionScale.y, correctionScale.z};
+
+        SensorCalibration calibration = *this;
+        for (uint8_t i = 0; i < 3; i++) {
+            calibration.scale[i] = scale[i]*correctionScales[i];
+            calibration.bias[i] = (bias[i] + correctionBiases[i])*correctionScales[i];
+        }
+
+        return calibration;
+
+    }
+
+    uint8_t axis[3] = {0, 1, 2};
+    float scale[3] = {1, 1, 1};
+    float bias[3] = {0, 0, 0};
+
+};
+
+
+
+/**
+ * Goes through the samples of a view in calibrated batches of up to batchSize_.
+ */
+template<uint32_t batchSize_>
+class CalibratedSamples {
+public:
+
+    CalibratedSamples(const SampleView<RawVector> &view, const SensorCalibration &calibration) : view_(view), calibration_(calibration) {}
+
+    /**
+     * Calibrates the next batch into values.
+     *
+     * @returns false once all samples were given.
+     */
+    bool next() {
+
+        while (segment_ < 2 && position_ >= view_.segments[segment_].length) {
+            segment_++;
+            position_ = 0;
+        }
+
+        if (segment_ >= 2) {
+            length = 0;
+            return false;
+        }
+
+        const SampleSegment<RawVector> &segment = view_.segments[segment_];
+        uint32_t remaining = segment.length - position_;
+        length = remaining < batchSize_ ? remaining : batchSize_;
+
+        calibration_.apply(&segment.values[position_], values, length);
+        timestamps = &segment.timestamps[position_];
+        position_ += length;
+
+        return true;
+
+    }
+
+    //Values of the current batch.
+    Vector values[batchSize_];
+    //Timestamps of the current batch in nanoseconds.
+    const int64_t* timestamps = nullptr;
+    //Number of samples in the current batch.
+    uint32_t length = 0;
+
+
+private:
+
+    SampleView<RawVector> view_;
+    SensorCalibration calibration_;
+
+    uint32_t segment_ = 0;
+    uint32_t position_ = 0;
+
+};
+
+
+
+#endif
@@ -3,17 +3,89 @@
 
 
 
+#include "stdint.h"
+
+
+
 template<typename T>
 struct SensorTimestamp{
 
-    SensorTimestamp(T sensorData, uint32_t sensorTimestamp) {
+    SensorTimestamp() {}
+
+    SensorTimestamp(T sensorData, int64_t sensorTimestamp) {
         this->sensorData = sensorData;
         this->sensorTimestamp = sensorTimestamp;
     }
 
     T sensorData;
 
-    uint32_t sensorTimestamp = 0;
+    int64_t sensorTimestamp = 0;
+
+};
+
+
+
+/**
+ * Samples stored as separate arrays of values and timestamps, e.g. to copy pending samples
+ * out of a SampleRing in one go. Either pointer can be nullptr if not needed.
+ */
+template<typename T>
+struct SampleSpan {
+
+    SampleSpan() {}
+
+    SampleSpan(T* values, int64_t* timestamps, uint32_t length) {
+        this->values = values;
+        this->timestamps = timestamps;
+        this->length = length;
+    }
+
+    T* values = nullptr;
+
+    int64_t* timestamps = nullptr;
+
+    //Number of samples in the arrays.
+    uint32_t length = 0;
+
+};
+
+
+
+/**
+ * Read only part of a queue of samples. Values and timestamps are separate arrays.
+ */
+template<typename T>
+struct SampleSegment {
+
+    const T* values = nullptr;
+
+    const int64_t* timestamps = nullptr;
+
+    uint32_t length = 0;
+
+};
+
+
+/**
+ * Pending samples of a queue, looked at where they are stored instead of copied.
+ * They can wrap around the end of the queue storage, so they are in up to two segments:
+ * segments[0] holds the oldest ones and segments[1] continues from the start of the storage.
+ *
+ * e.g:
+ *
+ * for (const SampleSegment<Vector> &segment : view.segments) {
+ *      for (uint32_t i = 0; i < segment.length; i++) ... segment.values[i], segment.timestamps[i]
+ * }
+ */
+template<typename T>
+struct SampleView {
+
+    SampleSegment<T> segments[2];
+
+    /**
+     * @returns number of samples in both segments.
+     */
+    uint32_t length() const {return segments[0].length + segments[1].length;}
 
 };
 
@@ -0,0 +1,400 @@
+#include "spi_bus.h"
+
+#include "string.h"
+
+#include "utils/system_time.h"
+
+
+
+#if defined(__IMXRT1062__)
+
+//Interrupts are disabled while the queue is changed, as submit() can also be called from the DMA interrupt.
+static inline uint32_t enterCritical() {
+    uint32_t primask;
+    asm volatile("mrs %0, primask" : "=r" (primask));
+    __disable_irq();
+    return primask;
+}
+
+static inline void exitCritical(const uint32_t &primask) {
+    if (!primask) __enable_irq();
+}
+
+#else
+
+//Without DMA everything runs from the caller, nothing can interrupt.
+static inline uint32_t enterCritical() {return 0;}
+static inline void exitCritical(const uint32_t &primask) {}
+
+#endif
+
+
+
+SPIBus* SPIBus::getBus(SPIClass* spi) {
+
+    static SPIBus buses[SPI_BUS_MAX_BUSES];
+
+    for (uint32_t i = 0; i < SPI_BUS_MAX_BUSES; i++) {
+
+        if (buses[i].spi_ == spi) return &buses[i];
+
+        if (buses[i].spi_ == nullptr) {
+            buses[i].spi_ = spi;
+#if defined(__IMXRT1062__)
+            buses[i].event_.setContext(&buses[i]);
+            buses[i].event_.attachImmediate(&SPIBus::dmaInterrupt);
+#endif
+            return &buses[i];
+        }
+
+    }
+
+    return nullptr;
+
+}
+
+
+SPIDevice* SPIBus::addDevice(const uint8_t &chipSelectPin, const uint32_t &clock_Hz, const uint8_t &mode, const eSPIPriority_t &priority) {
+
+    SPIDevice* device = nullptr;
+
+    for (uint32_t i = 0; i < numberDevices_; i++) {
+        if (devices_[i].chipSelectPin == chipSelectPin) device = &devices_[i];
+    }
+
+    if (device == nullptr) {
+        if (numberDevices_ >= SPI_BUS_MAX_DEVICES) return nullptr;
+        device = &devices_[numberDevices_++];
+        device->chipSelectPin = chipSelectPin;
+    }
+
+    device->clock_Hz = clock_Hz;
+    device->mode = mode;
+    device->priority = priority;
+
+    return device;
+
+}
+
+
+bool SPIBus::submit(SPITransaction* transaction) {
+
+    if (transaction->length == 0 || transaction->device == nullptr) return false;
+
+    uint32_t primask = enterCritical();
+
+    if (transaction->status == eSPITransactionStatus_t::eSPITransactionStatus_Queued || transaction->status == eSPITransactionStatus_t::eSPITransactionStatus_Running) {
+        exitCritical(primask);
+        return false;
+    }
+
+    transaction->status = eSPITransactionStatus_t::eSPITransactionStatus_Queued;
+    transaction->queuedTimestamp = NOW();
+
+    //Goes behind everything of a higher priority or the same priority with an earlier or no later deadline.
+    SPITransaction* volatile* position = &queueFront_;
+    while (*position != nullptr) {
+        const SPITransaction* queued = *position;
+        if (transaction->device->priority > queued->device->priority) break;
+        if (transaction->device->priority == queued->device->priority && transaction->deadline != 0 && (queued->deadline == 0 || transaction->deadline < queued->deadline)) break;
+        position = &(*position)->next;
+    }
+
+    transaction->next = *position;
+    *position = transaction;
+
+    startNext();
+
+    exitCritical(primask);
+
+    callFailedCallbacks();
+
+    return true;
+
+}
+
+
+bool SPIBus::isIdle() {
+    return running_ == nullptr && queueFront_ == nullptr;
+}
+
+
+void SPIBus::lock(SPIDevice* device) {
+
+    int64_t requested = NOW();
+
+    uint32_t primask = enterCritical();
+    lockPriority_ = device != nullptr ? device->priority : eSPIPriority_t::eSPIPriority_Low;
+    lockPending_ = true;
+    exitCritical(primask);
+
+    while (true) {
+
+        primask = enterCritical();
+        if (canLock()) {
+            lockPending_ = false;
+            locked_ = true;
+            lockDevice_ = device;
+            lockRequested_ = requested;
+            lockStart_ = NOW();
+            exitCritical(primask);
+            return;
+        }
+        exitCritical(primask);
+
+#if !defined(__IMXRT1062__)
+        completeTransfer();
+#endif
+
+    }
+
+}
+
+
+void SPIBus::unlock() {
+
+    uint32_t primask = enterCritical();
+    if (locked_) {
+        locked_ = false;
+        countTransfer(lockDevice_, lockStart_ - lockRequested_, NOW() - lockStart_, 0, false);
+    }
+    startNext();
+    exitCritical(primask);
+
+    callFailedCallbacks();
+
+}
+
+
+void SPIBus::yieldLock() {
+
+    uint32_t primask = enterCritical();
+    bool waiting = locked_ && queueFront_ != nullptr && queueFront_->device->priority > lockPriority_;
+    SPIDevice* device = lockDevice_;
+    exitCritical(primask);
+
+    if (!waiting) return;
+
+    unlock();
+    lock(device);
+
+}
+
+
+SPIBusStatistics SPIBus::getStatistics() {
+
+    uint32_t primask = enterCritical();
+    SPIBusStatistics statistics = statistics_;
+    exitCritical(primask);
+
+    return statistics;
+
+}
+
+
+SPIBusStatistics SPIBus::getStatistics(const SPIDevice* device) {
+
+    uint32_t primask = enterCritical();
+    SPIBusStatistics statistics = device->statistics;
+    exitCritical(primask);
+
+    return statistics;
+
+}
+
+
+float SPIBus::getUtilisation() {
+
+    uint32_t primask = enterCritical();
+    int64_t busyTime = statistics_.busyTime;
+    int64_t elapsed = NOW() - statisticsStart_;
+    exitCritical(primask);
+
+    if (elapsed <= 0) return 0;
+
+    return (float)busyTime/elapsed;
+
+}
+
+
+void SPIBus::resetStatistics() {
+
+    uint32_t primask = enterCritical();
+    statistics_ = SPIBusStatistics();
+    for (uint32_t i = 0; i < numberDevices_; i++) devices_[i].statistics = SPIBusStatistics();
+    statisticsStart_ = NOW();
+    exitCritical(primask);
+
+}
+
+
+bool SPIBus::canLock() {
+
+    if (running_ != nullptr || locked_) return false;
+
+    //Queue is sorted, so only the first one can be more important.
+    return queueFront_ == nullptr || queueFront_->device->priority <= lockPriority_;
+
+}
+
+
+void SPIBus::startNext() {
+
+    while (running_ == nullptr && !locked_ && queueFront_ != nullptr) {
+
+        SPITransaction* transaction = queueFront_;
+
+        //A waiting lock goes ahead of everything that is not more important.
+        if (lockPending_ && transaction->device->priority <= lockPriority_) return;
+
+        queueFront_ = transaction->next;
+
+        transaction->status = eSPITransactionStatus_t::eSPITransactionStatus_Running;
+        transaction->startTimestamp = NOW();
+        running_ = transaction;
+
+        const SPIDevice* device = transaction->device;
+
+#if defined(__IMXRT1062__)
+
+        spi_->beginTransaction(SPISettings(device->clock_Hz, MSBFIRST, device->mode));
+        digitalWriteFast(device->chipSelectPin, LOW);
+
+        if (spi_->transfer(transaction->txBuffer, transaction->rxBuffer, transaction->length, event_)) return;
+
+        //DMA could not be started. Transaction is given back and the next one tried.
+        //Its callback is called after the critical section, as it may submit again. Stays running until then, so it is not submitted while in the list.
+        digitalWriteFast(device->chipSelectPin, HIGH);
+        spi_->endTransaction();
+
+        running_ = nullptr;
+        transaction->next = failedFront_;
+        failedFront_ = transaction;
+
+#else
+
+        SPIDeviceModel* model = nullptr;
+        for (uint32_t i = 0; i < SPI_BUS_MAX_DEVICE_MODELS; i++) {
+            if (models_[i] != nullptr && modelPins_[i] == device->chipSelectPin) model = models_[i];
+        }
+
+        //Data moves now, the transfer is done once completeTransfer() is called.
+        if (model != nullptr) model->transfer(transaction->txBuffer, transaction->rxBuffer, transaction->length);
+        else if (transaction->rxBuffer != nullptr) memset(transaction->rxBuffer, 0xFF, transaction->length);
+
+#endif
+
+    }
+
+}
+
+
+void SPIBus::finishTransfer() {
+
+    SPITransaction* transaction = running_;
+    if (transaction == nullptr) return;
+
+#if defined(__IMXRT1062__)
+    digitalWriteFast(transaction->device->chipSelectPin, HIGH);
+    spi_->endTransaction();
+#endif
+
+    transaction->doneTimestamp = NOW();
+
+    //Bus is given to the next transaction before the callback, so it does not wait for it.
+    uint32_t primask = enterCritical();
+    running_ = nullptr;
+    transaction->status = eSPITransactionStatus_t::eSPITransactionStatus_Done;
+
+    bool deadlineMissed = transaction->deadline != 0 && transaction->startTimestamp > transaction->deadline;
+    countTransfer(transaction->device, transaction->startTimestamp - transaction->queuedTimestamp, transaction->doneTimestamp - transaction->startTimestamp, transaction->length, deadlineMissed);
+
+    startNext();
+    exitCritical(primask);
+
+    if (transaction->callback != nullptr) transaction->callback(transaction);
+
+    callFailedCallbacks();
+
+}
+
+
+void SPIBus::callFailedCallbacks() {
+
+    uint32_t primask = enterCritical();
+    SPITransaction* transaction = failedFront_;
+    failedFront_ = nullptr;
+    for (SPITransaction* failed = transaction; failed != nullptr; failed = failed->next) failed->status = eSPITransactionStatus_t::eSPITransactionStatus_Failed;
+    exitCritical(primask);
+
+    while (transaction != nullptr) {
+        //Callback can submit it again, which changes next.
+        SPITransaction* next = transaction->next;
+        if (transaction->callback != nullptr) transaction->callback(transaction);
+        transaction = next;
+    }
+
+}
+
+
+void SPIBus::countTransfer(SPIDevice* device, const int64_t &waitTime, const int64_t &busyTime, const uint32_t &bytes, const bool &deadlineMissed) {
+
+    SPIBusStatistics* counters[] = {&statistics_, device != nullptr ? &device->statistics : nullptr};
+
+    for (SPIBusStatistics* statistics : counters) {
+
+        if (statistics == nullptr) continue;
+
+        statistics->transfers++;
+        statistics->bytes += bytes;
+        statistics->busyTime += busyTime;
+        statistics->waitTime += waitTime;
+        if (waitTime > statistics->maxWaitTime) statistics->maxWaitTime = waitTime;
+        if (deadlineMissed) statistics->deadlineMisses++;
+
+    }
+
+}
+
+
+#if defined(__IMXRT1062__)
+
+void SPIBus::dmaInterrupt(EventResponderRef event) {
+    ((SPIBus*)event.getContext())->finishTransfer();
+}
+
+#else
+
+void SPIBus::attachDeviceModel(const uint8_t &chipSelectPin, SPIDeviceModel* model) {
+
+    for (uint32_t i = 0; i < SPI_BUS_MAX_DEVICE_MODELS; i++) {
+        if (models_[i] != nullptr && modelPins_[i] == chipSelectPin) {
+            models_[i] = model;
+            return;
+        }
+    }
+
+    if (model == nullptr) return;
+
+    for (uint32_t i = 0; i < SPI_BUS_MAX_DEVICE_MODELS; i++) {
+        if (models_[i] == nullptr) {
+            modelPins_[i] = chipSelectPin;
+            models_[i] = model;
+            return;
+        }
+    }
+
+}
+
+
+bool SPIBus::completeTransfer() {
+
+    if (running_ == nullptr) return false;
+
+    finishTransfer();
+
+    return true;
+
+}
+
+#endif
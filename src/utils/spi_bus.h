@@ -0,0 +1,354 @@
+#ifndef SPI_BUS_H
+#define SPI_BUS_H
+
+
+/**
+ * Arbiter for one SPI bus shared by several devices. On the Teensy 4 transfers are run by DMA, so the
+ * CPU does not wait for the bus. Every device is added once with its chip select, clock, mode and
+ * priority. Drivers fill an SPITransaction for the device with buffers, submit it and get a callback
+ * from the DMA interrupt once it is done. The callback can submit the next transaction directly, e.g.
+ * read the data after reading how much there is. Transactions are not copied and belong to the bus
+ * from submit() until their status is done.
+ *
+ * Waiting transactions are started by priority of their device. Transactions of the same priority
+ * go by deadline, then in the order they were submitted. A running transfer is never interrupted,
+ * so high priority transfers wait at most for one transfer of a lower priority device.
+ *
+ * Libraries that transfer byte by byte themselves must lock() the bus around it. This waits for the
+ * running transfer and holds back the queue until unlock(). Waiting transactions of a higher priority
+ * than the locking device still go first. Long locked sections should call yieldLock() between their
+ * transfers to let them through.
+ *
+ * Time the bus was busy and how long transactions and locks waited for it is counted for the bus
+ * and every device.
+ *
+ * Other targets (e.g. host builds) have no DMA. Transfers go to the SPIDeviceModel attached for their
+ * chip select and completeTransfer() stands in for the DMA interrupt.
+ *
+ * e.g:
+ *
+ * SPIBus* bus = SPIBus::getBus(&SPI);
+ * SPIDevice* imu = bus->addDevice(10, 20000000, SPI_MODE3, eSPIPriority_t::eSPIPriority_High);
+ *
+ * SPITransaction read;
+ * read.device = imu;
+ * read.txBuffer = command;
+ * read.rxBuffer = data;
+ * read.length = 7;
+ * read.callback = dataReceived;
+ * bus->submit(&read);
+*/
+
+
+
+#include "Arduino.h"
+#include "SPI.h"
+#include "stdint.h"
+
+
+
+//Number of SPIClass buses getBus() can manage.
+#ifndef SPI_BUS_MAX_BUSES
+#define SPI_BUS_MAX_BUSES 3
+#endif
+
+//Number of devices that can be added to one bus.
+#ifndef SPI_BUS_MAX_DEVICES
+#define SPI_BUS_MAX_DEVICES 8
+#endif
+
+//Number of device models that can be attached to one bus without DMA.
+#ifndef SPI_BUS_MAX_DEVICE_MODELS
+#define SPI_BUS_MAX_DEVICE_MODELS 8
+#endif
+
+
+
+enum eSPITransactionStatus_t {
+    //Not submitted yet.
+    eSPITransactionStatus_Idle,
+    //Waiting for the bus.
+    eSPITransactionStatus_Queued,
+    //Being transferred.
+    eSPITransactionStatus_Running,
+    //Transferred. Can be submitted again.
+    eSPITransactionStatus_Done,
+    //Could not be started. Can be submitted again.
+    eSPITransactionStatus_Failed
+};
+
+
+
+/**
+ * Order devices get the bus in if several are waiting.
+ */
+enum eSPIPriority_t {
+    //Transfers that can wait, e.g. radio buffers or slow sensors.
+    eSPIPriority_Low,
+    eSPIPriority_Middle,
+    //Transfers that must not be held up, e.g. IMU samples.
+    eSPIPriority_High
+};
+
+
+
+/**
+ * Counters of a bus or device. Times are in nanoseconds.
+ */
+struct SPIBusStatistics {
+
+    //Transactions and locks that got the bus.
+    uint32_t transfers = 0;
+    //Bytes moved by transactions. Locked sections are not counted.
+    uint32_t bytes = 0;
+    //Time the bus was transferring or locked.
+    int64_t busyTime = 0;
+    //Time between submit() or lock() and getting the bus.
+    int64_t waitTime = 0;
+    int64_t maxWaitTime = 0;
+    //Transactions started after their deadline.
+    uint32_t deadlineMisses = 0;
+
+};
+
+
+
+/**
+ * Chip select and settings of a device on a bus. Created with SPIBus::addDevice().
+ */
+struct SPIDevice {
+
+    //Pin pulled low during the transfer. Must already be set up as an output.
+    uint8_t chipSelectPin = 0;
+    uint32_t clock_Hz = 1000000;
+    //One of SPI_MODE0 to SPI_MODE3.
+    uint8_t mode = SPI_MODE0;
+    eSPIPriority_t priority = eSPIPriority_t::eSPIPriority_Low;
+
+    //Counted by the bus. Read with SPIBus::getStatistics().
+    SPIBusStatistics statistics;
+
+};
+
+
+
+struct SPITransaction {
+
+    //Device to transfer with. Its settings are used for the transfer.
+    SPIDevice* device = nullptr;
+
+    //Bytes to send. nullptr to send zeros.
+    const uint8_t* txBuffer = nullptr;
+    //Received bytes are placed here. nullptr to discard them. For DMA it should be aligned to 32 bytes.
+    uint8_t* rxBuffer = nullptr;
+    uint16_t length = 0;
+
+    //Latest time it should start in nanoseconds, see NOW(). Earlier deadlines go first within a priority. 0 for none.
+    int64_t deadline = 0;
+
+    //Called from the interrupt once done. Can submit transactions. nullptr for none.
+    void (*callback)(SPITransaction* transaction) = nullptr;
+    //For use by the callback, e.g. the driver the transaction belongs to.
+    void* context = nullptr;
+
+    //Set by the bus.
+    volatile eSPITransactionStatus_t status = eSPITransactionStatus_t::eSPITransactionStatus_Idle;
+    //Times it was submitted, started and done in nanoseconds. See NOW().
+    int64_t queuedTimestamp = 0;
+    int64_t startTimestamp = 0;
+    int64_t doneTimestamp = 0;
+    //Next in the queue. Only used by the bus.
+    SPITransaction* next = nullptr;
+
+};
+
+
+
+/**
+ * Simulated device for buses without DMA.
+ */
+class SPIDeviceModel {
+public:
+
+    /**
+     * Called for every transfer to the chip select of this device, as if all bytes were clocked at once.
+     *
+     * @param txBuffer is what was sent. nullptr for zeros.
+     * @param rxBuffer is where the answer must be placed. nullptr if not needed.
+     * @param length is the number of bytes.
+     */
+    virtual void transfer(const uint8_t* txBuffer, uint8_t* rxBuffer, const uint16_t &length) = 0;
+
+};
+
+
+
+class SPIBus {
+public:
+
+    /**
+     * Gives the arbiter of a bus. Created on first use, so drivers sharing a bus share its queue.
+     * The bus itself must still be started with SPIClass::begin().
+     *
+     * @param spi is the bus, e.g. &SPI.
+     * @returns the arbiter of the bus. nullptr if more than SPI_BUS_MAX_BUSES are used.
+     */
+    static SPIBus* getBus(SPIClass* spi);
+
+    /**
+     * Adds a device to the bus. Adding the same chip select again gives the same device with the new settings.
+     *
+     * @param chipSelectPin of the device.
+     * @param clock_Hz is the SPI clock used for its transactions.
+     * @param mode is one of SPI_MODE0 to SPI_MODE3.
+     * @param priority decides which device goes first if several wait for the bus.
+     * @returns the device. nullptr if more than SPI_BUS_MAX_DEVICES are added.
+     */
+    SPIDevice* addDevice(const uint8_t &chipSelectPin, const uint32_t &clock_Hz, const uint8_t &mode, const eSPIPriority_t &priority);
+
+    /**
+     * Places a transaction into the queue by priority of its device and deadline. Starts it if the bus is free.
+     * Safe to call from interrupts, e.g. from a callback.
+     *
+     * @param transaction to run. Must stay valid until done.
+     * @returns false if it is already queued or running or has no device or length.
+     */
+    bool submit(SPITransaction* transaction);
+
+    /**
+     * @returns true if nothing is running or queued.
+     */
+    bool isIdle();
+
+    /**
+     * Waits until the running transfer and waiting ones of a higher priority are done, then keeps the
+     * queue from starting new ones. Used around code that uses the SPIClass directly. Not from interrupts.
+     *
+     * @param device that uses the bus. Its priority is used against waiting transactions. nullptr for lowest.
+     */
+    void lock(SPIDevice* device);
+
+    /**
+     * Lets the queue continue after lock().
+     */
+    void unlock();
+
+    /**
+     * Lets waiting transactions of a higher priority than the locking device run, then locks again.
+     * Called by lock holders between transfers, so long locked sections do not hold them up.
+     */
+    void yieldLock();
+
+    /**
+     * @returns counters of the whole bus since the last resetStatistics().
+     */
+    SPIBusStatistics getStatistics();
+
+    /**
+     * @param device of this bus.
+     * @returns counters of the device since the last resetStatistics().
+     */
+    SPIBusStatistics getStatistics(const SPIDevice* device);
+
+    /**
+     * @returns fraction of time the bus was busy since the last resetStatistics(). From 0 to 1.
+     */
+    float getUtilisation();
+
+    /**
+     * Sets the counters of the bus and all its devices back to 0.
+     */
+    void resetStatistics();
+
+#if !defined(__IMXRT1062__)
+
+    /**
+     * Makes transfers to the chip select go to the model.
+     *
+     * @param chipSelectPin of the device.
+     * @param model to use. nullptr to remove it. Devices without a model answer with 0xFF.
+     */
+    void attachDeviceModel(const uint8_t &chipSelectPin, SPIDeviceModel* model);
+
+    /**
+     * Finishes the running transfer like the DMA interrupt would.
+     *
+     * @returns false if nothing was running.
+     */
+    bool completeTransfer();
+
+#endif
+
+
+private:
+
+    SPIBus() {}
+
+    /**
+     * @returns true if a waiting lock() can take the bus: nothing runs and nothing of a higher priority waits. Interrupts must be disabled.
+     */
+    bool canLock();
+
+    /**
+     * Starts queued transactions while the bus is free and no lock holds them back. Interrupts must be disabled.
+     */
+    void startNext();
+
+    /**
+     * Ends the running transfer and starts the next. Called from the interrupt.
+     */
+    void finishTransfer();
+
+    /**
+     * Marks transactions that could not be started as failed and calls their callbacks.
+     * Must not be called with interrupts disabled, as the callbacks can submit again.
+     */
+    void callFailedCallbacks();
+
+    /**
+     * Adds a finished transfer or lock to the counters of the bus and its device. Interrupts must be disabled.
+     */
+    void countTransfer(SPIDevice* device, const int64_t &waitTime, const int64_t &busyTime, const uint32_t &bytes, const bool &deadlineMissed);
+
+#if defined(__IMXRT1062__)
+    static void dmaInterrupt(EventResponderRef event);
+#endif
+
+
+    SPIClass* spi_ = nullptr;
+
+    SPIDevice devices_[SPI_BUS_MAX_DEVICES];
+    uint32_t numberDevices_ = 0;
+
+    //Transactions waiting for the bus, highest priority first. Linked with SPITransaction::next.
+    SPITransaction* volatile queueFront_ = nullptr;
+
+    SPITransaction* volatile running_ = nullptr;
+
+    //Transactions that could not be started and whose callbacks were not called yet. Linked with SPITransaction::next.
+    SPITransaction* volatile failedFront_ = nullptr;
+
+    volatile bool locked_ = false;
+    //Set while lock() waits. Queued transactions of the same or lower priority are held back meanwhile.
+    volatile bool lockPending_ = false;
+    eSPIPriority_t lockPriority_ = eSPIPriority_t::eSPIPriority_Low;
+    SPIDevice* lockDevice_ = nullptr;
+    //Times lock() was called and got the bus, counted once unlocked.
+    int64_t lockRequested_ = 0;
+    int64_t lockStart_ = 0;
+
+    SPIBusStatistics statistics_;
+    int64_t statisticsStart_ = 0;
+
+#if defined(__IMXRT1062__)
+    EventResponder event_;
+#else
+    uint8_t modelPins_[SPI_BUS_MAX_DEVICE_MODELS];
+    SPIDeviceModel* models_[SPI_BUS_MAX_DEVICE_MODELS] = {nullptr};
+#endif
+
+};
+
+
+
+#endif
@@ -0,0 +1,431 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+
+/**
+ * This class implements a lock free queue for exactly one producer and one consumer, e.g. an interrupt
+ * filling it and a task emptying it, or two tasks that can interrupt each other.
+ * Head and tail are only written by one side each and are free running, so no counter is shared and
+ * the capacity must be a power of 2 so indexes are masked instead of divided. Every side keeps a copy
+ * of the index of the other side and only reads the shared one if the copy says full or empty.
+ *
+ * Only the producer may call push() and only the consumer may call pop(), peek(), remove() and clear().
+ * available() and availableSpace() can be called from both.
+ *
+ * What happens when the ring is full is chosen with eRingOverflow_t:
+ * - eRingOverflow_DropNewest drops the pushed element. Elements the consumer has are never touched.
+ * - eRingOverflow_OverwriteOldest removes the oldest elements to make space, so the newest are kept
+ *   if nobody takes them. The producer then also moves the tail, so the consumer checks after reading
+ *   that its elements were not overwritten meanwhile and reads again if they were.
+ *
+ * e.g:
+ *
+ * SPSCRing<int64_t, 8> timestamps;
+ *
+ * void interrupt() {timestamps.push(NOW());}
+ *
+ * void thread() {
+ *      int64_t timestamp;
+ *      while (timestamps.pop(&timestamp)) ...
+ * }
+*/
+
+
+
+#include "stdint.h"
+
+
+
+/**
+ * What a full ring does with new elements.
+ */
+enum eRingOverflow_t {
+    //New elements are dropped.
+    eRingOverflow_DropNewest,
+    //The oldest elements are removed for the new ones.
+    eRingOverflow_OverwriteOldest
+};
+
+
+
+//Head and tail are placed this far apart so producer and consumer do not write the same cache line.
+#ifndef SPSC_RING_CACHE_LINE
+#if defined(__IMXRT1062__)
+#define SPSC_RING_CACHE_LINE 32
+#else
+#define SPSC_RING_CACHE_LINE 64
+#endif
+#endif
+
+
+
+/**
+ * Head and tail of a single producer single consumer ring, without the storage.
+ * Used by SPSCRing and SampleRing. The producer gets free slots with getWritable(), fills them
+ * and makes them visible with commitWrite(). The consumer does the same with getReadable() and commitRead().
+ */
+template<uint32_t size_, eRingOverflow_t overflow_ = eRingOverflow_t::eRingOverflow_DropNewest>
+class SPSCRingIndex {
+public:
+
+    static_assert(size_ > 0 && (size_ & (size_ - 1)) == 0, "SPSCRing size must be a power of 2");
+
+    /**
+     * @returns position in the storage of a free running index.
+     */
+    static inline uint32_t mask(const uint32_t &index) {return index & (size_ - 1);}
+
+    /**
+     * @returns number of elements in the ring.
+     */
+    inline uint32_t available() const {
+        //Tail first, as it can never pass the head read after it. The other side may move meanwhile.
+        uint32_t tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+        uint32_t stored = __atomic_load_n(&head_, __ATOMIC_ACQUIRE) - tail;
+        return stored < size_ ? stored : size_;
+    }
+
+    /**
+     * Producer only. With eRingOverflow_OverwriteOldest the oldest elements are removed until
+     * the given number fit, but never more than the size of the ring.
+     *
+     * @param number of elements that should be written.
+     * @param head is set to the free running index of the first free slot.
+     * @returns how many of them fit.
+     */
+    inline uint32_t getWritable(const uint32_t &number, uint32_t* head) {
+
+        *head = __atomic_load_n(&head_, __ATOMIC_RELAXED);
+
+        if (overflow_ == eRingOverflow_t::eRingOverflow_OverwriteOldest) return makeSpace(number, *head);
+
+        if (size_ - (*head - tailCache_) < number) tailCache_ = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+
+        uint32_t space = size_ - (*head - tailCache_);
+        return number < space ? number : space;
+
+    }
+
+    /**
+     * Makes written elements visible to the consumer. Producer only.
+     * The elements must be written before, the consumer can read them right after.
+     *
+     * @param head is the free running index after the last written element.
+     */
+    inline void commitWrite(const uint32_t &head) {__atomic_store_n(&head_, head, __ATOMIC_RELEASE);}
+
+    /**
+     * Counts elements that did not fit. Producer only.
+     */
+    inline void addDropped(const uint32_t &number) {dropped_ += number;}
+
+    /**
+     * Consumer only.
+     *
+     * @param number of elements that should be read.
+     * @param tail is set to the free running index of the oldest element.
+     * @returns how many of them are there.
+     */
+    inline uint32_t getReadable(const uint32_t &number, uint32_t* tail) {
+
+        if (overflow_ == eRingOverflow_t::eRingOverflow_OverwriteOldest) {
+            //The producer may have moved the tail past the copy of the head.
+            *tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+            headCache_ = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+        } else {
+            *tail = __atomic_load_n(&tail_, __ATOMIC_RELAXED);
+            if (headCache_ - *tail < number) headCache_ = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+        }
+
+        uint32_t stored = headCache_ - *tail;
+        return number < stored ? number : stored;
+
+    }
+
+    /**
+     * Frees read elements for the producer. Consumer only.
+     * The elements must be read before, the producer can overwrite them right after.
+     * With eRingOverflow_OverwriteOldest the producer may already have removed them to make space,
+     * then nothing is freed and the read elements could be newer ones. Read again from getReadable().
+     *
+     * @param tail is the free running index of the first read element, as given by getReadable().
+     * @param number of elements read.
+     * @returns false if the producer removed them meanwhile.
+     */
+    inline bool commitRead(uint32_t tail, const uint32_t &number) {
+
+        if (overflow_ == eRingOverflow_t::eRingOverflow_OverwriteOldest) {
+            return __atomic_compare_exchange_n(&tail_, &tail, tail + number, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        }
+
+        __atomic_store_n(&tail_, tail + number, __ATOMIC_RELEASE);
+        return true;
+
+    }
+
+    /**
+     * Checks that elements that were read without commitRead() were not overwritten meanwhile. Consumer only.
+     * Always true with eRingOverflow_DropNewest.
+     *
+     * @param tail as given by getReadable() before reading.
+     * @returns false if the producer removed them meanwhile. Read again from getReadable().
+     */
+    inline bool isUnchanged(const uint32_t &tail) const {
+
+        if (overflow_ == eRingOverflow_t::eRingOverflow_DropNewest) return true;
+
+        //Elements must be read before the tail is checked.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&tail_, __ATOMIC_RELAXED) == tail;
+
+    }
+
+    /**
+     * Removes all elements. Consumer only. Elements pushed meanwhile may stay.
+     */
+    inline void clear() {
+
+        if (overflow_ == eRingOverflow_t::eRingOverflow_OverwriteOldest) {
+            uint32_t tail = __atomic_load_n(&tail_, __ATOMIC_RELAXED);
+            do {
+                headCache_ = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+            } while (!__atomic_compare_exchange_n(&tail_, &tail, headCache_, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+            return;
+        }
+
+        headCache_ = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&tail_, headCache_, __ATOMIC_RELEASE);
+
+    }
+
+    /**
+     * @returns number of elements dropped or overwritten because the ring was full.
+     */
+    inline uint32_t getDropped() const {return dropped_;}
+
+
+private:
+
+    /**
+     * Moves the tail for eRingOverflow_OverwriteOldest until the given number fit. Producer only.
+     *
+     * @param number of elements that should be written.
+     * @param head is the free running index of the first free slot.
+     * @returns how many of them will be written.
+     */
+    inline uint32_t makeSpace(const uint32_t &number, const uint32_t &head) {
+
+        uint32_t toWrite = number < size_ ? number : size_;
+        uint32_t tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+
+        while (size_ - (head - tail) < toWrite) {
+
+            //Fails if the consumer moved the tail meanwhile, which updates tail and maybe made enough space.
+            if (__atomic_compare_exchange_n(&tail_, &tail, head + toWrite - size_, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                dropped_ += head + toWrite - size_ - tail;
+                //The consumer must see the new tail before it can see any overwritten element.
+                __atomic_thread_fence(__ATOMIC_RELEASE);
+                break;
+            }
+
+        }
+
+        return toWrite;
+
+    }
+
+
+    //Index of the next element to write. Only written by the producer.
+    alignas(SPSC_RING_CACHE_LINE) uint32_t head_ = 0;
+    //Copy of tail_ the producer last read. Space is at least what it says.
+    uint32_t tailCache_ = 0;
+    //Only written by the producer.
+    uint32_t dropped_ = 0;
+
+    //Index of the next element to read. Only written by the consumer, or by the producer with eRingOverflow_OverwriteOldest.
+    alignas(SPSC_RING_CACHE_LINE) uint32_t tail_ = 0;
+    //Copy of head_ the consumer last read. Number of elements is at least what it says.
+    uint32_t headCache_ = 0;
+
+};
+
+
+
+template<typename T, uint32_t size_, eRingOverflow_t overflow_ = eRingOverflow_t::eRingOverflow_DropNewest>
+class SPSCRing {
+public:
+
+    SPSCRing() {}
+
+    /**
+     * @returns number of elements in the ring.
+     */
+    inline uint32_t available() const {return index_.available();}
+
+    /**
+     * @returns number of elements that can be pushed.
+     */
+    inline uint32_t availableSpace() const {return size_ - available();}
+
+    /**
+     * @returns maximum number of elements.
+     */
+    inline uint32_t capacity() const {return size_;}
+
+    /**
+     * Places an element at the head. Producer only.
+     * If the ring is full the element is dropped, or the oldest is removed with eRingOverflow_OverwriteOldest.
+     *
+     * @param element element to be placed into the ring.
+     * @returns true if placed into the ring.
+     */
+    inline bool push(const T &element) {
+
+        uint32_t head;
+        if (index_.getWritable(1, &head) == 0) {
+            index_.addDropped(1);
+            return false;
+        }
+
+        ringArray_[index_.mask(head)] = element;
+
+        //Element must be written before the consumer can see the new head.
+        index_.commitWrite(head + 1);
+
+        return true;
+
+    }
+
+    /**
+     * Places as many of the given elements as fit at the head. Producer only.
+     * The head is moved once, so the consumer sees all of them at the same time.
+     * With eRingOverflow_OverwriteOldest the oldest elements in the ring and then in the array make space.
+     *
+     * @param elements array of elements to be placed into the ring.
+     * @param number number of elements in the array.
+     * @returns number of elements placed. The rest are dropped.
+     */
+    inline uint32_t push(const T* elements, const uint32_t &number) {
+
+        uint32_t head;
+        uint32_t toPush = index_.getWritable(number, &head);
+
+        //Keep the newest of the array if not all fit.
+        if (overflow_ == eRingOverflow_t::eRingOverflow_OverwriteOldest) elements += number - toPush;
+
+        for (uint32_t i = 0; i < toPush; i++) ringArray_[index_.mask(head + i)] = elements[i];
+
+        index_.commitWrite(head + toPush);
+        index_.addDropped(number - toPush);
+
+        return toPush;
+
+    }
+
+    /**
+     * Takes the oldest element. Consumer only.
+     *
+     * @param element Variable whos data will be overwritten.
+     * @returns true if an element was taken.
+     */
+    inline bool pop(T* element) {
+
+        //Element must be read before the producer can overwrite it. Read again if it did meanwhile.
+        uint32_t tail;
+        do {
+
+            if (index_.getReadable(1, &tail) == 0) return false;
+
+            *element = ringArray_[index_.mask(tail)];
+
+        } while (!index_.commitRead(tail, 1));
+
+        return true;
+
+    }
+
+    /**
+     * Takes up to the given number of the oldest elements. Consumer only.
+     *
+     * @param elements array to be written into.
+     * @param number size of the array.
+     * @returns number of elements taken.
+     */
+    inline uint32_t pop(T* elements, const uint32_t &number) {
+
+        uint32_t tail;
+        uint32_t toPop;
+        do {
+
+            toPop = index_.getReadable(number, &tail);
+
+            for (uint32_t i = 0; i < toPop; i++) elements[i] = ringArray_[index_.mask(tail + i)];
+
+        } while (!index_.commitRead(tail, toPop));
+
+        return toPop;
+
+    }
+
+    /**
+     * Copies the oldest element without removing it. Consumer only.
+     *
+     * @param element Variable whos data will be overwritten.
+     * @returns true if an element was copied.
+     */
+    inline bool peek(T* element) {
+
+        uint32_t tail;
+        do {
+
+            if (index_.getReadable(1, &tail) == 0) return false;
+
+            *element = ringArray_[index_.mask(tail)];
+
+        } while (!index_.isUnchanged(tail));
+
+        return true;
+
+    }
+
+    /**
+     * Removes up to the given number of the oldest elements. Consumer only.
+     *
+     * @param number number of elements to remove.
+     * @returns number of elements removed.
+     */
+    inline uint32_t remove(const uint32_t &number = 1) {
+
+        uint32_t tail;
+        uint32_t toRemove;
+        do {
+            toRemove = index_.getReadable(number, &tail);
+        } while (!index_.commitRead(tail, toRemove));
+
+        return toRemove;
+
+    }
+
+    /**
+     * Removes all elements. Consumer only. Elements pushed meanwhile may stay.
+     */
+    inline void clear() {index_.clear();}
+
+    /**
+     * @returns number of elements dropped or overwritten because the ring was full.
+     */
+    inline uint32_t getDropped() const {return index_.getDropped();}
+
+
+private:
+
+    SPSCRingIndex<size_, overflow_> index_;
+
+    //Array for element storage
+    alignas(SPSC_RING_CACHE_LINE) T ringArray_[size_];
+
+};
+
+
+
+#endif
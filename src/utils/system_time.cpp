@@ -0,0 +1,100 @@
+#include "system_time.h"
+
+#include "Arduino.h"
+
+
+
+#if defined(__IMXRT1062__)
+extern "C" {
+    //Defined by the Teensy 4 core. Updated by the systick interrupt every millisecond.
+    extern volatile uint32_t systick_millis_count;
+    extern volatile uint32_t systick_cycle_count;
+}
+#endif
+
+
+
+//Used instead of the hardware clock if not nullptr.
+static int64_t (*timeSource_)() = nullptr;
+
+static volatile int64_t virtualTime_ns_ = 0;
+
+//Counts overflows of the 32 bit hardware counter to extend it to 64 bit.
+static uint32_t lastCount_ = 0;
+static uint32_t countEpoch_ = 0;
+
+
+
+static int64_t getVirtualTime() {
+    return virtualTime_ns_;
+}
+
+
+#if defined(__IMXRT1062__)
+
+static int64_t getHardwareTime() {
+
+    //Interrupts are disabled so the systick counters and the epoch are read together.
+    uint32_t primask;
+    asm volatile("mrs %0, primask" : "=r" (primask));
+    __disable_irq();
+
+    uint32_t millisCount = systick_millis_count;
+    uint32_t cycles = ARM_DWT_CYCCNT - systick_cycle_count;
+
+    if (millisCount < lastCount_) countEpoch_++;
+    lastCount_ = millisCount;
+    uint64_t milliseconds = ((uint64_t)countEpoch_ << 32) | millisCount;
+
+    if (!primask) __enable_irq();
+
+    //Cycles since the last systick. Can be slightly above 1ms if the systick interrupt is pending.
+    uint32_t fraction_ns = cycles*1000/(F_CPU_ACTUAL/1000000);
+    if (fraction_ns > 999999) fraction_ns = 999999;
+
+    return milliseconds*MILLISECONDS + fraction_ns;
+
+}
+
+#else
+
+static int64_t getHardwareTime() {
+
+    uint32_t count = micros();
+
+    if (count < lastCount_) countEpoch_++;
+    lastCount_ = count;
+
+    return ((int64_t)(((uint64_t)countEpoch_ << 32) | count))*MICROSECONDS;
+
+}
+
+#endif
+
+
+
+int64_t NOW() {
+
+    int64_t (*timeSource)() = timeSource_;
+    if (timeSource != nullptr) return timeSource();
+
+    return getHardwareTime();
+
+}
+
+
+void setTimeSource(int64_t (*timeSource)()) {
+    timeSource_ = timeSource;
+}
+
+
+void setVirtualTime(const int64_t &time_ns) {
+    virtualTime_ns_ = time_ns;
+    timeSource_ = getVirtualTime;
+}
+
+
+void advanceVirtualTime(const int64_t &time_ns) {
+    virtualTime_ns_ = virtualTime_ns_ + time_ns;
+    timeSource_ = getVirtualTime;
+}
@@ -0,0 +1,62 @@
+#ifndef SYSTEM_TIME_H
+#define SYSTEM_TIME_H
+
+
+/**
+ * Single time base for all modules. Time is given as int64_t nanoseconds since startup,
+ * so it does not overflow during any realistic runtime.
+ * On the Teensy 4 it is read from the millisecond systick counter and the CPU cycle counter.
+ * The time source can be replaced, e.g. by a virtual clock so modules can be simulated
+ * or replayed faster or slower than real time.
+ *
+ * e.g:
+ * int64_t start = NOW();
+ * if (NOW() - start > 5*MILLISECONDS) ...
+*/
+
+
+
+#include "stdint.h"
+
+
+
+//Multiply with these to convert to nanoseconds.
+#define NANOSECONDS 1LL
+#define MICROSECONDS 1000LL
+#define MILLISECONDS 1000000LL
+#define SECONDS 1000000000LL
+
+
+
+/**
+ * Returns the current time. Safe to call from interrupts.
+ *
+ * @returns time since startup in nanoseconds.
+ */
+int64_t NOW();
+
+/**
+ * Replaces the clock NOW() reads from.
+ *
+ * @param timeSource is a function returning the time in nanoseconds. nullptr to use the hardware clock.
+ */
+void setTimeSource(int64_t (*timeSource)());
+
+/**
+ * Makes NOW() return a virtual time that only changes when set or advanced.
+ * Stays active until setTimeSource() is called.
+ *
+ * @param time_ns is the virtual time in nanoseconds.
+ */
+void setVirtualTime(const int64_t &time_ns);
+
+/**
+ * Moves the virtual time forward. Also activates the virtual time.
+ *
+ * @param time_ns is the time to advance by in nanoseconds.
+ */
+void advanceVirtualTime(const int64_t &time_ns);
+
+
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * Compares Buffer with SPSCRing and SampleRing for the way sensor drivers use them: one side placing samples,
+ * the other taking them out in bursts. Also checks SPSCRing with a producer and a consumer thread
+ * running at the same time, which Buffer does not support.
+ *
+ * Built and run on the host with:
+ * g++ -std=gnu++14 -O2 -pthread -I src -o buffer_benchmark src/utils/tools/buffer_benchmark.cpp
+ * ./buffer_benchmark
+*/
+
+
+
+#include "stdio.h"
+#include "stdint.h"
+
+#include <chrono>
+#include <thread>
+
+#include "utils/buffer.h"
+#include "utils/spsc_ring.h"
+#include "utils/sample_ring.h"
+#include "utils/sensor_timestamp.h"
+
+
+
+//Number of elements moved through every queue.
+#ifndef BENCHMARK_ELEMENTS
+#define BENCHMARK_ELEMENTS 10000000
+#endif
+//Elements placed before they are taken out again. Like a task emptying a sensor FIFO every few samples.
+#ifndef BENCHMARK_BURST
+#define BENCHMARK_BURST 8
+#endif
+//Elements passed between the two threads of the concurrent check.
+#ifndef BENCHMARK_CONCURRENT_ELEMENTS
+#define BENCHMARK_CONCURRENT_ELEMENTS 1000000
+#endif
+
+
+
+//Keeps the compiler from removing the loops.
+static volatile uint64_t sink;
+
+
+
+static double getSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void printResult(const char* name, const double &time_s) {
+    printf("%-42s %8.2f ns per element\n", name, time_s*1e9/BENCHMARK_ELEMENTS);
+}
+
+
+template<typename T, uint32_t size>
+static void benchmarkBuffer(const char* name) {
+
+    static Buffer<T, size> buffer;
+    T element = T();
+    uint64_t sum = 0;
+
+    double start = getSeconds();
+
+    for (uint32_t i = 0; i < BENCHMARK_ELEMENTS; i += BENCHMARK_BURST) {
+        for (uint32_t j = 0; j < BENCHMARK_BURST; j++) buffer.placeFront(element, true);
+        while (buffer.available() > 0) {
+            buffer.takeBack(&element);
+            sum++;
+        }
+    }
+
+    printResult(name, getSeconds() - start);
+    sink = sum;
+
+}
+
+
+template<typename T>
+static void benchmarkRing(const char* name) {
+
+    static SPSCRing<T, 128> ring;
+    T element = T();
+    uint64_t sum = 0;
+
+    double start = getSeconds();
+
+    for (uint32_t i = 0; i < BENCHMARK_ELEMENTS; i += BENCHMARK_BURST) {
+        for (uint32_t j = 0; j < BENCHMARK_BURST; j++) ring.push(element);
+        while (ring.pop(&element)) sum++;
+    }
+
+    printResult(name, getSeconds() - start);
+    sink = sum;
+
+}
+
+
+template<typename T>
+static void benchmarkRingBulk(const char* name) {
+
+    static SPSCRing<T, 128> ring;
+    T elements[BENCHMARK_BURST] = {};
+    uint64_t sum = 0;
+
+    double start = getSeconds();
+
+    for (uint32_t i = 0; i < BENCHMARK_ELEMENTS; i += BENCHMARK_BURST) {
+        ring.push(elements, BENCHMARK_BURST);
+        sum += ring.pop(elements, BENCHMARK_BURST);
+    }
+
+    printResult(name, getSeconds() - start);
+    sink = sum;
+
+}
+
+
+template<eSampleLayout_t layout>
+static void benchmarkSampleRingDrain(const char* name) {
+
+    static SampleRing<float, 128, layout> ring;
+    float values[BENCHMARK_BURST];
+    int64_t timestamps[BENCHMARK_BURST];
+    uint64_t sum = 0;
+
+    double start = getSeconds();
+
+    for (uint32_t i = 0; i < BENCHMARK_ELEMENTS; i += BENCHMARK_BURST) {
+        for (uint32_t j = 0; j < BENCHMARK_BURST; j++) ring.push(values[0], i);
+        sum += ring.drain(SampleSpan<float>(values, timestamps, BENCHMARK_BURST));
+    }
+
+    printResult(name, getSeconds() - start);
+    sink = sum;
+
+}
+
+
+/**
+ * Producer thread pushes increasing numbers, consumer thread checks that none are lost, repeated or out of order.
+ */
+static void checkConcurrent() {
+
+    static SPSCRing<uint32_t, 1024> ring;
+    uint32_t errors = 0;
+
+    double start = getSeconds();
+
+    std::thread producer([]() {
+        for (uint32_t i = 0; i < BENCHMARK_CONCURRENT_ELEMENTS;) {
+            if (ring.push(i)) i++;
+            else std::this_thread::yield();
+        }
+    });
+
+    uint32_t expected = 0;
+    while (expected < BENCHMARK_CONCURRENT_ELEMENTS) {
+        uint32_t element;
+        if (!ring.pop(&element)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (element != expected) errors++;
+        expected = element + 1;
+    }
+
+    producer.join();
+
+    printf("%-42s %8.2f ns per element\n", "SPSCRing<uint32_t> two threads", (getSeconds() - start)*1e9/BENCHMARK_CONCURRENT_ELEMENTS);
+    printf("%u of %u elements lost, repeated or out of order.\n", errors, BENCHMARK_CONCURRENT_ELEMENTS);
+
+}
+
+
+
+int main() {
+
+    printf("%u elements in bursts of %u.\n", BENCHMARK_ELEMENTS, BENCHMARK_BURST);
+
+    //Drivers used a size of 100, which needs a division for every index.
+    benchmarkBuffer<float, 100>("Buffer<float, 100>");
+    benchmarkBuffer<float, 128>("Buffer<float, 128>");
+    benchmarkRing<float>("SPSCRing<float, 128>");
+    benchmarkRingBulk<float>("SPSCRing<float, 128> bulk");
+
+    benchmarkBuffer<SensorTimestamp<float>, 100>("Buffer<SensorTimestamp<float>, 100>");
+    benchmarkBuffer<SensorTimestamp<float>, 128>("Buffer<SensorTimestamp<float>, 128>");
+    benchmarkRing<SensorTimestamp<float>>("SPSCRing<SensorTimestamp<float>, 128>");
+    benchmarkRingBulk<SensorTimestamp<float>>("SPSCRing<SensorTimestamp<float>, 128> bulk");
+    benchmarkSampleRingDrain<eSampleLayout_t::eSampleLayout_Interleaved>("SampleRing<float, 128> interleaved drain");
+    benchmarkSampleRingDrain<eSampleLayout_t::eSampleLayout_Separate>("SampleRing<float, 128> separate drain");
+
+    checkConcurrent();
+
+    return 0;
+
+}
@@ -23,6 +23,7 @@ class VehicleGeneral: public Vehicle_Interface, public Module_Abstract, public T
 public:
 
     VehicleGeneral(Guidance_Interface* guidancePointer, Navigation_Interface* navigationPointer, Control_Interface* controlPointer, Dynamics_Interface* dynamicsPointer) : Task_Abstract(8000, eTaskPriority_t::eTaskPriority_High, true) {
+        setTaskName("VehicleGeneral");
         guidance_ = guidancePointer;
         navigation_ = navigationPointer;
         control_ = controlPointer;
@@ -89,7 +90,10 @@ public:
      * 
      * @returns VehicleData of vehicle
      */
-    VehicleData getVehicleData() {return vehicleData_;}
+    VehicleData getVehicleData() {
+        vehicleData_.schedulerOverloaded = isSchedulerOverloaded();
+        return vehicleData_;
+    }
 
 
 protected: